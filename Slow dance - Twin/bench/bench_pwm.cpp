@@ -0,0 +1,154 @@
+// Waveform benchmark for lib/PWM on the host timer model (lib/avr_host):
+// sets up Timer1 and Timer2 the way the sketch does for each (LED Hz,
+// magnet Hz, LED duty) configuration and writes a VCD trace of the LED and
+// magnet pins. The numbers are worked out from the traces by
+// Slow-Dance/scripts/bench_waveforms.py, which runs this and the ESP32 bench.
+//
+//   pio run -e bench && .pio/build/bench/program --out bench-out 80.4:79.8:10
+
+#include <Arduino.h>
+#include <PWM.h>
+#include <avr_sim.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <vector>
+
+// As in src/main.cpp
+#define LED_STRIP 3
+#define EMAGNET 9
+#define EMAGNET2 10
+#define MAGNET_DUTY 20
+
+#define BENCH_SETTLE_MS 200
+#define PS_PER_CYCLE (1000000000000ULL / F_CPU)
+
+struct BenchConfig {
+  double ledHz;
+  double magnetHz;
+  double duty;
+};
+
+struct TracePin {
+  int pin;
+  const char *name;
+  char id;
+};
+
+static const TracePin TRACE_PINS[] = {
+  {LED_STRIP, "led", '!'},
+  {EMAGNET, "magnet", '"'},
+  {EMAGNET2, "magnet2", '#'},
+};
+
+static const BenchConfig DEFAULT_MATRIX[] = {
+  {80.5, 79.8, 50.0},
+  {80.4, 79.8, 10.0},
+  {84.8, 79.8, 10.0},
+  {60.0, 59.5, 30.0},
+  {120.0, 119.0, 20.0},
+};
+
+static uint64_t cpuNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool parseConfig(const char *text, BenchConfig &config) {
+  return sscanf(text, "%lf:%lf:%lf", &config.ledHz, &config.magnetHz, &config.duty) == 3;
+}
+
+// The sketch's setup() and mode 1, from power-on
+static void applyConfig(const BenchConfig &config) {
+  InitTimersSafe();
+  SetPinFrequencyExt(LED_STRIP, (uint32_t)(config.ledHz * 1000 + 0.5));
+  SetPinFrequencySafeHR(EMAGNET, (uint32_t)(config.magnetHz * 1000 + 0.5));
+  SetPinFrequencySafeHR(EMAGNET2, (uint32_t)(config.magnetHz * 1000 + 0.5));
+  pwmWrite(EMAGNET, round(MAGNET_DUTY * 255 / 100.0));
+  pwmWrite(EMAGNET2, round(MAGNET_DUTY * 255 / 100.0));
+  pwmWrite(LED_STRIP, round(config.duty * 255 / 100));
+}
+
+static bool runConfig(const BenchConfig &config, double seconds, const char *outDir) {
+  avrSimReset();
+  uint64_t cpu = cpuNs();
+  applyConfig(config);
+  cpu = cpuNs() - cpu;
+  avrSimRun(BENCH_SETTLE_MS * (F_CPU / 1000));
+
+  uint8_t initial[sizeof(TRACE_PINS) / sizeof(TRACE_PINS[0])];
+  for (size_t i = 0; i < sizeof(TRACE_PINS) / sizeof(TRACE_PINS[0]); i++) {
+    initial[i] = avrSimGetPin(TRACE_PINS[i].pin);
+  }
+  avrSimClearEdges();
+  uint64_t start = avrSimNow();
+  uint64_t interrupts = avrSimInterrupts();
+  uint64_t runCpu = cpuNs();
+  avrSimRun((uint64_t)(seconds * F_CPU));
+  cpu += cpuNs() - runCpu;
+  interrupts = avrSimInterrupts() - interrupts;
+
+  char path[512];
+  snprintf(path, sizeof(path), "%s/avr_%g_%g_%g.vcd", outDir, config.ledHz, config.magnetHz,
+           config.duty);
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  fprintf(f, "$comment path=avr led_hz=%g mag_hz=%g duty=%g seconds=%g host_ns=%llu "
+             "interrupts=%llu $end\n", config.ledHz, config.magnetHz, config.duty, seconds,
+          (unsigned long long)cpu, (unsigned long long)interrupts);
+  fprintf(f, "$timescale 1 ps $end\n$scope module atmega328p $end\n");
+  for (const TracePin &p : TRACE_PINS) fprintf(f, "$var wire 1 %c %s $end\n", p.id, p.name);
+  fprintf(f, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+  for (size_t i = 0; i < sizeof(TRACE_PINS) / sizeof(TRACE_PINS[0]); i++) {
+    fprintf(f, "%d%c\n", initial[i], TRACE_PINS[i].id);
+  }
+  fprintf(f, "$end\n");
+
+  uint64_t last = UINT64_MAX;
+  for (const AvrSimEdge &e : avrSimEdges()) {
+    for (const TracePin &p : TRACE_PINS) {
+      if (p.pin != e.pin) continue;
+      if (e.cycle != last) {
+        fprintf(f, "#%llu\n", (unsigned long long)((e.cycle - start) * PS_PER_CYCLE));
+      }
+      fprintf(f, "%d%c\n", e.level, p.id);
+      last = e.cycle;
+    }
+  }
+  fclose(f);
+  printf("%s\n", path);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  double seconds = 10.0;
+  const char *outDir = "bench-out";
+  std::vector<BenchConfig> matrix;
+  for (int i = 1; i < argc; i++) {
+    BenchConfig config;
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      outDir = argv[++i];
+    } else if (parseConfig(argv[i], config)) {
+      matrix.push_back(config);
+    } else {
+      fprintf(stderr, "usage: %s [--seconds S] [--out DIR] [LED_HZ:MAG_HZ:DUTY ...]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (matrix.empty()) {
+    matrix.assign(DEFAULT_MATRIX, DEFAULT_MATRIX + sizeof(DEFAULT_MATRIX) / sizeof(DEFAULT_MATRIX[0]));
+  }
+  mkdir(outDir, 0755);
+
+  int failed = 0;
+  for (const BenchConfig &config : matrix) {
+    if (!runConfig(config, seconds, outDir)) failed++;
+  }
+  return failed ? 1 : 0;
+}
@@ -41,6 +41,9 @@ b) ATmega640/1280/1281/2560/2561
 // 16 bit timers
 extern uint32_t	GetFrequency_16(const int16_t timerOffset);
 extern bool		SetFrequency_16(const int16_t timerOffset, uint32_t f);
+extern uint32_t	GetFrequencyHR_16(const int16_t timerOffset);
+extern uint32_t	SetFrequencyHR_16(const int16_t timerOffset, uint32_t millihertz);
+extern uint32_t	UpdateFrequencyHR_16(const int16_t timerOffset, uint32_t millihertz);	//Timer1 only, see "Timer1 Latched Updates"
 extern uint16_t GetPrescaler_16(const int16_t timerOffset);
 extern void		SetPrescaler_16(const int16_t timerOffset, prescaler psc);
 extern void		SetTop_16(const int16_t timerOffset, uint16_t top);
@@ -51,6 +54,9 @@ extern float	GetResolution_16(const int16_t timerOffset);
 // 8 bit timers
 extern uint32_t	GetFrequency_8(const int16_t timerOffset);
 extern bool		SetFrequency_8(const int16_t timerOffset, uint32_t f);
+extern uint32_t	GetFrequencyHR_8(const int16_t timerOffset);
+extern uint32_t	SetFrequencyHR_8(const int16_t timerOffset, uint32_t millihertz);
+extern uint32_t	SetFrequencyExt_8(const int16_t timerOffset, uint32_t millihertz);	//Timer2 only, see "Timer2 Extended Resolution"
 extern uint16_t GetPrescaler_8(const int16_t timerOffset);
 extern void		SetPrescaler_8(const int16_t timerOffset, prescaler psc);
 extern void		SetPrescalerAlt_8(const int16_t timerOffset, prescaler_alt psc);
@@ -66,6 +72,9 @@ extern float	GetResolution_8(const int16_t timerOffset);
 // 16 bit timers
 extern uint32_t	GetFrequency_16();
 extern bool		SetFrequency_16(uint32_t f);
+extern uint32_t	GetFrequencyHR_16();
+extern uint32_t	SetFrequencyHR_16(uint32_t millihertz);
+extern uint32_t	UpdateFrequencyHR_16(uint32_t millihertz);				//see "Timer1 Latched Updates"
 extern uint16_t GetPrescaler_16();
 extern void		SetPrescaler_16(prescaler psc);
 extern void		SetTop_16(uint16_t top);
@@ -76,6 +85,9 @@ extern float	GetResolution_16();
 // 8 bit timers
 extern uint32_t	GetFrequency_8(const int16_t timerOffset);
 extern bool		SetFrequency_8(const int16_t timerOffset, uint32_t f);
+extern uint32_t	GetFrequencyHR_8(const int16_t timerOffset);
+extern uint32_t	SetFrequencyHR_8(const int16_t timerOffset, uint32_t millihertz);
+extern uint32_t	SetFrequencyExt_8(const int16_t timerOffset, uint32_t millihertz);	//Timer2 only, see "Timer2 Extended Resolution"
 extern uint16_t GetPrescaler_8(const int16_t timerOffset);
 extern void		SetPrescaler_8(const int16_t timerOffset, prescaler psc);
 extern void		SetPrescalerAlt_8(const int16_t timerOffset, prescaler_alt psc);
@@ -94,6 +106,11 @@ extern void		pwmWrite(uint8_t pin, uint8_t val);
 extern void		pwmWriteHR(uint8_t pin, uint16_t val);					//accepts a 16 bit value and maps it down to the timer for maximum resolution
 extern bool		SetPinFrequency(int8_t pin, uint32_t frequency);
 extern bool		SetPinFrequencySafe(int8_t pin, uint32_t frequency);	//does not set timers responsible for time keeping functions
+extern uint32_t	SetPinFrequencyHR(int8_t pin, uint32_t millihertz);		//frequency in millihertz, sets the closest the timer can do and returns it (0 if out of range)
+extern uint32_t	SetPinFrequencySafeHR(int8_t pin, uint32_t millihertz);	//as above, does not set timers responsible for time keeping functions
+extern uint32_t	GetPinFrequencyHR(int8_t pin);							//frequency of the pin's timer in millihertz, 0 if the pin is not connected to a timer
+extern uint32_t	SetPinFrequencyExt(int8_t pin, uint32_t millihertz);		//Timer2 pins only: mean frequency to a few uHz by dithering TOP from the overflow interrupt, returns it (0 if not possible)
+extern uint32_t	UpdatePinFrequencyHR(int8_t pin, uint32_t millihertz);	//for frequencies that change while running: writes only on a change, at BOTTOM (Timer1 latched, Timer2 extended), returns it (0 if not possible)
 extern float	GetPinResolution(uint8_t pin);							//gets the PWM resolution of a pin in base 2, 0 is returned if the pin is not connected to a timer
 
 #endif /* PWM_H_ */
\ No newline at end of file
@@ -148,6 +148,8 @@ enum prescaler_alt
 //macros for each timer 'object'
 #define Timer0_GetFrequency()		GetFrequency_8(TIMER0_OFFSET)
 #define Timer0_SetFrequency(x)		SetFrequency_8(TIMER0_OFFSET, x)
+#define Timer0_GetFrequencyHR()		GetFrequencyHR_8(TIMER0_OFFSET)
+#define Timer0_SetFrequencyHR(x)	SetFrequencyHR_8(TIMER0_OFFSET, x)
 #define Timer0_GetPrescaler()		GetPrescaler_8(TIMER0_OFFSET)
 #define Timer0_SetPrescaler(x)		SetPrescaler_8(TIMER0_OFFSET, x)
 #define Timer0_GetTop()				GetTop_8(TIMER0_OFFSET)
@@ -157,6 +159,9 @@ enum prescaler_alt
 
 #define Timer1_GetFrequency()		GetFrequency_16(TIMER1_OFFSET)
 #define Timer1_SetFrequency(x)		SetFrequency_16(TIMER1_OFFSET, x)
+#define Timer1_GetFrequencyHR()		GetFrequencyHR_16(TIMER1_OFFSET)
+#define Timer1_SetFrequencyHR(x)	SetFrequencyHR_16(TIMER1_OFFSET, x)
+#define Timer1_UpdateFrequencyHR(x)	UpdateFrequencyHR_16(TIMER1_OFFSET, x)
 #define Timer1_GetPrescaler()		GetPrescaler_16(TIMER1_OFFSET)
 #define Timer1_SetPrescaler(x)		SetPrescaler_16(TIMER1_OFFSET, x)
 #define Timer1_GetTop()				GetTop_16(TIMER1_OFFSET)
@@ -166,6 +171,9 @@ enum prescaler_alt
 
 #define Timer2_GetFrequency()		GetFrequency_8(TIMER2_OFFSET)
 #define Timer2_SetFrequency(x)		SetFrequency_8(TIMER2_OFFSET, x)
+#define Timer2_GetFrequencyHR()		GetFrequencyHR_8(TIMER2_OFFSET)
+#define Timer2_SetFrequencyHR(x)	SetFrequencyHR_8(TIMER2_OFFSET, x)
+#define Timer2_SetFrequencyExt(x)	SetFrequencyExt_8(TIMER2_OFFSET, x)
 #define Timer2_GetPrescaler()		GetPrescaler_8(TIMER2_OFFSET)
 #define Timer2_SetPrescaler(x)		SetPrescalerAlt_8(TIMER2_OFFSET, x)
 #define Timer2_GetTop()				GetTop_8(TIMER2_OFFSET)
@@ -175,6 +183,8 @@ enum prescaler_alt
 
 #define Timer3_GetFrequency()		GetFrequency_16(TIMER3_OFFSET)
 #define Timer3_SetFrequency(x)		SetFrequency_16(TIMER3_OFFSET, x)
+#define Timer3_GetFrequencyHR()		GetFrequencyHR_16(TIMER3_OFFSET)
+#define Timer3_SetFrequencyHR(x)	SetFrequencyHR_16(TIMER3_OFFSET, x)
 #define Timer3_GetPrescaler()		GetPrescaler_16(TIMER3_OFFSET)
 #define Timer3_SetPrescaler(x)		SetPrescaler_16(TIMER3_OFFSET, x)
 #define Timer3_GetTop()				GetTop_16(TIMER3_OFFSET)
@@ -184,6 +194,8 @@ enum prescaler_alt
 
 #define Timer4_GetFrequency()		GetFrequency_16(TIMER4_OFFSET)
 #define Timer4_SetFrequency(x)		SetFrequency_16(TIMER4_OFFSET, x)
+#define Timer4_GetFrequencyHR()		GetFrequencyHR_16(TIMER4_OFFSET)
+#define Timer4_SetFrequencyHR(x)	SetFrequencyHR_16(TIMER4_OFFSET, x)
 #define Timer4_GetPrescaler()		GetPrescaler_16(TIMER4_OFFSET)
 #define Timer4_SetPrescaler(x)		SetPrescaler_16(TIMER4_OFFSET, x)
 #define Timer4_GetTop()				GetTop_16(TIMER4_OFFSET)
@@ -193,6 +205,8 @@ enum prescaler_alt
 
 #define Timer5_GetFrequency()		GetFrequency_16(TIMER5_OFFSET)
 #define Timer5_SetFrequency(x)		SetFrequency_16(TIMER5_OFFSET, x)
+#define Timer5_GetFrequencyHR()		GetFrequencyHR_16(TIMER5_OFFSET)
+#define Timer5_SetFrequencyHR(x)	SetFrequencyHR_16(TIMER5_OFFSET, x)
 #define Timer5_GetPrescaler()		GetPrescaler_16(TIMER5_OFFSET)
 #define Timer5_SetPrescaler(x)		SetPrescaler_16(TIMER5_OFFSET, x)
 #define Timer5_GetTop()				GetTop_16(TIMER5_OFFSET)
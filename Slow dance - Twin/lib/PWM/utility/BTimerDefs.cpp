@@ -35,6 +35,50 @@ static float toBaseTwo(double baseTenNum)
 	return log(baseTenNum + 1)/log(2);
 }
 
+//frequency in millihertz that a timer top and prescaler give, rounded
+static uint32_t topToMilliHz(uint16_t top, uint16_t psc)
+{
+	uint64_t div = (uint64_t)2 * top * psc;
+	
+	if(!div)
+		return 0;
+	
+	return ((uint64_t)F_CPU * 1000 + div / 2) / div;
+}
+
+//tries every prescaler in the list and returns the index of the one whose nearest top comes
+//closest to the frequency, 0 if no top up to maxTop reaches it. The top goes to *top.
+static uint8_t closestSetting(uint32_t millihertz, const uint16_t *lst, uint8_t lstLen, uint16_t maxTop, uint16_t *top)
+{
+	uint8_t best = 0;
+	uint32_t bestError = UINT32_MAX;
+	
+	for(uint8_t i = 1; i < lstLen; i++)
+	{
+		uint64_t div = (uint64_t)2 * lst[i] * millihertz;
+		uint64_t timerTop = ((uint64_t)F_CPU * 1000 + div / 2) / div;
+		
+		if(timerTop < 1 || timerTop > maxTop)
+			continue;
+		
+		uint32_t achieved = topToMilliHz(timerTop, lst[i]);
+		uint32_t error = achieved > millihertz ? achieved - millihertz : millihertz - achieved;
+		
+		//on a tie the smaller prescaler wins: its top is larger, so duty steps are finer
+		if(error < bestError)
+		{
+			best = i;
+			bestError = error;
+			*top = timerTop;
+		}
+	}
+	
+	return best;
+}
+
+static uint32_t extMilliHz;	//mean frequency in Timer2's extended resolution mode
+static uint32_t updateRequest;	//last frequency asked of UpdateFrequencyHR_16, 0 = none
+
 //--------------------------------------------------------------------------------
 //							16 Bit Timer Functions
 //--------------------------------------------------------------------------------
@@ -44,26 +88,38 @@ uint32_t GetFrequency_16()
 	return (int32_t)(F_CPU/(2 * (int32_t)GetTop_16() * GetPrescaler_16()));
 }
 
+uint32_t GetFrequencyHR_16()
+{
+	return topToMilliHz(GetTop_16(), GetPrescaler_16());
+}
+
 bool SetFrequency_16(uint32_t f)
 {
 	if(f > 2000000 || f < 1)
-	return false;
+		return false;
 	
-	//find the smallest usable multiplier
-	uint16_t multiplier = (int16_t)(F_CPU / (2 * f * UINT16_MAX));
+	return SetFrequencyHR_16(f * 1000) != 0;
+}
+
+uint32_t SetFrequencyHR_16(uint32_t millihertz)
+{
+	if(millihertz > 2000000000UL || millihertz < 1)
+		return 0;
 	
-	uint8_t iterate = 0;
-	while(multiplier > pscLst[iterate++]);
+	//written at once from here on: drop an update still waiting for BOTTOM
+	TIMSK1 &= ~_BV(TOIE1);
+	updateRequest = 0;
 	
-	multiplier = pscLst[iterate]; //multiplier holds the clock select value, and iterate holds the corresponding CS flag
+	uint16_t timerTop;
+	uint8_t iterate = closestSetting(millihertz, pscLst, sizeof(pscLst)/sizeof(pscLst[0]), UINT16_MAX, &timerTop);
 	
-	//getting the timer top using the new multiplier
-	uint16_t timerTop = (uint16_t)(F_CPU/(2* f * multiplier));
+	if(!iterate)
+		return 0;
 	
 	SetTop_16(timerTop);
 	SetPrescaler_16((prescaler)iterate);
 	
-	return true;
+	return topToMilliHz(timerTop, pscLst[iterate]);
 }
 
 uint16_t GetPrescaler_16()
@@ -111,34 +167,48 @@ uint32_t GetFrequency_8(const int16_t timerOffset)
 	return (uint32_t)(F_CPU/((uint32_t)2 * GetTop_8(timerOffset) * GetPrescaler_8(timerOffset)));
 }
 
+uint32_t GetFrequencyHR_8(const int16_t timerOffset)
+{
+	if(timerOffset == TIMER2_OFFSET && (TIMSK2 & _BV(TOIE2)))
+		return extMilliHz;
+	
+	return topToMilliHz(GetTop_8(timerOffset), GetPrescaler_8(timerOffset));
+}
+
 bool SetFrequency_8(const int16_t timerOffset, uint32_t f)
 {
 	if(f > 2000000 || f < 31)
 		return false;
 	
-	//find the smallest usable multiplier
-	uint16_t multiplier = (F_CPU / (2 * (uint32_t)f * UINT8_MAX));
+	return SetFrequencyHR_8(timerOffset, f * 1000) != 0;
+}
+
+uint32_t SetFrequencyHR_8(const int16_t timerOffset, uint32_t millihertz)
+{
+	if(millihertz > 2000000000UL || millihertz < 1)
+		return 0;
+	
+	//a fixed TOP from here on: stop the extended resolution mode
+	if(timerOffset == TIMER2_OFFSET)
+		TIMSK2 &= ~_BV(TOIE2);
 	
-	uint8_t iterate = 0;
 	uint16_t timerTop;
+	uint8_t iterate;
+	uint16_t multiplier;
 	
-	do
+	if(TIMER2_OFFSET != timerOffset)
 	{
-		if(TIMER2_OFFSET != timerOffset)
-		{
-			while(multiplier > pscLst[++iterate]);
-			multiplier = pscLst[iterate];
-		}
-		else
-		{
-			while(multiplier > pscLst_alt[++iterate]);
-			multiplier = pscLst_alt[iterate];
-		}
-		
-		//getting the timer top using the new multiplier
-		timerTop = (F_CPU/(2* f * (uint32_t)multiplier));
-		
-	} while (timerTop > UINT8_MAX);
+		iterate = closestSetting(millihertz, pscLst, sizeof(pscLst)/sizeof(pscLst[0]), UINT8_MAX, &timerTop);
+		multiplier = pscLst[iterate];
+	}
+	else
+	{
+		iterate = closestSetting(millihertz, pscLst_alt, sizeof(pscLst_alt)/sizeof(pscLst_alt[0]), UINT8_MAX, &timerTop);
+		multiplier = pscLst_alt[iterate];
+	}
+	
+	if(!iterate)
+		return 0;
 	
 	SetTop_8(timerOffset, timerTop);
 	
@@ -147,7 +217,7 @@ bool SetFrequency_8(const int16_t timerOffset, uint32_t f)
 	else
 	SetPrescalerAlt_8(timerOffset, (prescaler_alt)iterate);
 	
-	return true;
+	return topToMilliHz(timerTop, multiplier);
 }
 
 uint16_t GetPrescaler_8(const int16_t timerOffset)
@@ -203,6 +273,193 @@ float GetResolution_8(const int16_t timerOffset)
 }
 
 
+//--------------------------------------------------------------------------------
+//						Timer2 Extended Resolution
+//--------------------------------------------------------------------------------
+
+//An 8 bit TOP only gets within a few tenths of a hertz of a low frequency: around 80 Hz
+//the prescaler has to be 1024 and one step of TOP moves the frequency by ~0.8 Hz.
+//SetFrequencyExt_8 keeps Timer2 in the same phase correct mode but lets the period
+//fall between two TOPs. The overflow interrupt adds a 16 bit fraction to an
+//accumulator every cycle and runs the next cycle at TOP + 1 whenever it carries, so
+//the mean period is (TOP + fraction/65536) * 2 * prescaler clocks. Around 80 Hz that
+//is a step of ~13 uHz.
+//
+//Cost: the interrupt runs once per PWM period (80 times a second for the LED) and
+//takes about 75 clocks including entry and return, ~5 us at 16 MHz, or 0.04% of
+//the CPU at 80 Hz. The price on the output is jitter: a single period is one tick
+//(2 * prescaler clocks, 128 us at 1024) longer or shorter than its neighbour, while
+//the mean is exact. OCR2B is left alone and pwmWrite/pwmWriteHR scale it to the
+//undithered TOP rather than to OCR2A, so the pulse width does not dither.
+//
+//OCR2A is double buffered at TOP in this mode, so the TOP written at BOTTOM is the
+//one the next cycle runs at; there is no partial period. A change of prescaler is
+//left to the interrupt as well: it writes the first TOP for the new prescaler at one
+//BOTTOM and switches the prescaler at the next, once that TOP has been taken up, so
+//no cycle mixes the two. Asked for the frequency it already runs at, SetFrequencyExt_8
+//returns straight away, so it is cheap to call every time round loop(). Setting
+//Timer2 through SetFrequency_8/SetFrequencyHR_8 turns the extension off again. The
+//library owns TIMER2_OVF_vect for this, so a sketch cannot define it.
+
+static volatile uint8_t extTop;
+static volatile uint16_t extFraction;
+static volatile uint16_t extAccumulator;
+static volatile uint8_t extPrescaler;	//CS2 bits the TOPs above are for
+static volatile bool extSwitching;		//a TOP for extPrescaler has been written
+static uint32_t extRequest;
+
+//TOP to scale Timer2's duty to: OCR2A takes turns at TOP and TOP + 1 while dithering
+static uint8_t timer2DutyTop()
+{
+	return (TIMSK2 & _BV(TOIE2)) ? extTop : GetTop_8(TIMER2_OFFSET);
+}
+
+ISR(TIMER2_OVF_vect)
+{
+	if((TCCR2B & 7) != extPrescaler)
+	{
+		if(extSwitching)
+			TCCR2B = (TCCR2B & ~7) | extPrescaler;
+		extSwitching = !extSwitching;
+	}
+	
+	uint16_t last = extAccumulator;
+	uint16_t acc = last + extFraction;
+	
+	OCR2A = acc < last ? extTop + 1 : extTop;		//carried
+	extAccumulator = acc;
+}
+
+uint32_t SetFrequencyExt_8(const int16_t timerOffset, uint32_t millihertz)
+{
+	if(timerOffset != TIMER2_OFFSET || millihertz > 2000000000UL || millihertz < 1)
+		return 0;
+	
+	if((TIMSK2 & _BV(TOIE2)) && millihertz == extRequest)
+		return extMilliHz;
+	
+	//the smallest prescaler that leaves room for TOP + 1 gives the least jitter
+	uint8_t iterate;
+	uint64_t div, top16;
+	
+	for(iterate = 1; iterate < sizeof(pscLst_alt)/sizeof(pscLst_alt[0]); iterate++)
+	{
+		div = (uint64_t)2 * pscLst_alt[iterate] * millihertz;
+		top16 = (((uint64_t)F_CPU * 1000 << 16) + div / 2) / div;		//TOP in 16.16 fixed point
+		
+		if(top16 < ((uint64_t)UINT8_MAX << 16))
+			break;
+	}
+	
+	if(iterate == sizeof(pscLst_alt)/sizeof(pscLst_alt[0]) || top16 < ((uint64_t)1 << 16))
+		return 0;
+	
+	uint8_t oldSREG = SREG;
+	cli();
+	
+	extTop = top16 >> 16;
+	extFraction = top16 & 0xFFFF;
+	
+	//starting up: the ISR carries on from the TOP set here
+	if(!(TIMSK2 & _BV(TOIE2)))
+	{
+		SetTop_8(timerOffset, extTop);
+		SetPrescalerAlt_8(timerOffset, (prescaler_alt)iterate);
+		extPrescaler = iterate;
+		extSwitching = false;
+		TIFR2 = _BV(TOV2);
+		TIMSK2 |= _BV(TOIE2);
+	}
+	//changing range: the ISR switches over
+	else if(extPrescaler != iterate)
+	{
+		extPrescaler = iterate;
+		extSwitching = false;
+	}
+	
+	SREG = oldSREG;
+	
+	extRequest = millihertz;
+	extMilliHz = (((uint64_t)F_CPU * 1000 << 16) + top16 * pscLst_alt[iterate]) / (2 * top16 * pscLst_alt[iterate]);
+	return extMilliHz;
+}
+
+//--------------------------------------------------------------------------------
+//						Timer1 Latched Updates
+//--------------------------------------------------------------------------------
+
+//ICR1 holds TOP in mode 8 and is not double buffered. Written below the counter while
+//it counts up, TOP is missed: the counter runs on to 0xFFFF and wraps round first,
+//which drops a whole PWM period (~33 ms more at 80 Hz). A new prescaler acts at once
+//as well, part way through a period. UpdateFrequencyHR_16 is for a frequency that
+//changes while the timer runs. It works out a setting only when the frequency asked
+//for differs from the last one, and writes nothing if the timer already runs at it.
+//Otherwise it leaves TOP and prescaler to the overflow interrupt, which writes them
+//at BOTTOM, where OCR1A/OCR1B are taken up too, and then switches itself off.
+//
+//The interrupt gets there a few ticks after BOTTOM, which only matters for a TOP that
+//small (hundreds of kHz at /1). pwmWrite scales to the TOP in ICR1, so a duty written
+//before the update has been taken up is scaled to the old one. The library owns
+//TIMER1_OVF_vect for this, so a sketch cannot define it. SetFrequency_16 and
+//SetFrequencyHR_16 still write at once and cancel an update that is waiting.
+
+static volatile uint16_t updateTop;
+static volatile uint8_t updatePrescaler;
+static uint32_t updateMilliHz;
+
+ISR(TIMER1_OVF_vect)
+{
+	ICR1 = updateTop;
+	TCCR1B = (TCCR1B & ~7) | updatePrescaler;
+	TIMSK1 &= ~_BV(TOIE1);
+}
+
+uint32_t UpdateFrequencyHR_16(uint32_t millihertz)
+{
+	if(millihertz > 2000000000UL || millihertz < 1)
+		return 0;
+	
+	if(millihertz == updateRequest)
+		return updateMilliHz;
+	
+	uint16_t timerTop;
+	uint8_t iterate = closestSetting(millihertz, pscLst, sizeof(pscLst)/sizeof(pscLst[0]), UINT16_MAX, &timerTop);
+	
+	if(!iterate)
+		return 0;
+	
+	uint8_t oldSREG = SREG;
+	cli();
+	
+	//neighbouring frequencies can come down to the same setting
+	if(GetTop_16() == timerTop && (TCCR1B & 7) == iterate)
+		TIMSK1 &= ~_BV(TOIE1);
+	//stopped: there is no BOTTOM to wait for
+	else if(!(TCCR1B & 7))
+	{
+		SetTop_16(timerTop);
+		SetPrescaler_16((prescaler)iterate);
+	}
+	else
+	{
+		updateTop = timerTop;
+		updatePrescaler = iterate;
+		
+		//TOV1 is left set by every BOTTOM that went by unhandled
+		if(!(TIMSK1 & _BV(TOIE1)))
+		{
+			TIFR1 = _BV(TOV1);
+			TIMSK1 |= _BV(TOIE1);
+		}
+	}
+	
+	SREG = oldSREG;
+	
+	updateRequest = millihertz;
+	updateMilliHz = topToMilliHz(timerTop, pscLst[iterate]);
+	return updateMilliHz;
+}
+
 //--------------------------------------------------------------------------------
 //							Timer Independent Functions
 //--------------------------------------------------------------------------------
@@ -246,7 +503,7 @@ void pwmWrite(uint8_t pin, uint8_t val)
 			case TIMER2B:
 			sbi(TCCR2A, COM2B1);
 			regLoc8 = OCR2B_MEM;
-			top = Timer2_GetTop();
+			top = timer2DutyTop();
 			break;
 			case NOT_ON_TIMER:
 			default:
@@ -302,7 +559,7 @@ void pwmWriteHR(uint8_t pin, uint16_t val)
 			case TIMER2B:
 			sbi(TCCR2A, COM2B1);
 			regLoc8 = OCR2B_MEM;
-			top = Timer2_GetTop();
+			top = timer2DutyTop();
 			break;
 			case NOT_ON_TIMER:
 			default:
@@ -359,6 +616,66 @@ bool SetPinFrequencySafe(int8_t pin, uint32_t frequency)
 		return false;
 }
 
+uint32_t SetPinFrequencyHR(int8_t pin, uint32_t millihertz)
+{
+	uint8_t timer = digitalPinToTimer(pin);
+	
+	if(timer == TIMER0B)
+		return Timer0_SetFrequencyHR(millihertz);
+	else if(timer == TIMER1A || timer == TIMER1B)
+		return Timer1_SetFrequencyHR(millihertz);
+	else if(timer == TIMER2B)
+		return Timer2_SetFrequencyHR(millihertz);
+	else
+		return 0;
+}
+
+uint32_t SetPinFrequencySafeHR(int8_t pin, uint32_t millihertz)
+{
+	uint8_t timer = digitalPinToTimer(pin);
+	
+	if(timer == TIMER1A || timer == TIMER1B)
+		return Timer1_SetFrequencyHR(millihertz);
+	else if(timer == TIMER2B)
+		return Timer2_SetFrequencyHR(millihertz);
+	else
+		return 0;
+}
+
+uint32_t GetPinFrequencyHR(int8_t pin)
+{
+	uint8_t timer = digitalPinToTimer(pin);
+	
+	if(timer == TIMER0B)
+		return Timer0_GetFrequencyHR();
+	else if(timer == TIMER1A || timer == TIMER1B)
+		return Timer1_GetFrequencyHR();
+	else if(timer == TIMER2B)
+		return Timer2_GetFrequencyHR();
+	else
+		return 0;
+}
+
+uint32_t SetPinFrequencyExt(int8_t pin, uint32_t millihertz)
+{
+	if(digitalPinToTimer(pin) == TIMER2B)
+		return Timer2_SetFrequencyExt(millihertz);
+	else
+		return 0;
+}
+
+uint32_t UpdatePinFrequencyHR(int8_t pin, uint32_t millihertz)
+{
+	uint8_t timer = digitalPinToTimer(pin);
+	
+	if(timer == TIMER1A || timer == TIMER1B)
+		return Timer1_UpdateFrequencyHR(millihertz);
+	else if(timer == TIMER2B)
+		return Timer2_SetFrequencyExt(millihertz);
+	else
+		return 0;
+}
+
 float GetPinResolution(uint8_t pin)
 {
 	uint8_t timer = digitalPinToTimer(pin);	
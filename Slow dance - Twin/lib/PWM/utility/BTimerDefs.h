@@ -80,6 +80,8 @@ enum prescaler_alt
 //macros for each timer 'object'
 #define Timer0_GetFrequency()	GetFrequency_8(TIMER0_OFFSET)
 #define Timer0_SetFrequency(x)	SetFrequency_8(TIMER0_OFFSET, x)
+#define Timer0_GetFrequencyHR()	GetFrequencyHR_8(TIMER0_OFFSET)
+#define Timer0_SetFrequencyHR(x)	SetFrequencyHR_8(TIMER0_OFFSET, x)
 #define Timer0_GetPrescaler()	GetPrescaler_8(TIMER0_OFFSET)
 #define Timer0_SetPrescaler(x)	SetPrescaler_8(TIMER0_OFFSET, x)
 #define Timer0_GetTop()			GetTop_8(TIMER0_OFFSET)
@@ -89,6 +91,9 @@ enum prescaler_alt
 
 #define Timer1_GetFrequency()	GetFrequency_16()
 #define Timer1_SetFrequency(x)	SetFrequency_16(x)
+#define Timer1_GetFrequencyHR()	GetFrequencyHR_16()
+#define Timer1_SetFrequencyHR(x)	SetFrequencyHR_16(x)
+#define Timer1_UpdateFrequencyHR(x)	UpdateFrequencyHR_16(x)
 #define Timer1_GetPrescaler()	GetPrescaler_16()
 #define Timer1_SetPrescaler(x)	SetPrescaler_16(x)
 #define Timer1_GetTop()			GetTop_16()
@@ -98,6 +103,9 @@ enum prescaler_alt
 
 #define Timer2_GetFrequency()	GetFrequency_8(TIMER2_OFFSET)
 #define Timer2_SetFrequency(x)	SetFrequency_8(TIMER2_OFFSET, x)
+#define Timer2_GetFrequencyHR()	GetFrequencyHR_8(TIMER2_OFFSET)
+#define Timer2_SetFrequencyHR(x)	SetFrequencyHR_8(TIMER2_OFFSET, x)
+#define Timer2_SetFrequencyExt(x)	SetFrequencyExt_8(TIMER2_OFFSET, x)
 #define Timer2_GetPrescaler()	GetPrescaler_8(TIMER2_OFFSET)
 #define Timer2_SetPrescaler(x)	SetPrescalerAlt_8(TIMER2_OFFSET, x)
 #define Timer2_GetTop()			GetTop_8(TIMER2_OFFSET)
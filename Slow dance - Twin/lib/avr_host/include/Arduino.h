@@ -0,0 +1,75 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Arduino AVR core API for the host (avr_sim.h): the parts the sketch and
+// lib/PWM use, on an ATmega328P board (Pro Mini, 16 MHz).
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+// The binary constants lib/PWM masks registers with (binary.h)
+#define B11100111 231
+#define B11110111 247
+#define B11111100 252
+#define B11111110 254
+
+// ============================================
+// Pins / Timers
+// ============================================
+
+#define NOT_ON_TIMER 0
+#define TIMER0A 1
+#define TIMER0B 2
+#define TIMER1A 3
+#define TIMER1B 4
+#define TIMER1C 5
+#define TIMER2 6
+#define TIMER2A 7
+#define TIMER2B 8
+
+#define NUM_DIGITAL_PINS 20
+
+// The PWM pins of the 328P
+#define digitalPinToTimer(p) \
+  ((p) == 3 ? TIMER2B : (p) == 5 ? TIMER0B : (p) == 6 ? TIMER0A : \
+   (p) == 9 ? TIMER1A : (p) == 10 ? TIMER1B : (p) == 11 ? TIMER2A : NOT_ON_TIMER)
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);   // disconnects the pin's timer output, as the core does
+int digitalRead(uint8_t pin);
+
+// ============================================
+// Time
+// ============================================
+// Timer0 is not modelled; time is the CPU cycle count of the model.
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Arduino sketch entry points
+void setup();
+void loop();
+
+#endif // ARDUINO_H
@@ -0,0 +1,21 @@
+#ifndef AVR_INTERRUPT_H
+#define AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+// Handlers are plain functions the timer model calls (avr_sim.h); the
+// vector names map onto them
+#define ISR(vector, ...) extern "C" void vector(void)
+
+#define TIMER2_COMPA_vect avrSimTimer2CompA
+#define TIMER2_COMPB_vect avrSimTimer2CompB
+#define TIMER2_OVF_vect avrSimTimer2Ovf
+#define TIMER1_COMPA_vect avrSimTimer1CompA
+#define TIMER1_COMPB_vect avrSimTimer1CompB
+#define TIMER1_OVF_vect avrSimTimer1Ovf
+
+// sei() takes interrupts that became pending while they were off
+void sei();
+void cli();
+
+#endif // AVR_INTERRUPT_H
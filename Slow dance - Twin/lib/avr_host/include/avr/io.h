@@ -0,0 +1,102 @@
+#ifndef AVR_IO_H
+#define AVR_IO_H
+
+#include <stdint.h>
+
+// ATmega328P registers in a host array at their data-memory addresses, so
+// code that goes through _SFR_MEM8/16 with raw addresses (lib/PWM) works
+// unchanged. Only the timer registers mean anything (avr_sim.h).
+
+extern volatile uint8_t avrSimMem[0x100];
+
+#define _SFR_MEM8(addr) (*(volatile uint8_t *)(avrSimMem + (addr)))
+#define _SFR_MEM16(addr) (*(volatile uint16_t *)(avrSimMem + (addr)))   // little endian, as the AVR
+#define _BV(bit) (1 << (bit))
+
+// Interrupt flags clear where a one is written, as on the chip
+struct AvrSimFlagRegister {
+  uint8_t addr;
+  operator uint8_t() const { return _SFR_MEM8(addr); }
+  void operator=(uint8_t value) const { _SFR_MEM8(addr) &= ~value; }
+};
+
+#define TIFR0 (AvrSimFlagRegister{0x35})
+#define TIFR1 (AvrSimFlagRegister{0x36})
+#define TIFR2 (AvrSimFlagRegister{0x37})
+#define SREG _SFR_MEM8(0x5F)
+
+#define TIMSK0 _SFR_MEM8(0x6E)
+#define TIMSK1 _SFR_MEM8(0x6F)
+#define TIMSK2 _SFR_MEM8(0x70)
+
+#define TCCR0A _SFR_MEM8(0x44)
+#define TCCR0B _SFR_MEM8(0x45)
+#define TCNT0 _SFR_MEM8(0x46)
+#define OCR0A _SFR_MEM8(0x47)
+#define OCR0B _SFR_MEM8(0x48)
+
+#define TCCR1A _SFR_MEM8(0x80)
+#define TCCR1B _SFR_MEM8(0x81)
+#define TCCR1C _SFR_MEM8(0x82)
+#define TCNT1 _SFR_MEM16(0x84)
+#define ICR1 _SFR_MEM16(0x86)
+#define OCR1A _SFR_MEM16(0x88)
+#define OCR1B _SFR_MEM16(0x8A)
+
+#define TCCR2A _SFR_MEM8(0xB0)
+#define TCCR2B _SFR_MEM8(0xB1)
+#define TCNT2 _SFR_MEM8(0xB2)
+#define OCR2A _SFR_MEM8(0xB3)
+#define OCR2B _SFR_MEM8(0xB4)
+
+// TCCRnA
+#define COM0A1 7
+#define COM0A0 6
+#define COM0B1 5
+#define COM0B0 4
+#define COM1A1 7
+#define COM1A0 6
+#define COM1B1 5
+#define COM1B0 4
+#define COM2A1 7
+#define COM2A0 6
+#define COM2B1 5
+#define COM2B0 4
+#define WGM01 1
+#define WGM00 0
+#define WGM21 1
+#define WGM20 0
+#define WGM11 1
+#define WGM10 0
+
+// TCCRnB
+#define WGM13 4
+#define WGM12 3
+#define WGM22 3
+#define CS01 1
+#define CS00 0
+#define CS22 2
+#define CS21 1
+#define CS20 0
+#define CS12 2
+#define CS11 1
+#define CS10 0
+
+// TIMSKn / TIFRn
+#define OCIE2B 2
+#define OCIE2A 1
+#define TOIE2 0
+#define OCIE1B 2
+#define OCIE1A 1
+#define TOIE1 0
+#define TOIE0 0
+#define OCF2B 2
+#define OCF2A 1
+#define TOV2 0
+#define OCF1B 2
+#define OCF1A 1
+#define TOV1 0
+
+#define SREG_I 7
+
+#endif // AVR_IO_H
@@ -0,0 +1,9 @@
+#ifndef AVR_PGMSPACE_H
+#define AVR_PGMSPACE_H
+
+// One address space on the host
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+
+#endif // AVR_PGMSPACE_H
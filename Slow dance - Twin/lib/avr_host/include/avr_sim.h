@@ -0,0 +1,67 @@
+#ifndef AVR_SIM_H
+#define AVR_SIM_H
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+// ============================================
+// ATmega328P Timer Model
+// ============================================
+// env:bench builds lib/PWM for the host against this library. The I/O
+// registers are an array (avr/io.h) and Timer1 and Timer2 are modelled on
+// a clock of CPU cycles, event by event rather than tick by tick:
+//
+// - The dual-slope (phase correct / phase and frequency correct) PWM
+//   modes run, as lib/PWM sets up: Timer1 modes 1-3 and 8-11, Timer2
+//   modes 1 and 5. A timer in any other mode, or with no clock selected,
+//   stands still.
+// - OCRnx and an OCRnA TOP are double buffered and taken up at TOP or
+//   BOTTOM as the datasheet says for the mode; the down slope still starts
+//   from the TOP the counter turned at. A new prescaler acts at once, and
+//   so does ICR1 as TOP while counting up: set below the counter, TOP is
+//   missed and the counter runs on to MAX and wraps first. The mode is
+//   looked at on the next TOP or BOTTOM.
+// - Compare outputs drive their pin while COMnx1 is set and the pin is an
+//   output, clearing on the up-count match and setting on the down-count
+//   match (inverted for COMnx1:0 = 3). OCR at BOTTOM holds the output low,
+//   at or above TOP holds it high.
+// - TOVn is set at BOTTOM and OCFnx on a match; with the interrupt enabled
+//   in TIMSKn and SREG's I bit set the handler runs at the exact cycle
+//   (ISR(TIMERn_..._vect)) and takes no time itself. Writing a one to a
+//   TIFRn bit clears it.
+//
+// Timer0 is not modelled: millis() and micros() come from the cycle count.
+// Pin changes are recorded with their cycle.
+
+#define AVR_SIM_PINS 20   // D0-D13, A0-A5
+
+struct AvrSimEdge {
+  uint64_t cycle;
+  uint8_t pin;
+  uint8_t level;
+};
+
+// Registers, pins and the clock as the Arduino core's init() leaves them:
+// Timer1 and Timer2 in 8-bit phase correct PWM at /64, interrupts on.
+void avrSimReset();
+
+// Run the timers for `cycles` CPU cycles, calling interrupt handlers as
+// they fall due.
+void avrSimRun(uint64_t cycles);
+
+uint64_t avrSimNow();
+
+int avrSimGetPin(int pin);
+
+// Pin changes since the last avrSimClearEdges(), oldest first.
+const std::vector<AvrSimEdge> &avrSimEdges();
+void avrSimClearEdges();
+
+// Called on every pin change as well.
+void avrSimOnEdge(std::function<void(const AvrSimEdge &)> fn);
+
+// Interrupt handlers run since the last avrSimReset().
+uint64_t avrSimInterrupts();
+
+#endif // AVR_SIM_H
@@ -0,0 +1,9 @@
+#ifndef WIRING_PRIVATE_H
+#define WIRING_PRIVATE_H
+
+#include <Arduino.h>
+
+#define cbi(sfr, bit) ((sfr) &= ~_BV(bit))
+#define sbi(sfr, bit) ((sfr) |= _BV(bit))
+
+#endif // WIRING_PRIVATE_H
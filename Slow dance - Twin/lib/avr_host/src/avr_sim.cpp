@@ -0,0 +1,370 @@
+#include "avr_sim.h"
+
+#include <Arduino.h>
+#include <wiring_private.h>
+#include <algorithm>
+
+volatile uint8_t avrSimMem[0x100];
+
+static uint64_t now = 0;
+static uint64_t interruptCount = 0;
+
+// Handlers the sketch does not define
+extern "C" {
+__attribute__((weak)) void avrSimTimer2CompA(void) {}
+__attribute__((weak)) void avrSimTimer2CompB(void) {}
+__attribute__((weak)) void avrSimTimer2Ovf(void) {}
+__attribute__((weak)) void avrSimTimer1CompA(void) {}
+__attribute__((weak)) void avrSimTimer1CompB(void) {}
+__attribute__((weak)) void avrSimTimer1Ovf(void) {}
+}
+
+// ============================================
+// Timers
+// ============================================
+
+enum TopSource { TOP_FIXED, TOP_ICR1, TOP_OCRA };
+
+struct TimerMode {
+  bool supported;
+  TopSource source;
+  uint16_t fixedTop;
+  bool latchAtBottom;   // OCRnx buffers update at BOTTOM rather than TOP
+};
+
+struct SimTimer {
+  // Registers
+  uint8_t tccra, tccrb, tcnt, ocra, ocrb, timsk, tifr;
+  bool wide;
+  uint8_t pins[2];                // OCnA, OCnB
+  void (*handlers[3])(void);      // compare A, compare B, overflow: vector order
+
+  // Counter
+  bool running = false;
+  bool up = true;                 // counting up from BOTTOM
+  uint64_t halfAt = 0;            // cycle of the last BOTTOM or TOP
+  uint64_t halfEnd = 0;           // cycle of the next one
+  uint16_t psc = 0;
+  uint16_t top = 0;
+  uint32_t span = 0;              // ticks in this slope: TOP, or more after a missed TOP
+  uint16_t ocr[2] = {};           // buffered compare values
+  uint64_t matchAt[2] = {};       // UINT64_MAX: no match this slope
+  uint8_t oc[2] = {};             // compare output, non-inverted
+};
+
+static SimTimer timers[] = {
+  {0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0x70, 0x37, false, {11, 3},
+   {avrSimTimer2CompA, avrSimTimer2CompB, avrSimTimer2Ovf}},
+  {0x80, 0x81, 0x84, 0x88, 0x8A, 0x6F, 0x36, true, {9, 10},
+   {avrSimTimer1CompA, avrSimTimer1CompB, avrSimTimer1Ovf}},
+};
+
+static const uint16_t PSC_TIMER1[] = {0, 1, 8, 64, 256, 1024, 0, 0};   // 6, 7: external clock
+static const uint16_t PSC_TIMER2[] = {0, 1, 8, 32, 64, 128, 256, 1024};
+
+static uint16_t readReg(const SimTimer &t, uint8_t addr) {
+  return t.wide ? _SFR_MEM16(addr) : _SFR_MEM8(addr);
+}
+
+static TimerMode modeOf(const SimTimer &t) {
+  uint8_t wgm = (_SFR_MEM8(t.tccra) & 3) | ((_SFR_MEM8(t.tccrb) >> 1) & (t.wide ? 12 : 4));
+  if (!t.wide) {
+    switch (wgm) {
+      case 1: return {true, TOP_FIXED, 0xFF, false};
+      case 5: return {true, TOP_OCRA, 0, false};
+    }
+  } else {
+    switch (wgm) {
+      case 1: return {true, TOP_FIXED, 0xFF, false};
+      case 2: return {true, TOP_FIXED, 0x1FF, false};
+      case 3: return {true, TOP_FIXED, 0x3FF, false};
+      case 8: return {true, TOP_ICR1, 0, true};
+      case 9: return {true, TOP_OCRA, 0, true};
+      case 10: return {true, TOP_ICR1, 0, false};
+      case 11: return {true, TOP_OCRA, 0, false};
+    }
+  }
+  return {false, TOP_FIXED, 0, false};
+}
+
+// Work out when the compare matches still ahead on this slope, after
+// `done` ticks of it, fall
+static void planMatches(SimTimer &t, uint32_t done) {
+  for (int ch = 0; ch < 2; ch++) {
+    uint16_t ocr = t.ocr[ch];
+    t.matchAt[ch] = UINT64_MAX;
+    if (!ocr) continue;
+    for (uint32_t p = t.up ? ocr : (uint32_t)t.top - ocr; p < t.span; p += 0x10000) {
+      if (p <= done) continue;
+      t.matchAt[ch] = t.halfAt + (uint64_t)p * t.psc;
+      break;
+    }
+  }
+}
+
+// Start a slope at `at`: up from BOTTOM or down from TOP. Takes up what
+// the mode buffers there and works out the compare matches on the way.
+static void startSlope(SimTimer &t, uint64_t at, bool up) {
+  TimerMode mode = modeOf(t);
+  uint8_t cs = _SFR_MEM8(t.tccrb) & 7;
+  uint16_t psc = t.wide ? PSC_TIMER1[cs] : PSC_TIMER2[cs];
+  if (!mode.supported || !psc) {
+    t.running = false;
+    return;
+  }
+  if (!t.running || mode.latchAtBottom == up) {
+    t.ocr[0] = readReg(t, t.ocra);
+    t.ocr[1] = readReg(t, t.ocrb);
+  }
+  // Down from where the counter turned, whatever TOP has been set since
+  uint16_t top = !up && t.running ? t.top
+               : mode.source == TOP_FIXED ? mode.fixedTop
+               : mode.source == TOP_ICR1 ? ICR1 : t.ocr[0];
+  if (!top) {
+    t.running = false;
+    return;
+  }
+
+  t.running = true;
+  t.up = up;
+  t.halfAt = at;
+  t.halfEnd = at + (uint64_t)top * psc;
+  t.psc = psc;
+  t.top = top;
+  t.span = top;
+  if (up) _SFR_MEM8(t.tifr) |= _BV(TOV1);
+
+  for (int ch = 0; ch < 2; ch++) {
+    uint16_t ocr = t.ocr[ch];
+    if (ocr == 0) {
+      t.oc[ch] = LOW;
+      if (up) _SFR_MEM8(t.tifr) |= _BV(OCF1A + ch);
+    } else if (ocr >= top) {
+      t.oc[ch] = HIGH;
+      if (!up && ocr == top) _SFR_MEM8(t.tifr) |= _BV(OCF1A + ch);
+    }
+  }
+  planMatches(t, 0);
+}
+
+// Take up what acts at once rather than at TOP or BOTTOM: a new prescaler,
+// and ICR1 as TOP while counting up. The counter carries on from where it
+// is; with TOP set below it, it misses TOP, runs on to MAX and wraps round
+// to BOTTOM first, as the datasheet warns for an unbuffered TOP.
+static void followRegisters(SimTimer &t) {
+  if (!t.running) return;
+  uint8_t cs = _SFR_MEM8(t.tccrb) & 7;
+  uint16_t psc = t.wide ? PSC_TIMER1[cs] : PSC_TIMER2[cs];
+  uint16_t top = t.up && modeOf(t).source == TOP_ICR1 ? ICR1 : t.top;
+  if (!psc || !top || (psc == t.psc && top == t.top)) return;
+
+  uint32_t done = (now - t.halfAt) / t.psc;
+  uint16_t count = done;
+  t.halfAt = now - (uint64_t)done * psc;
+  t.psc = psc;
+  t.top = top;
+  t.span = t.up ? (done & ~0xFFFFu) + top + (top < count ? 0x10000 : 0) : top;
+  t.halfEnd = t.halfAt + (uint64_t)t.span * psc;
+  planMatches(t, done);
+}
+
+static void syncCounter(SimTimer &t) {
+  if (!t.running) return;
+  uint16_t ticks = (now - t.halfAt) / t.psc;   // wraps past MAX
+  uint16_t count = t.up ? ticks : t.top - ticks;
+  if (t.wide) _SFR_MEM16(t.tcnt) = count;
+  else _SFR_MEM8(t.tcnt) = count;
+}
+
+// ============================================
+// Pins
+// ============================================
+
+static uint8_t ddr[AVR_SIM_PINS];
+static uint8_t port[AVR_SIM_PINS];
+static uint8_t levels[AVR_SIM_PINS];
+static std::vector<AvrSimEdge> edges;
+static std::vector<std::function<void(const AvrSimEdge &)>> edgeListeners;
+
+static void updatePins() {
+  for (int pin = 0; pin < AVR_SIM_PINS; pin++) {
+    uint8_t level = port[pin];
+    if (ddr[pin]) {
+      for (SimTimer &t : timers) {
+        for (int ch = 0; ch < 2; ch++) {
+          if (t.pins[ch] != pin) continue;
+          uint8_t com = (_SFR_MEM8(t.tccra) >> (ch ? COM1B0 : COM1A0)) & 3;
+          if (com & 2) level = t.oc[ch] ^ (com == 3);
+        }
+      }
+    }
+    if (level == levels[pin]) continue;
+    levels[pin] = level;
+    AvrSimEdge edge = {now, (uint8_t)pin, level};
+    edges.push_back(edge);
+    for (auto &fn : edgeListeners) fn(edge);
+  }
+}
+
+// ============================================
+// Interrupts
+// ============================================
+
+// Run the handlers of pending, enabled interrupts, highest priority first
+static void service() {
+  for (;;) {
+    if (!(SREG & _BV(SREG_I))) return;
+    SimTimer *due = NULL;
+    int bit = 0;
+    for (SimTimer &t : timers) {
+      uint8_t pending = _SFR_MEM8(t.tifr) & _SFR_MEM8(t.timsk) & 7;
+      if (!pending) continue;
+      due = &t;
+      bit = pending & _BV(OCF1A) ? OCF1A : pending & _BV(OCF1B) ? OCF1B : TOV1;
+      break;
+    }
+    if (!due) return;
+    _SFR_MEM8(due->tifr) &= ~_BV(bit);
+    SREG &= ~_BV(SREG_I);
+    interruptCount++;
+    due->handlers[bit == TOV1 ? 2 : bit - OCF1A]();
+    SREG |= _BV(SREG_I);
+    updatePins();
+  }
+}
+
+void sei() {
+  SREG |= _BV(SREG_I);
+  service();
+}
+
+void cli() {
+  SREG &= ~_BV(SREG_I);
+}
+
+// ============================================
+// Clock
+// ============================================
+
+void avrSimReset() {
+  for (size_t i = 0; i < sizeof(avrSimMem); i++) avrSimMem[i] = 0;
+  TCCR0A = _BV(WGM01) | _BV(WGM00);
+  TCCR0B = _BV(CS01) | _BV(CS00);
+  TIMSK0 = _BV(TOIE0);
+  TCCR1A = _BV(WGM10);
+  TCCR1B = _BV(CS11) | _BV(CS10);
+  TCCR2A = _BV(WGM20);
+  TCCR2B = _BV(CS22);
+  SREG = _BV(SREG_I);
+
+  now = 0;
+  interruptCount = 0;
+  for (SimTimer &t : timers) t.running = false;
+  memset(ddr, 0, sizeof(ddr));
+  memset(port, 0, sizeof(port));
+  memset(levels, 0, sizeof(levels));
+  edges.clear();
+}
+
+void avrSimRun(uint64_t cycles) {
+  uint64_t end = now + cycles;
+  for (;;) {
+    for (SimTimer &t : timers) {
+      if (!t.running) startSlope(t, now, true);
+      followRegisters(t);
+      syncCounter(t);
+    }
+    updatePins();
+    service();
+    for (SimTimer &t : timers) followRegisters(t);
+
+    uint64_t next = UINT64_MAX;
+    for (const SimTimer &t : timers) {
+      if (!t.running) continue;
+      next = std::min({next, t.halfEnd, t.matchAt[0], t.matchAt[1]});
+    }
+    if (next > end) break;
+    now = next;
+
+    for (SimTimer &t : timers) {
+      if (!t.running) continue;
+      for (int ch = 0; ch < 2; ch++) {
+        if (t.matchAt[ch] != now) continue;
+        t.oc[ch] = t.up ? LOW : HIGH;
+        t.matchAt[ch] = UINT64_MAX;
+        _SFR_MEM8(t.tifr) |= _BV(OCF1A + ch);
+      }
+      if (t.halfEnd == now) startSlope(t, now, !t.up);
+    }
+  }
+  now = end;
+  for (SimTimer &t : timers) syncCounter(t);
+  updatePins();
+}
+
+uint64_t avrSimNow() {
+  return now;
+}
+
+uint64_t avrSimInterrupts() {
+  return interruptCount;
+}
+
+int avrSimGetPin(int pin) {
+  return pin >= 0 && pin < AVR_SIM_PINS ? levels[pin] : LOW;
+}
+
+const std::vector<AvrSimEdge> &avrSimEdges() {
+  return edges;
+}
+
+void avrSimClearEdges() {
+  edges.clear();
+}
+
+void avrSimOnEdge(std::function<void(const AvrSimEdge &)> fn) {
+  edgeListeners.push_back(fn);
+}
+
+// ============================================
+// Arduino Core
+// ============================================
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= AVR_SIM_PINS) return;
+  ddr[pin] = mode == OUTPUT;
+  if (mode != OUTPUT) port[pin] = mode == INPUT_PULLUP;
+  updatePins();
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin >= AVR_SIM_PINS) return;
+  switch (digitalPinToTimer(pin)) {
+    case TIMER1A: cbi(TCCR1A, COM1A1); break;
+    case TIMER1B: cbi(TCCR1A, COM1B1); break;
+    case TIMER2A: cbi(TCCR2A, COM2A1); break;
+    case TIMER2B: cbi(TCCR2A, COM2B1); break;
+  }
+  port[pin] = level ? HIGH : LOW;
+  updatePins();
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < AVR_SIM_PINS ? levels[pin] : LOW;
+}
+
+unsigned long millis() {
+  return now / (F_CPU / 1000);
+}
+
+unsigned long micros() {
+  return now / (F_CPU / 1000000);
+}
+
+void delay(unsigned long ms) {
+  avrSimRun((uint64_t)ms * (F_CPU / 1000));
+}
+
+void delayMicroseconds(unsigned int us) {
+  avrSimRun((uint64_t)us * (F_CPU / 1000000));
+}
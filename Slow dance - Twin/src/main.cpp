@@ -40,10 +40,12 @@ float duty_led = 7;
 float frequency_led = frequency_eMagnet+frequency_offset; 
 
 int lastBrightnessValue = 0;
+uint32_t lastLedMilliHz = 0;      // LED frequency last handed to lib/PWM
 
 unsigned long lastmillis, minutes = 60000 * 15; // switch off after 15 minutes.
 
 // Function Declarations
+uint32_t milliHz(float hz);
 void freqUp();
 void freqDn();
 void eMagnet_on();
@@ -63,12 +65,13 @@ void setup()
   //initialize all timers except for 0, to save time keeping functions
   InitTimersSafe(); 
 
-  //sets the frequency for the specified pin
-  bool success = SetPinFrequencySafe(LED_strip, frequency_led);
+  //sets the frequency for the specified pin, returns the one the timer actually runs at in mHz (0 = failed)
+  lastLedMilliHz = milliHz(frequency_led);
+  uint32_t success = SetPinFrequencyExt(LED_strip, lastLedMilliHz);   // Timer2 is 8 bit: dither its TOP for a fine LED frequency
   //Serial.println(success);
-  bool success2 = SetPinFrequencySafe(EMagnet, frequency_eMagnet);
+  uint32_t success2 = SetPinFrequencySafeHR(EMagnet, milliHz(frequency_eMagnet));
   //Serial.println(success2);
-  bool success3 = SetPinFrequencySafe(EMagnet2, frequency_eMagnet);
+  uint32_t success3 = SetPinFrequencySafeHR(EMagnet2, milliHz(frequency_eMagnet));
   //Serial.println(success3);
   
   lastmillis = millis();
@@ -112,7 +115,10 @@ void loop()
   if (led_on == true){
     duty_led = MAX_BRIGHTNESS;  //Brightness: duty_led 2..20
     frequency_led = frequency_eMagnet+frequency_offset;
-    SetPinFrequencySafe(LED_strip, frequency_led);
+    if (milliHz(frequency_led) != lastLedMilliHz) {   // only on a change; lib/PWM takes it up at the timer's BOTTOM
+      lastLedMilliHz = milliHz(frequency_led);
+      UpdatePinFrequencyHR(LED_strip, lastLedMilliHz);
+    }
   }
   else {
     duty_led = 0;      
@@ -225,6 +231,15 @@ void freqDn(){
 }
 */
 
+//**********************************************************************************************************************************************************
+// lib/PWM takes frequencies in millihertz, so 79.8 Hz stays 79.8 Hz rather than becoming 79
+uint32_t milliHz(float hz)
+{
+  return (uint32_t)(hz * 1000 + 0.5);
+}
+
+
+
 //**********************************************************************************************************************************************************
 void eMagnet_on() 
 {
@@ -0,0 +1,151 @@
+// JSON reader timing on the host: the request bodies the firmware parses,
+// through json_reader, next to the String/indexOf/toFloat scan that
+// handleSetSettings() used before it. Reports host time and heap
+// allocations per document; the allocation count is the number that
+// matters on the ESP32, the time only compares the two.
+//
+//   pio run -e bench_json && .pio/build/bench_json/program [--iterations N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+#include <string>
+#include "json_reader.h"
+
+#define BENCH_ITERATIONS 200000
+#define BENCH_REPEATS 5   // best of, against scheduler noise
+
+static uint64_t allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  void *p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+static volatile double sink;
+
+static const char SETTINGS_BODY[] =
+  "{\"ledFreq\": 80.5, \"ledDuty\": 10, \"magFreq\": 79.8, \"magDuty\": 35}";
+static const char SETTINGS_BAD[] =
+  "{\"ledFreq\": 80.5, \"ledDuty\": 10, \"magFreq\": 79.8, \"magDuty\": 35,}";
+static const char TIMELINE_BODY[] =
+  "{\"loop\": true, \"keyframes\": [{\"beat\": 0.5, \"ms\": 4000, \"ease\": \"smooth\"},"
+  " {\"beat\": -0.25, \"ledDuty\": 12.5, \"magDuty\": 30, \"ms\": 2500, \"ease\": \"step\"},"
+  " {\"beat\": 0, \"ms\": 10000, \"ease\": \"linear\"}]}";
+
+struct Settings {
+  float ledFreq, ledDuty, magFreq, magDuty, mag2Duty, mag2Phase;
+};
+
+static uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// ============================================
+// Parsers
+// ============================================
+
+// handleSetSettings() before json_reader, with std::string for String
+static void legacySettings(const char *body) {
+  std::string s = body;
+  Settings settings = {};
+  size_t ledFreqIdx = s.find("\"ledFreq\":");
+  size_t ledDutyIdx = s.find("\"ledDuty\":");
+  size_t magFreqIdx = s.find("\"magFreq\":");
+  size_t magDutyIdx = s.find("\"magDuty\":");
+  if (ledFreqIdx != std::string::npos) settings.ledFreq = atof(s.substr(ledFreqIdx + 10).c_str());
+  if (ledDutyIdx != std::string::npos) settings.ledDuty = atof(s.substr(ledDutyIdx + 10).c_str());
+  if (magFreqIdx != std::string::npos) settings.magFreq = atof(s.substr(magFreqIdx + 10).c_str());
+  if (magDutyIdx != std::string::npos) settings.magDuty = atof(s.substr(magDutyIdx + 10).c_str());
+  sink = settings.ledFreq + settings.ledDuty + settings.magFreq + settings.magDuty;
+}
+
+static void readerSettings(const char *body) {
+  Settings settings = {};
+  const JsonFloatField fields[] = {
+    {"ledFreq", &settings.ledFreq, 0.1f, 1000},
+    {"ledDuty", &settings.ledDuty, 0, 100},
+    {"magFreq", &settings.magFreq, 0.1f, 1000},
+    {"magDuty", &settings.magDuty, 0, 100},
+    {"mag2Duty", &settings.mag2Duty, 0, 100},
+    {"mag2Phase", &settings.mag2Phase, 0, 360},
+  };
+  JsonParseError err;
+  sink = jsonParseFloatFields(body, strlen(body), fields, 6, err) +
+         settings.ledFreq + settings.ledDuty + settings.magFreq + settings.magDuty;
+}
+
+// Every token, as timelineParse() pulls them
+static void readerTokens(const char *body) {
+  JsonReader r;
+  jsonBegin(r, body, strlen(body));
+  double sum = 0;
+  while (jsonNext(r) != JSON_END && r.token != JSON_ERROR) {
+    if (r.token == JSON_NUMBER) sum += r.number;
+  }
+  sink = sum;
+}
+
+// ============================================
+// Runner
+// ============================================
+
+struct BenchCase {
+  const char *name;
+  void (*parse)(const char *body);
+  const char *body;
+};
+
+static const BenchCase CASES[] = {
+  {"settings  legacy String scan", legacySettings, SETTINGS_BODY},
+  {"settings  json_reader fields", readerSettings, SETTINGS_BODY},
+  {"settings  json_reader, malformed", readerSettings, SETTINGS_BAD},
+  {"timeline  json_reader tokens", readerTokens, TIMELINE_BODY},
+};
+
+static void run(const BenchCase &c, long iterations) {
+  double best = 1e30;
+  uint64_t allocated = 0;
+  for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+    uint64_t before = allocations;
+    uint64_t start = nowNs();
+    for (long i = 0; i < iterations; i++) c.parse(c.body);
+    double ns = (double)(nowNs() - start) / iterations;
+    allocated = allocations - before;
+    if (ns < best) best = ns;
+  }
+  size_t len = strlen(c.body);
+  printf("%-34s %4u B %9.1f ns %8.1f MB/s %6.2f allocs\n", c.name, (unsigned)len, best,
+         len * 1e3 / best, (double)allocated / iterations);
+}
+
+int main(int argc, char **argv) {
+  long iterations = BENCH_ITERATIONS;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      iterations = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--iterations N]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (iterations < 1) iterations = 1;
+
+  printf("%-34s %6s %12s %13s %13s\n", "case", "body", "per doc", "throughput", "heap/doc");
+  for (const BenchCase &c : CASES) run(c, iterations);
+  return 0;
+}
@@ -0,0 +1,142 @@
+// Waveform benchmark on the native simulation (lib/native_hal): runs the
+// firmware through a list of (LED Hz, magnet Hz, LED duty) configurations
+// and writes a VCD trace of the LED and magnet pins for each. The numbers
+// (frequency error, jitter, beat) are worked out from the traces by
+// scripts/bench_waveforms.py, which runs this and the Twin's lib/PWM bench.
+//
+//   pio run -e bench && .pio/build/bench/program --out bench-out 80.5:79.8:50 60:59.5:30
+
+#include <sim.h>
+#include <Arduino.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "config.h"
+
+#define BENCH_SETTLE_MS 200   // past the cycle boundary the update waits for
+
+struct BenchConfig {
+  double ledHz;
+  double magnetHz;
+  double duty;
+};
+
+struct TracePin {
+  int pin;
+  const char *name;
+  char id;
+};
+
+static const TracePin TRACE_PINS[] = {
+  {LED_PIN, "led", '!'},
+  {MAGNET_PIN, "magnet", '"'},
+  {MAGNET2_PIN, "magnet2", '#'},
+};
+
+static const BenchConfig DEFAULT_MATRIX[] = {
+  {DEFAULT_LED_FREQ, DEFAULT_MAGNET_FREQ, DEFAULT_LED_DUTY},
+  {80.4, 79.8, 10.0},
+  {84.8, 79.8, 10.0},
+  {60.0, 59.5, 30.0},
+  {120.0, 119.0, 20.0},
+};
+
+static uint64_t cpuNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * SIM_NS_PER_S + ts.tv_nsec;
+}
+
+static bool parseConfig(const char *text, BenchConfig &config) {
+  return sscanf(text, "%lf:%lf:%lf", &config.ledHz, &config.magnetHz, &config.duty) == 3;
+}
+
+// Run one configuration and write its trace; false if the firmware refused it
+static bool runConfig(const BenchConfig &config, double seconds, const char *outDir) {
+  char body[128];
+  snprintf(body, sizeof(body), "{\"ledFreq\": %.4f, \"magFreq\": %.4f, \"ledDuty\": %.2f}",
+           config.ledHz, config.magnetHz, config.duty);
+  SimResponse r = simRequest("POST", "/api/settings", body);
+  if (r.code != 200) {
+    fprintf(stderr, "%g:%g:%g: %d %s\n", config.ledHz, config.magnetHz, config.duty,
+            r.code, r.body.c_str());
+    return false;
+  }
+  simRunForMs(BENCH_SETTLE_MS);
+
+  uint8_t initial[sizeof(TRACE_PINS) / sizeof(TRACE_PINS[0])];
+  for (size_t i = 0; i < sizeof(TRACE_PINS) / sizeof(TRACE_PINS[0]); i++) {
+    initial[i] = simGetPin(TRACE_PINS[i].pin);
+  }
+  simClearEdges();
+  uint64_t startNs = simNowNs();
+  uint64_t interrupts = simInterrupts();
+  uint64_t cpu = cpuNs();
+  simRunFor((uint64_t)(seconds * SIM_NS_PER_S));
+  cpu = cpuNs() - cpu;
+  interrupts = simInterrupts() - interrupts;
+
+  char path[512];
+  snprintf(path, sizeof(path), "%s/esp32_%g_%g_%g.vcd", outDir, config.ledHz, config.magnetHz,
+           config.duty);
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  fprintf(f, "$comment path=esp32 led_hz=%g mag_hz=%g duty=%g seconds=%g host_ns=%llu "
+             "interrupts=%llu $end\n", config.ledHz, config.magnetHz, config.duty, seconds,
+          (unsigned long long)cpu, (unsigned long long)interrupts);
+  fprintf(f, "$timescale 1 ns $end\n$scope module esp32 $end\n");
+  for (const TracePin &p : TRACE_PINS) fprintf(f, "$var wire 1 %c %s $end\n", p.id, p.name);
+  fprintf(f, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+  for (size_t i = 0; i < sizeof(TRACE_PINS) / sizeof(TRACE_PINS[0]); i++) {
+    fprintf(f, "%d%c\n", initial[i], TRACE_PINS[i].id);
+  }
+  fprintf(f, "$end\n");
+
+  uint64_t last = UINT64_MAX;
+  for (const SimEdge &e : simEdges()) {
+    for (const TracePin &p : TRACE_PINS) {
+      if (p.pin != e.pin) continue;
+      if (e.ns != last) fprintf(f, "#%llu\n", (unsigned long long)(e.ns - startNs));
+      fprintf(f, "%d%c\n", e.level, p.id);
+      last = e.ns;
+    }
+  }
+  fclose(f);
+  printf("%s\n", path);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  double seconds = 10.0;
+  const char *outDir = "bench-out";
+  std::vector<BenchConfig> matrix;
+  for (int i = 1; i < argc; i++) {
+    BenchConfig config;
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      outDir = argv[++i];
+    } else if (parseConfig(argv[i], config)) {
+      matrix.push_back(config);
+    } else {
+      fprintf(stderr, "usage: %s [--seconds S] [--out DIR] [LED_HZ:MAG_HZ:DUTY ...]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (matrix.empty()) {
+    matrix.assign(DEFAULT_MATRIX, DEFAULT_MATRIX + sizeof(DEFAULT_MATRIX) / sizeof(DEFAULT_MATRIX[0]));
+  }
+  mkdir(outDir, 0755);
+
+  simSetSerialEcho(false);
+  simBoot();
+  simRunForMs(3000);   // past WiFi and the magnet self-test
+
+  int failed = 0;
+  for (const BenchConfig &config : matrix) {
+    if (!runConfig(config, seconds, outDir)) failed++;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,19 @@
+#ifndef ELEGANTOTA_H
+#define ELEGANTOTA_H
+
+#include <WebServer.h>
+#include <functional>
+
+// No firmware uploads in the simulation; the callbacks never fire.
+class ElegantOTAClass {
+public:
+  void begin(WebServer *server, const char *username = "", const char *password = "") {}
+  void loop() {}
+  void onStart(std::function<void()> callback) {}
+  void onProgress(std::function<void(size_t current, size_t final)> callback) {}
+  void onEnd(std::function<void(bool success)> callback) {}
+};
+
+extern ElegantOTAClass ElegantOTA;
+
+#endif // ELEGANTOTA_H
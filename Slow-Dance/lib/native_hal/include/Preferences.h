@@ -0,0 +1,31 @@
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+#include <Arduino.h>
+
+// NVS in memory: namespaces survive end()/begin() for the whole run.
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false, const char *partition = NULL);
+  void end();
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putFloat(const char *key, float value);
+  size_t putUInt(const char *key, uint32_t value);
+  size_t putBool(const char *key, bool value);
+  size_t putBytes(const char *key, const void *value, size_t len);
+  float getFloat(const char *key, float defaultValue = NAN);
+  uint32_t getUInt(const char *key, uint32_t defaultValue = 0);
+  bool getBool(const char *key, bool defaultValue = false);
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t maxLen);
+
+private:
+  std::string name;
+  bool open = false;
+  bool readOnly = false;
+};
+
+#endif // PREFERENCES_H
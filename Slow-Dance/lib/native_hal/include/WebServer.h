@@ -0,0 +1,58 @@
+#ifndef WEBSERVER_H
+#define WEBSERVER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <functional>
+#include <map>
+#include <vector>
+
+struct SimHttpRequest;
+
+typedef enum { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS } HTTPMethod;
+
+// Requests come from simRequest() and are served one per handleClient(),
+// in the calling task, like the real server.
+class WebServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  WebServer(int port = 80);
+
+  void begin();
+  void handleClient();
+  void on(const String &uri, THandlerFunction handler);
+  void on(const String &uri, HTTPMethod method, THandlerFunction handler);
+  void onNotFound(THandlerFunction handler);
+
+  HTTPMethod method();
+  String uri();
+  bool hasArg(const String &name);
+  String arg(const String &name);
+  void collectHeaders(const char *headerKeys[], const size_t count);
+  String header(const String &name);
+  bool hasHeader(const String &name);
+  WiFiClient client();
+
+  void sendHeader(const String &name, const String &value, bool first = false);
+  void send(int code, const char *contentType = NULL, const String &content = String());
+  void send_P(int code, PGM_P contentType, PGM_P content);
+  void send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength);
+
+private:
+  struct Route {
+    String uri;
+    HTTPMethod method;
+    THandlerFunction handler;
+  };
+
+  int port;
+  bool started = false;
+  std::vector<Route> routes;
+  THandlerFunction notFound;
+  std::vector<String> collected;
+  SimHttpRequest *current = NULL;
+  std::vector<std::pair<String, String>> pendingHeaders;
+};
+
+#endif // WEBSERVER_H
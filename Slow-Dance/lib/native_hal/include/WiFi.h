@@ -0,0 +1,89 @@
+#ifndef WIFI_H
+#define WIFI_H
+
+#include <Arduino.h>
+#include <memory>
+
+struct SimConnection;
+
+class IPAddress {
+public:
+  IPAddress() : addr(0) {}
+  IPAddress(uint32_t address) : addr(address) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : addr(a | (uint32_t)b << 8 | (uint32_t)c << 16 | (uint32_t)d << 24) {}
+  operator uint32_t() const { return addr; }
+  uint8_t operator[](int index) const { return addr >> (8 * index); }
+  bool operator==(const IPAddress &other) const { return addr == other.addr; }
+  bool operator!=(const IPAddress &other) const { return addr != other.addr; }
+  String toString() const;
+
+private:
+  uint32_t addr;   // first octet in the low byte, as on the target
+};
+
+// ============================================
+// WiFi
+// ============================================
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_STA_CONNECTED = 4,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP = 7
+} arduino_event_id_t;
+
+typedef union {
+  struct {
+    uint8_t reason;
+  } wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef void (*WiFiEventFuncCb)(arduino_event_id_t event, arduino_event_info_t info);
+
+class WiFiClass {
+public:
+  bool mode(wifi_mode_t mode);
+  wifi_mode_t getMode();
+  wl_status_t begin(const char *ssid, const char *password = NULL);
+  bool disconnect(bool wifiOff = false, bool eraseAp = false);
+  wl_status_t status();
+  IPAddress localIP();
+  int8_t RSSI();
+  void persistent(bool persistent) {}
+  bool setAutoReconnect(bool autoReconnect) { return true; }
+  bool setSleep(bool enabled) { return true; }
+  int onEvent(WiFiEventFuncCb cb);
+
+  bool softAP(const char *ssid, const char *password = NULL);
+  bool softAPdisconnect(bool wifiOff = false);
+  IPAddress softAPIP();
+  uint8_t softAPgetStationNum() { return 0; }
+};
+
+extern WiFiClass WiFi;
+
+// A connection the web server handed over. Writes go to the test's end
+// of it (SimResponse::stream).
+class WiFiClient {
+public:
+  WiFiClient() {}
+  explicit WiFiClient(std::shared_ptr<SimConnection> conn) : conn(conn) {}
+  uint8_t connected();
+  size_t write(const uint8_t *buf, size_t size);
+  void stop();
+
+private:
+  std::shared_ptr<SimConnection> conn;
+};
+
+#endif // WIFI_H
@@ -0,0 +1,20 @@
+#ifndef WIFIUDP_H
+#define WIFIUDP_H
+
+#include <WiFi.h>
+
+// No datagrams travel in the simulation: begin() fails, so sync stays off.
+class WiFiUDP {
+public:
+  uint8_t begin(uint16_t port) { return 0; }
+  void stop() {}
+  int parsePacket() { return 0; }
+  int read(uint8_t *buf, size_t size) { return 0; }
+  IPAddress remoteIP() { return IPAddress(); }
+  uint16_t remotePort() { return 0; }
+  int beginPacket(IPAddress ip, uint16_t port) { return 0; }
+  size_t write(const uint8_t *buf, size_t size) { return 0; }
+  int endPacket() { return 0; }
+};
+
+#endif // WIFIUDP_H
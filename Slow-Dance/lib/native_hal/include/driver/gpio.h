@@ -0,0 +1,11 @@
+#ifndef DRIVER_GPIO_H
+#define DRIVER_GPIO_H
+
+#include <Arduino.h>
+
+typedef int gpio_num_t;
+
+// Outputs are always readable in the simulation
+esp_err_t gpio_input_enable(gpio_num_t gpio);
+
+#endif // DRIVER_GPIO_H
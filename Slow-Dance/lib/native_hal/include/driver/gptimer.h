@@ -0,0 +1,36 @@
+#ifndef DRIVER_GPTIMER_H
+#define DRIVER_GPTIMER_H
+
+#include <Arduino.h>
+
+// General purpose timer driver: hands out the timer group timers and
+// keeps their counters. Alarms and interrupts are not modelled at this
+// level; the firmware drives them through hal/timer_ll.h.
+
+typedef struct SimGptimer *gptimer_handle_t;
+
+typedef enum {
+  GPTIMER_CLK_SRC_DEFAULT
+} gptimer_clock_source_t;
+
+typedef enum {
+  GPTIMER_COUNT_DOWN,
+  GPTIMER_COUNT_UP
+} gptimer_count_direction_t;
+
+typedef struct {
+  gptimer_clock_source_t clk_src;
+  gptimer_count_direction_t direction;
+  uint32_t resolution_hz;
+  int intr_priority;
+} gptimer_config_t;
+
+esp_err_t gptimer_new_timer(const gptimer_config_t *config, gptimer_handle_t *ret_timer);
+esp_err_t gptimer_del_timer(gptimer_handle_t timer);
+esp_err_t gptimer_set_raw_count(gptimer_handle_t timer, uint64_t value);
+esp_err_t gptimer_enable(gptimer_handle_t timer);
+esp_err_t gptimer_disable(gptimer_handle_t timer);
+esp_err_t gptimer_start(gptimer_handle_t timer);
+esp_err_t gptimer_stop(gptimer_handle_t timer);
+
+#endif // DRIVER_GPTIMER_H
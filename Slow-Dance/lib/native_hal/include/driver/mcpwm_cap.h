@@ -0,0 +1,58 @@
+#ifndef DRIVER_MCPWM_CAP_H
+#define DRIVER_MCPWM_CAP_H
+
+#include <Arduino.h>
+
+// The capture unit is not modelled: creating a capture timer fails with
+// ESP_ERR_NOT_SUPPORTED, which callers already treat as "no hardware".
+
+typedef struct mcpwm_cap_timer_t *mcpwm_cap_timer_handle_t;
+typedef struct mcpwm_cap_channel_t *mcpwm_cap_channel_handle_t;
+
+typedef enum { MCPWM_CAPTURE_CLK_SRC_DEFAULT = 0 } mcpwm_capture_clock_source_t;
+typedef enum { MCPWM_CAP_EDGE_POS, MCPWM_CAP_EDGE_NEG } mcpwm_capture_edge_t;
+
+typedef struct {
+  int group_id;
+  mcpwm_capture_clock_source_t clk_src;
+} mcpwm_capture_timer_config_t;
+
+typedef struct {
+  int gpio_num;
+  uint32_t prescale;
+  struct {
+    uint32_t pos_edge : 1;
+    uint32_t neg_edge : 1;
+    uint32_t pull_up : 1;
+    uint32_t pull_down : 1;
+    uint32_t invert_cap_signal : 1;
+    uint32_t io_loop_back : 1;
+  } flags;
+} mcpwm_capture_channel_config_t;
+
+typedef struct {
+  uint32_t cap_value;
+  mcpwm_capture_edge_t cap_edge;
+} mcpwm_capture_event_data_t;
+
+typedef bool (*mcpwm_capture_event_cb_t)(mcpwm_cap_channel_handle_t channel,
+                                         const mcpwm_capture_event_data_t *edata, void *arg);
+
+typedef struct {
+  mcpwm_capture_event_cb_t on_cap;
+} mcpwm_capture_event_callbacks_t;
+
+esp_err_t mcpwm_new_capture_timer(const mcpwm_capture_timer_config_t *config,
+                                  mcpwm_cap_timer_handle_t *timer);
+esp_err_t mcpwm_capture_timer_get_resolution(mcpwm_cap_timer_handle_t timer, uint32_t *hz);
+esp_err_t mcpwm_capture_timer_enable(mcpwm_cap_timer_handle_t timer);
+esp_err_t mcpwm_capture_timer_start(mcpwm_cap_timer_handle_t timer);
+esp_err_t mcpwm_new_capture_channel(mcpwm_cap_timer_handle_t timer,
+                                    const mcpwm_capture_channel_config_t *config,
+                                    mcpwm_cap_channel_handle_t *channel);
+esp_err_t mcpwm_capture_channel_register_event_callbacks(mcpwm_cap_channel_handle_t channel,
+                                                         const mcpwm_capture_event_callbacks_t *cbs,
+                                                         void *arg);
+esp_err_t mcpwm_capture_channel_enable(mcpwm_cap_channel_handle_t channel);
+
+#endif // DRIVER_MCPWM_CAP_H
@@ -0,0 +1,21 @@
+#ifndef ESP_INTR_ALLOC_H
+#define ESP_INTR_ALLOC_H
+
+#include <Arduino.h>
+
+// Only ESP_INTR_FLAG_IRAM changes anything in the simulation: such a
+// handler keeps running while a flash write has the cache off
+// (simFlashStall), any other one waits until the write is done.
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+#define ESP_INTR_FLAG_LEVEL2 (1 << 2)
+#define ESP_INTR_FLAG_LEVEL3 (1 << 3)
+#define ESP_INTR_FLAG_IRAM (1 << 10)
+
+typedef void (*intr_handler_t)(void *arg);
+typedef struct SimIntr *intr_handle_t;
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void *arg,
+                         intr_handle_t *ret_handle);
+esp_err_t esp_intr_free(intr_handle_t handle);
+
+#endif // ESP_INTR_ALLOC_H
@@ -0,0 +1,9 @@
+#ifndef ESP_OTA_OPS_H
+#define ESP_OTA_OPS_H
+
+#include <esp_partition.h>
+
+// The idle OTA slot; writes to it only take their time (sim_esp.cpp).
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start);
+
+#endif // ESP_OTA_OPS_H
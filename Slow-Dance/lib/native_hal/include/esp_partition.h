@@ -0,0 +1,15 @@
+#ifndef ESP_PARTITION_H
+#define ESP_PARTITION_H
+
+#include <Arduino.h>
+
+typedef struct {
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+} esp_partition_t;
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size);
+
+#endif // ESP_PARTITION_H
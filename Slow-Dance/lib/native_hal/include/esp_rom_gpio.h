@@ -0,0 +1,10 @@
+#ifndef ESP_ROM_GPIO_H
+#define ESP_ROM_GPIO_H
+
+#include <stdint.h>
+
+// The GPIO matrix is not modelled; routing calls are accepted and ignored.
+void esp_rom_gpio_connect_in_signal(uint32_t gpio, uint32_t signal, bool invert);
+void esp_rom_gpio_connect_out_signal(uint32_t gpio, uint32_t signal, bool invertOut, bool invertOe);
+
+#endif // ESP_ROM_GPIO_H
@@ -0,0 +1,18 @@
+#ifndef HAL_GPIO_LL_H
+#define HAL_GPIO_LL_H
+
+#include <stdint.h>
+
+typedef struct {
+  uint32_t unused;
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
+
+void simGpioWrite(int pin, int level);
+
+static inline void gpio_ll_set_level(gpio_dev_t *hw, uint32_t gpio, uint32_t level) {
+  simGpioWrite(gpio, level);
+}
+
+#endif // HAL_GPIO_LL_H
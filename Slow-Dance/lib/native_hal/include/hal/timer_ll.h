@@ -0,0 +1,55 @@
+#ifndef HAL_TIMER_LL_H
+#define HAL_TIMER_LL_H
+
+#include <stdint.h>
+
+// Timer group registers, reduced to the operations the firmware uses on
+// them. The model behind them is in sim_core.cpp.
+
+typedef struct {
+  int group;
+} timg_dev_t;
+
+extern timg_dev_t TIMERG0;
+extern timg_dev_t TIMERG1;
+
+#define TIMER_LL_GET_HW(group_id) ((group_id) == 0 ? &TIMERG0 : &TIMERG1)
+#define TIMER_LL_EVENT_ALARM(timer) (1UL << (timer))
+
+void simTimerCapture(int group, uint32_t timer);
+uint64_t simTimerCaptured(int group, uint32_t timer);
+uint64_t simTimerReloadValue(int group, uint32_t timer);
+void simTimerSetAlarm(int group, uint32_t timer, uint64_t value);
+void simTimerEnableAlarm(int group, uint32_t timer, bool enable);
+void simTimerEnableIntr(int group, uint32_t mask, bool enable);
+void simTimerClearIntr(int group, uint32_t mask);
+
+static inline void timer_ll_trigger_soft_capture(timg_dev_t *hw, uint32_t timer_num) {
+  simTimerCapture(hw->group, timer_num);
+}
+
+static inline uint64_t timer_ll_get_counter_value(timg_dev_t *hw, uint32_t timer_num) {
+  return simTimerCaptured(hw->group, timer_num);
+}
+
+static inline uint64_t timer_ll_get_reload_value(timg_dev_t *hw, uint32_t timer_num) {
+  return simTimerReloadValue(hw->group, timer_num);
+}
+
+static inline void timer_ll_set_alarm_value(timg_dev_t *hw, uint32_t timer_num, uint64_t alarm_value) {
+  simTimerSetAlarm(hw->group, timer_num, alarm_value);
+}
+
+static inline void timer_ll_enable_alarm(timg_dev_t *hw, uint32_t timer_num, bool en) {
+  simTimerEnableAlarm(hw->group, timer_num, en);
+}
+
+static inline void timer_ll_enable_intr(timg_dev_t *hw, uint32_t mask, bool en) {
+  simTimerEnableIntr(hw->group, mask, en);
+}
+
+static inline void timer_ll_clear_intr_status(timg_dev_t *hw, uint32_t mask) {
+  simTimerClearIntr(hw->group, mask);
+}
+
+#endif // HAL_TIMER_LL_H
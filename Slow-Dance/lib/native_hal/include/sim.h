@@ -0,0 +1,122 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ============================================
+// Native Simulation
+// ============================================
+// The env:native build links the firmware against this library instead of
+// the ESP32 core. Everything runs on one host thread against a virtual
+// clock in nanoseconds:
+//
+// - FreeRTOS tasks are cooperative coroutines. A task runs until it
+//   blocks (vTaskDelay, a queue) and takes no virtual time doing so; a
+//   queue send that wakes a higher-priority task switches to it at once.
+// - Timer group alarms fire their interrupt at the exact virtual time of
+//   the alarm, between task slices, so portMUX sections need no locking.
+// - Flash writes (Preferences, esp_partition_*) take the time they take
+//   on the chip with the cache off: only interrupts allocated with
+//   ESP_INTR_FLAG_IRAM are taken meanwhile, the others once it is back.
+// - When every task is blocked the clock jumps to the next wake-up,
+//   alarm or scheduled event. A second of firmware time takes a few
+//   milliseconds of host time and every run is identical.
+//
+// GPIO levels are kept per pin and output changes are recorded with their
+// time (simEdges). Inputs are driven from the outside with simSetPin(),
+// which fires attached interrupts. Preferences live in memory, WiFi
+// associates SIM_WIFI_JOIN_MS after WiFi.begin(), and WebServer requests
+// are injected with simRequest().
+//
+// Only the ISR waveform backend runs here; the LEDC and MCPWM drivers
+// report themselves unavailable.
+
+#define SIM_NS_PER_MS 1000000ULL
+#define SIM_NS_PER_S 1000000000ULL
+#define SIM_PINS 40
+#define SIM_WIFI_JOIN_MS 500
+#define SIM_REQUEST_TIMEOUT_MS 5000   // simRequest() gives up after this
+#define SIM_HEAP_SIZE (16UL * 1024 * 1024)   // budget ESP.getFreeHeap() counts down from
+
+// Flash write times with the cache off, typical for the ESP32's SPI flash
+#define SIM_NVS_WRITE_US 200          // a Preferences entry
+#define SIM_FLASH_ERASE_US 45000      // a 4 KB sector
+#define SIM_FLASH_PAGE_US 700         // a 256 B page
+#define SIM_OTA_PARTITION_SIZE 0x140000
+
+struct SimEdge {
+  uint64_t ns;
+  uint8_t pin;
+  uint8_t level;
+};
+
+// The far end of a connection the firmware took over (server.client()).
+struct SimConnection {
+  bool open = true;
+  std::string data;   // everything the firmware wrote
+};
+
+struct SimResponse {
+  int code = 0;       // 0: not served within SIM_REQUEST_TIMEOUT_MS
+  std::string type;
+  std::string body;
+  std::map<std::string, std::string> headers;
+  std::shared_ptr<SimConnection> stream;   // set if the handler kept the client
+};
+
+// Call setup() on the Arduino loop task, as the core does at reset. The
+// tasks it starts run from the next simRun*() on.
+void simBoot();
+
+// Run the firmware until `ns` / for `ns` of virtual time.
+void simRunUntil(uint64_t ns);
+void simRunFor(uint64_t ns);
+void simRunForMs(uint32_t ms);
+
+uint64_t simNowNs();
+
+// Call `fn` from the scheduler at virtual time `ns`, as an interrupt or an
+// event task would. Events at the same time run in the order scheduled.
+void simAt(uint64_t ns, std::function<void()> fn);
+
+// Drive an input pin. Attached interrupts fire for matching edges.
+void simSetPin(int pin, int level);
+int simGetPin(int pin);
+
+// Output changes since the last simClearEdges(), oldest first.
+const std::vector<SimEdge> &simEdges();
+void simClearEdges();
+
+// Called on every output change as well, e.g. to stream a trace.
+void simOnEdge(std::function<void(const SimEdge &)> fn);
+
+// Send a request to the web server on port 80 and run the firmware until
+// it has been answered.
+SimResponse simRequest(const char *method, const char *uri, const std::string &body = "",
+                       const std::map<std::string, std::string> &headers = {});
+
+// Whether an access point is in range: WiFi.begin() only associates while
+// it is; taking it away drops a connected station.
+void simSetWifiAvailable(bool available);
+
+// Preferences writes (put*, remove, clear) since boot.
+uint32_t simFlashWrites();
+
+// Run `ns` of virtual time with the flash cache off, as a flash write
+// does: IRAM-safe interrupts are taken on time, the rest are held off and
+// taken late. Tasks do not run meanwhile. Called by the flash models;
+// tests can call it to put a write anywhere.
+void simFlashStall(uint64_t ns);
+
+// Timer and pin interrupts taken since boot.
+uint64_t simInterrupts();
+
+// Echo Serial output to stdout, prefixed with the virtual time.
+void simSetSerialEcho(bool echo);
+
+#endif // SIM_H
@@ -0,0 +1,16 @@
+#ifndef SOC_MCPWM_PERIPH_H
+#define SOC_MCPWM_PERIPH_H
+
+#include <stdint.h>
+
+typedef struct {
+  struct {
+    struct {
+      uint32_t cap_sig;
+    } captures[3];
+  } groups[2];
+} mcpwm_signal_conn_t;
+
+extern const mcpwm_signal_conn_t mcpwm_periph_signals;
+
+#endif // SOC_MCPWM_PERIPH_H
@@ -0,0 +1,8 @@
+#ifndef SOC_SOC_CAPS_H
+#define SOC_SOC_CAPS_H
+
+// ESP32
+#define SOC_TIMER_GROUPS 2
+#define SOC_TIMER_GROUP_TIMERS_PER_GROUP 2
+
+#endif // SOC_SOC_CAPS_H
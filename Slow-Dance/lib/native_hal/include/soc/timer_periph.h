@@ -0,0 +1,14 @@
+#ifndef SOC_TIMER_PERIPH_H
+#define SOC_TIMER_PERIPH_H
+
+#include <soc/soc_caps.h>
+
+typedef struct {
+  struct {
+    int timer_irq_id[SOC_TIMER_GROUP_TIMERS_PER_GROUP];
+  } groups[SOC_TIMER_GROUPS];
+} timer_group_signal_conn_t;
+
+extern const timer_group_signal_conn_t timer_group_periph_signals;
+
+#endif // SOC_TIMER_PERIPH_H
@@ -0,0 +1,769 @@
+#include "sim.h"
+
+#include <Arduino.h>
+#include <hal/gpio_ll.h>
+#include <hal/timer_ll.h>
+#include <driver/gptimer.h>
+#include <esp_cpu.h>
+#include <esp_intr_alloc.h>
+#include <soc/timer_periph.h>
+#include <malloc.h>
+#include <stdarg.h>
+#include <ucontext.h>
+#include <algorithm>
+#include <deque>
+#include <new>
+
+// Host code needs far more stack than the target; every task gets this
+#define SIM_STACK_SIZE (256 * 1024)
+#define SIM_CPU_MHZ 240
+
+// Code takes no virtual time except for reading a timer, which costs about
+// what the driver call does on the target. A loop polling the counter then
+// sees it move.
+#define SIM_TIMER_READ_NS 100
+
+// Task slices in a row without the clock moving before a task is taken to
+// be spinning (it would trip the task watchdog on the target)
+#define SIM_MAX_SLICES_AT_ONCE 10000000
+
+static uint64_t nowNs = 0;
+
+// ============================================
+// Scheduler
+// ============================================
+
+struct SimQueue {
+  size_t length;
+  size_t itemSize;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+struct SimTask {
+  ucontext_t ctx;
+  void (*fn)(void *);
+  void *arg;
+  const char *name;
+  UBaseType_t priority;
+  void *stack;
+  bool ready;
+  bool done;
+  uint64_t wakeNs;          // UINT64_MAX: no timeout
+  SimQueue *waitingOn;
+  uint64_t lastRun;         // round robin among equal priorities
+};
+
+// One timer of a timer group (hal/timer_ll.h, driver/gptimer.h)
+struct SimTimer {
+  bool allocated;           // by gptimer_new_timer()
+  uint32_t hz;
+  bool running;
+  uint64_t count;           // counter value at sinceNs
+  uint64_t sinceNs;
+  uint64_t reload;
+  uint64_t captured;        // latched by a soft capture
+  bool alarmEnabled;        // cleared by the hardware when the alarm fires
+  uint64_t alarm;
+};
+
+struct SimTimerGroup {
+  SimTimer timers[SOC_TIMER_GROUP_TIMERS_PER_GROUP];
+  uint32_t intEnabled;      // TIMER_LL_EVENT_ALARM() bits
+  uint32_t intStatus;
+};
+
+struct SimIntr {
+  int source;
+  intr_handler_t handler;
+  void *arg;
+  bool iram;                // runs while the flash cache is off
+};
+
+static std::vector<SimTask *> tasks;
+static SimTask *current = NULL;   // NULL: scheduler, interrupt or test code
+static ucontext_t schedulerCtx;
+static uint64_t runSeq = 0;
+static SimTimerGroup timerGroups[SOC_TIMER_GROUPS];
+static std::vector<SimIntr *> intrs;
+static std::multimap<uint64_t, std::function<void()>> events;
+static uint64_t interruptCount = 0;
+
+static uint64_t tickNs(uint64_t ticks) {
+  return ticks * (SIM_NS_PER_S / configTICK_RATE_HZ);
+}
+
+// Timeouts run out on a tick boundary, like the FreeRTOS tick does
+static uint64_t deadlineFor(TickType_t ticks) {
+  if (ticks == portMAX_DELAY) return UINT64_MAX;
+  if (ticks == 0) return nowNs;
+  return tickNs(nowNs / tickNs(1) + ticks);
+}
+
+static void taskEntry() {
+  current->fn(current->arg);
+  vTaskDelete(NULL);
+}
+
+static void switchToScheduler() {
+  swapcontext(&current->ctx, &schedulerCtx);
+}
+
+// Block the running task until `wakeNs` or a change of `queue`
+static void block(uint64_t wakeNs, SimQueue *queue) {
+  current->ready = false;
+  current->wakeNs = wakeNs;
+  current->waitingOn = queue;
+  switchToScheduler();
+  current->waitingOn = NULL;
+  current->wakeNs = UINT64_MAX;
+}
+
+// Wake the tasks waiting on `queue`; a higher-priority one preempts the
+// running task straight away.
+static void notify(SimQueue *queue) {
+  bool preempt = false;
+  for (SimTask *t : tasks) {
+    if (t->done || t->ready || t->waitingOn != queue) continue;
+    t->ready = true;
+    if (current && t->priority > current->priority) preempt = true;
+  }
+  if (preempt) switchToScheduler();
+}
+
+static SimTask *pickReady() {
+  SimTask *best = NULL;
+  for (SimTask *t : tasks) {
+    if (!t->ready || t->done) continue;
+    if (!best || t->priority > best->priority ||
+        (t->priority == best->priority && t->lastRun < best->lastRun)) {
+      best = t;
+    }
+  }
+  return best;
+}
+
+static uint64_t timerCount(const SimTimer &timer) {
+  if (!timer.running) return timer.count;
+  return timer.count + (uint64_t)((unsigned __int128)(nowNs - timer.sinceNs) * timer.hz / SIM_NS_PER_S);
+}
+
+// When the timer's counter reaches its alarm; at once if it already has
+static uint64_t alarmNs(const SimTimer &timer) {
+  if (!timer.alarmEnabled || !timer.running) return UINT64_MAX;
+  if (timer.alarm <= timerCount(timer)) return nowNs;
+  unsigned __int128 ticks = timer.alarm - timer.count;
+  return timer.sinceNs + (uint64_t)((ticks * SIM_NS_PER_S + timer.hz - 1) / timer.hz);
+}
+
+// The handler attached to a timer's interrupt, if any
+static SimIntr *timerIntr(int group, int timer) {
+  int source = timer_group_periph_signals.groups[group].timer_irq_id[timer];
+  for (SimIntr *intr : intrs) {
+    if (intr->source == source) return intr;
+  }
+  return NULL;
+}
+
+// The timer's interrupt is raised and has a handler to take it
+static bool intrPending(int group, int timer) {
+  const SimTimerGroup &g = timerGroups[group];
+  return (g.intStatus & g.intEnabled & TIMER_LL_EVENT_ALARM(timer)) && timerIntr(group, timer);
+}
+
+// The next alarm, or now for an interrupt still to be taken. With
+// `iramOnly` one held off by the flash cache does not count.
+static uint64_t nextTimerDue(bool iramOnly) {
+  uint64_t next = UINT64_MAX;
+  for (int g = 0; g < SOC_TIMER_GROUPS; g++) {
+    for (int t = 0; t < SOC_TIMER_GROUP_TIMERS_PER_GROUP; t++) {
+      if (intrPending(g, t) && (!iramOnly || timerIntr(g, t)->iram)) return nowNs;
+      next = std::min(next, alarmNs(timerGroups[g].timers[t]));
+    }
+  }
+  return next;
+}
+
+static uint64_t nextDue() {
+  uint64_t next = events.empty() ? UINT64_MAX : events.begin()->first;
+  next = std::min(next, nextTimerDue(false));
+  for (SimTask *t : tasks) {
+    if (!t->done && !t->ready) next = std::min(next, t->wakeNs);
+  }
+  return next;
+}
+
+// Raise the alarms that are due and take the timer interrupts pending. A
+// handler that is not IRAM-safe waits while the flash cache is off
+// (`iramOnly`); its interrupt stays pending until the next call.
+static void fireTimers(bool iramOnly) {
+  for (int g = 0; g < SOC_TIMER_GROUPS; g++) {
+    for (int t = 0; t < SOC_TIMER_GROUP_TIMERS_PER_GROUP; t++) {
+      SimTimer &timer = timerGroups[g].timers[t];
+      if (alarmNs(timer) > nowNs) continue;
+      timer.alarmEnabled = false;
+      timerGroups[g].intStatus |= TIMER_LL_EVENT_ALARM(t);
+    }
+  }
+  for (int g = 0; g < SOC_TIMER_GROUPS; g++) {
+    for (int t = 0; t < SOC_TIMER_GROUP_TIMERS_PER_GROUP; t++) {
+      if (!intrPending(g, t)) continue;
+      SimIntr *intr = timerIntr(g, t);
+      if (iramOnly && !intr->iram) continue;
+      interruptCount++;
+      intr->handler(intr->arg);
+      if (intrPending(g, t)) {
+        // A level interrupt: the target would take it again forever
+        fprintf(stderr, "sim: timer interrupt %d not cleared by its handler\n", intr->source);
+        abort();
+      }
+    }
+  }
+}
+
+static void fireDue() {
+  fireTimers(false);
+  while (!events.empty() && events.begin()->first <= nowNs) {
+    std::function<void()> fn = events.begin()->second;
+    events.erase(events.begin());
+    fn();
+  }
+  for (SimTask *t : tasks) {
+    if (!t->done && !t->ready && t->wakeNs <= nowNs) t->ready = true;
+  }
+}
+
+void simFlashStall(uint64_t ns) {
+  uint64_t end = nowNs + ns;
+  for (;;) {
+    uint64_t next = nextTimerDue(true);
+    if (next > end) break;
+    if (next > nowNs) nowNs = next;
+    fireTimers(true);
+  }
+  nowNs = end;
+}
+
+static void runTask(SimTask *t) {
+  t->lastRun = ++runSeq;
+  current = t;
+  swapcontext(&schedulerCtx, &t->ctx);
+  current = NULL;
+  if (t->done) {
+    free(t->stack);
+    tasks.erase(std::find(tasks.begin(), tasks.end(), t));
+    delete t;
+  }
+}
+
+void simRunUntil(uint64_t ns) {
+  if (current) {
+    fprintf(stderr, "sim: simRun*() called from task %s\n", current->name);
+    abort();
+  }
+  uint32_t slices = 0;
+  for (;;) {
+    SimTask *t = pickReady();
+    if (t) {
+      if (++slices > SIM_MAX_SLICES_AT_ONCE) {
+        fprintf(stderr, "sim: task %s never blocks\n", t->name);
+        abort();
+      }
+      runTask(t);
+      continue;
+    }
+    uint64_t next = nextDue();
+    if (next > ns) break;
+    if (next > nowNs) {
+      nowNs = next;
+      slices = 0;
+    }
+    fireDue();
+  }
+  if (ns > nowNs) nowNs = ns;
+}
+
+void simRunFor(uint64_t ns) {
+  simRunUntil(nowNs + ns);
+}
+
+void simRunForMs(uint32_t ms) {
+  simRunFor(ms * SIM_NS_PER_MS);
+}
+
+uint64_t simNowNs() {
+  return nowNs;
+}
+
+uint64_t simInterrupts() {
+  return interruptCount;
+}
+
+void simAt(uint64_t ns, std::function<void()> fn) {
+  events.emplace(std::max(ns, nowNs), fn);
+}
+
+// The core runs setup() and then loop() on this task. loop() has to block
+// or delete the task, or the virtual clock stands still.
+static void loopTask(void *arg) {
+  setup();
+  for (;;) {
+    loop();
+    yield();
+  }
+}
+
+void simBoot() {
+  xTaskCreatePinnedToCore(loopTask, "loopTask", 8192, NULL, 1, NULL, 1);
+}
+
+// ============================================
+// FreeRTOS
+// ============================================
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stackDepth,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core) {
+  SimTask *t = new SimTask();
+  t->fn = fn;
+  t->arg = arg;
+  t->name = name;
+  t->priority = priority;
+  t->stack = malloc(SIM_STACK_SIZE);
+  t->ready = true;
+  t->done = false;
+  t->wakeNs = UINT64_MAX;
+  t->waitingOn = NULL;
+  t->lastRun = 0;
+  getcontext(&t->ctx);
+  t->ctx.uc_stack.ss_sp = t->stack;
+  t->ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+  t->ctx.uc_link = NULL;
+  makecontext(&t->ctx, taskEntry, 0);
+  tasks.push_back(t);
+  if (handle) *handle = t;
+  if (current && priority > current->priority) switchToScheduler();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(void (*fn)(void *), const char *name, uint32_t stackDepth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(fn, name, stackDepth, arg, priority, handle, 0);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == NULL) task = current;
+  if (task == NULL) return;
+  task->done = true;
+  if (task == current) {
+    switchToScheduler();   // never resumed
+  } else {
+    free(task->stack);
+    tasks.erase(std::find(tasks.begin(), tasks.end(), task));
+    delete task;
+  }
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (!current) {
+    simRunFor(tickNs(ticks));
+  } else if (ticks == 0) {
+    switchToScheduler();   // stays ready: round robin
+  } else {
+    block(deadlineFor(ticks), NULL);
+  }
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)(nowNs / tickNs(1));
+}
+
+BaseType_t xPortGetCoreID() {
+  return 1;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  SimQueue *q = new SimQueue();
+  q->length = length;
+  q->itemSize = itemSize;
+  return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait) {
+  uint64_t deadline = deadlineFor(wait);
+  for (;;) {
+    if (queue->items.size() < queue->length) {
+      const uint8_t *bytes = (const uint8_t *)item;
+      queue->items.emplace_back(bytes, bytes + queue->itemSize);
+      notify(queue);
+      return pdTRUE;
+    }
+    if (!current || nowNs >= deadline) return errQUEUE_FULL;
+    block(deadline, queue);
+  }
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken) {
+  if (woken) *woken = pdFALSE;
+  return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+  uint64_t deadline = deadlineFor(wait);
+  for (;;) {
+    if (!queue->items.empty()) {
+      memcpy(item, queue->items.front().data(), queue->itemSize);
+      queue->items.pop_front();
+      notify(queue);
+      return pdTRUE;
+    }
+    if (!current || nowNs >= deadline) return pdFALSE;
+    block(deadline, queue);
+  }
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return queue->items.size();
+}
+
+// ============================================
+// Time
+// ============================================
+
+// 32 bits wide, as on the target
+unsigned long millis() {
+  return (uint32_t)(nowNs / SIM_NS_PER_MS);
+}
+
+unsigned long micros() {
+  return (uint32_t)(nowNs / 1000);
+}
+
+void delay(uint32_t ms) {
+  vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void yield() {
+  if (current) switchToScheduler();
+}
+
+uint32_t getCpuFrequencyMhz() {
+  return SIM_CPU_MHZ;
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count() {
+  return (uint32_t)(nowNs * SIM_CPU_MHZ / 1000);
+}
+
+// ============================================
+// Hardware Timers
+// ============================================
+
+timg_dev_t TIMERG0 = {0};
+timg_dev_t TIMERG1 = {1};
+
+// The ESP32's interrupt sources for TG0_T0, TG0_T1, TG1_T0 and TG1_T1
+const timer_group_signal_conn_t timer_group_periph_signals = {{
+  {{14, 15}},
+  {{18, 19}},
+}};
+
+struct SimGptimer {
+  int group;
+  int timer;
+};
+
+static SimTimer &timerOf(gptimer_handle_t handle) {
+  return timerGroups[handle->group].timers[handle->timer];
+}
+
+// The driver loads the counter through the reload register, as the
+// target's does
+static void timerLoad(SimTimer &timer, uint64_t value) {
+  timer.reload = value;
+  timer.count = value;
+  timer.sinceNs = nowNs;
+}
+
+esp_err_t gptimer_new_timer(const gptimer_config_t *config, gptimer_handle_t *ret_timer) {
+  if (config->resolution_hz == 0 || config->direction != GPTIMER_COUNT_UP) return ESP_ERR_INVALID_ARG;
+  for (int g = 0; g < SOC_TIMER_GROUPS; g++) {
+    for (int t = 0; t < SOC_TIMER_GROUP_TIMERS_PER_GROUP; t++) {
+      SimTimer &timer = timerGroups[g].timers[t];
+      if (timer.allocated) continue;
+      timer = SimTimer();
+      timer.allocated = true;
+      timer.hz = config->resolution_hz;
+      timer.sinceNs = nowNs;
+      *ret_timer = new SimGptimer{g, t};
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t gptimer_del_timer(gptimer_handle_t handle) {
+  timerOf(handle) = SimTimer();
+  delete handle;
+  return ESP_OK;
+}
+
+esp_err_t gptimer_set_raw_count(gptimer_handle_t handle, uint64_t value) {
+  timerLoad(timerOf(handle), value);
+  return ESP_OK;
+}
+
+esp_err_t gptimer_enable(gptimer_handle_t handle) {
+  return ESP_OK;
+}
+
+esp_err_t gptimer_disable(gptimer_handle_t handle) {
+  return ESP_OK;
+}
+
+esp_err_t gptimer_start(gptimer_handle_t handle) {
+  SimTimer &timer = timerOf(handle);
+  if (timer.running) return ESP_ERR_INVALID_STATE;
+  timer.sinceNs = nowNs;
+  timer.running = true;
+  return ESP_OK;
+}
+
+esp_err_t gptimer_stop(gptimer_handle_t handle) {
+  SimTimer &timer = timerOf(handle);
+  if (!timer.running) return ESP_ERR_INVALID_STATE;
+  timer.count = timerCount(timer);
+  timer.running = false;
+  return ESP_OK;
+}
+
+void simTimerCapture(int group, uint32_t timer) {
+  nowNs += SIM_TIMER_READ_NS;
+  SimTimer &t = timerGroups[group].timers[timer];
+  t.captured = timerCount(t);
+}
+
+uint64_t simTimerCaptured(int group, uint32_t timer) {
+  return timerGroups[group].timers[timer].captured;
+}
+
+uint64_t simTimerReloadValue(int group, uint32_t timer) {
+  return timerGroups[group].timers[timer].reload;
+}
+
+void simTimerSetAlarm(int group, uint32_t timer, uint64_t value) {
+  timerGroups[group].timers[timer].alarm = value;
+}
+
+void simTimerEnableAlarm(int group, uint32_t timer, bool enable) {
+  timerGroups[group].timers[timer].alarmEnabled = enable;
+}
+
+void simTimerEnableIntr(int group, uint32_t mask, bool enable) {
+  if (enable) timerGroups[group].intEnabled |= mask;
+  else timerGroups[group].intEnabled &= ~mask;
+}
+
+void simTimerClearIntr(int group, uint32_t mask) {
+  timerGroups[group].intStatus &= ~mask;
+}
+
+// Only the timer group sources are wired up; the other peripherals attach
+// their interrupts through their own drivers.
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void *arg,
+                         intr_handle_t *ret_handle) {
+  for (SimIntr *intr : intrs) {
+    if (intr->source == source) return ESP_ERR_NOT_FOUND;   // not shared
+  }
+  SimIntr *intr = new SimIntr{source, handler, arg, (flags & ESP_INTR_FLAG_IRAM) != 0};
+  intrs.push_back(intr);
+  if (ret_handle) *ret_handle = intr;
+  return ESP_OK;
+}
+
+esp_err_t esp_intr_free(intr_handle_t handle) {
+  intrs.erase(std::find(intrs.begin(), intrs.end(), handle));
+  delete handle;
+  return ESP_OK;
+}
+
+// ============================================
+// GPIO
+// ============================================
+
+struct PinInterrupt {
+  void (*handler)(void);
+  int mode;
+};
+
+gpio_dev_t GPIO;
+static uint8_t levels[SIM_PINS];
+static bool driven[SIM_PINS];     // by simSetPin(), pull-ups no longer apply
+static PinInterrupt interrupts[SIM_PINS];
+static std::vector<SimEdge> edges;
+static std::vector<std::function<void(const SimEdge &)>> edgeListeners;
+
+static void setLevel(int pin, int level) {
+  if (pin < 0 || pin >= SIM_PINS) return;
+  uint8_t value = level ? HIGH : LOW;
+  if (levels[pin] == value) return;
+  levels[pin] = value;
+
+  SimEdge edge = {nowNs, (uint8_t)pin, value};
+  edges.push_back(edge);
+  for (auto &fn : edgeListeners) fn(edge);
+}
+
+void simGpioWrite(int pin, int level) {
+  setLevel(pin, level);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= SIM_PINS || driven[pin]) return;
+  if ((mode & PULLUP) && !levels[pin]) levels[pin] = HIGH;   // no edge: the pad starts there
+  if ((mode & PULLDOWN) && levels[pin]) levels[pin] = LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  setLevel(pin, level);
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < SIM_PINS ? levels[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  if (pin < SIM_PINS) interrupts[pin] = {handler, mode};
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < SIM_PINS) interrupts[pin] = {NULL, 0};
+}
+
+void simSetPin(int pin, int level) {
+  if (pin < 0 || pin >= SIM_PINS) return;
+  driven[pin] = true;
+  uint8_t old = levels[pin];
+  setLevel(pin, level);
+  uint8_t now = levels[pin];
+  const PinInterrupt &irq = interrupts[pin];
+  if (old == now || !irq.handler) return;
+  if (irq.mode == CHANGE || (irq.mode == RISING && now) || (irq.mode == FALLING && !now)) {
+    interruptCount++;
+    irq.handler();
+  }
+}
+
+int simGetPin(int pin) {
+  return pin >= 0 && pin < SIM_PINS ? levels[pin] : LOW;
+}
+
+const std::vector<SimEdge> &simEdges() {
+  return edges;
+}
+
+void simClearEdges() {
+  edges.clear();
+}
+
+void simOnEdge(std::function<void(const SimEdge &)> fn) {
+  edgeListeners.push_back(fn);
+}
+
+// ============================================
+// Serial / ESP
+// ============================================
+
+HardwareSerial Serial;
+EspClass ESP;
+static bool serialEcho = true;
+static bool atLineStart = true;
+
+void simSetSerialEcho(bool echo) {
+  serialEcho = echo;
+}
+
+static void serialWrite(const char *text) {
+  if (!serialEcho) return;
+  for (; *text; text++) {
+    if (atLineStart) printf("[%11.6f] ", nowNs / (double)SIM_NS_PER_S);
+    putchar(*text);
+    atLineStart = *text == '\n';
+  }
+}
+
+size_t HardwareSerial::print(const char *s) {
+  serialWrite(s);
+  return strlen(s);
+}
+
+size_t HardwareSerial::println(const char *s) {
+  serialWrite(s);
+  serialWrite("\n");
+  return strlen(s) + 1;
+}
+
+size_t HardwareSerial::printf(const char *format, ...) {
+  char text[512];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  serialWrite(text);
+  return len < 0 ? 0 : len;
+}
+
+// Heap in use is counted through operator new, which is all the firmware
+// allocates with (String, std::function, containers), the simulation's
+// own bookkeeping included. glibc's arena gives the largest block: a hole
+// left under a long-lived allocation cannot be handed out whole.
+static size_t heapInUse = 0;
+static uint32_t minFreeHeap = UINT32_MAX;
+
+#ifdef __GLIBC__
+void *operator new(size_t size) {
+  void *p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  heapInUse += malloc_usable_size(p);
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  if (!p) return;
+  heapInUse -= malloc_usable_size(p);
+  free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept {
+  operator delete(p);
+}
+#endif
+
+static uint32_t budgetLeft(size_t used) {
+  return used < SIM_HEAP_SIZE ? SIM_HEAP_SIZE - used : 0;
+}
+
+uint32_t EspClass::getFreeHeap() {
+  uint32_t free = budgetLeft(heapInUse);
+  if (free < minFreeHeap) minFreeHeap = free;
+  return free;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  getFreeHeap();
+  return minFreeHeap;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+  #ifdef __GLIBC__
+  struct mallinfo2 mi = mallinfo2();
+  return budgetLeft(mi.arena - mi.keepcost);
+  #else
+  return getFreeHeap();
+  #endif
+}
+
+void EspClass::restart() {
+  serialWrite("sim: ESP.restart()\n");
+  fflush(stdout);
+  exit(0);
+}
@@ -0,0 +1,97 @@
+#include "sim.h"
+
+#include <Arduino.h>
+#include <driver/gpio.h>
+#include <driver/mcpwm_cap.h>
+#include <soc/mcpwm_periph.h>
+#include <esp_rom_crc.h>
+#include <esp_rom_gpio.h>
+#include <esp_ota_ops.h>
+
+// ============================================
+// ROM
+// ============================================
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  crc = ~crc;
+  while (len--) {
+    crc ^= *buf++;
+    for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+void esp_rom_gpio_connect_in_signal(uint32_t gpio, uint32_t signal, bool invert) {}
+void esp_rom_gpio_connect_out_signal(uint32_t gpio, uint32_t signal, bool invertOut, bool invertOe) {}
+
+esp_err_t gpio_input_enable(gpio_num_t gpio) {
+  return ESP_OK;
+}
+
+// ============================================
+// Peripherals Not Modelled
+// ============================================
+
+const mcpwm_signal_conn_t mcpwm_periph_signals = {};
+
+esp_err_t mcpwm_new_capture_timer(const mcpwm_capture_timer_config_t *config,
+                                  mcpwm_cap_timer_handle_t *timer) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t mcpwm_capture_timer_get_resolution(mcpwm_cap_timer_handle_t timer, uint32_t *hz) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t mcpwm_capture_timer_enable(mcpwm_cap_timer_handle_t timer) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t mcpwm_capture_timer_start(mcpwm_cap_timer_handle_t timer) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t mcpwm_new_capture_channel(mcpwm_cap_timer_handle_t timer,
+                                    const mcpwm_capture_channel_config_t *config,
+                                    mcpwm_cap_channel_handle_t *channel) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t mcpwm_capture_channel_register_event_callbacks(mcpwm_cap_channel_handle_t channel,
+                                                         const mcpwm_capture_event_callbacks_t *cbs,
+                                                         void *arg) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t mcpwm_capture_channel_enable(mcpwm_cap_channel_handle_t channel) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+// ============================================
+// Flash
+// ============================================
+// The idle OTA slot takes erases and writes and keeps nothing; they only
+// cost their time (simFlashStall).
+
+#define SIM_FLASH_SECTOR 4096
+#define SIM_FLASH_PAGE 256
+
+static const esp_partition_t otaPartition = {0x150000, SIM_OTA_PARTITION_SIZE, "ota_1"};
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start) {
+  return &otaPartition;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+  if (offset % SIM_FLASH_SECTOR || size % SIM_FLASH_SECTOR) return ESP_ERR_INVALID_ARG;
+  if (offset + size > partition->size) return ESP_ERR_INVALID_ARG;
+  simFlashStall(size / SIM_FLASH_SECTOR * SIM_FLASH_ERASE_US * 1000ULL);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size) {
+  if (offset + size > partition->size) return ESP_ERR_INVALID_ARG;
+  size_t pages = (offset + size + SIM_FLASH_PAGE - 1) / SIM_FLASH_PAGE - offset / SIM_FLASH_PAGE;
+  simFlashStall(pages * SIM_FLASH_PAGE_US * 1000ULL);
+  return ESP_OK;
+}
@@ -0,0 +1,13 @@
+#include "sim.h"
+
+#include <stdlib.h>
+
+// Running the env:native program boots the firmware and runs it for the
+// given number of virtual seconds (default 10). Test programs bring their
+// own main(), which takes precedence.
+__attribute__((weak)) int main(int argc, char **argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 10.0;
+  simBoot();
+  simRunFor((uint64_t)(seconds * SIM_NS_PER_S));
+  return 0;
+}
@@ -0,0 +1,432 @@
+#include "sim.h"
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WebServer.h>
+#include <Preferences.h>
+#include <ElegantOTA.h>
+#include <strings.h>
+#include <algorithm>
+#include <deque>
+
+// ============================================
+// WiFi
+// ============================================
+
+#define SIM_STA_IP IPAddress(192, 168, 1, 50)
+#define SIM_AP_IP IPAddress(192, 168, 4, 1)
+#define SIM_RSSI -55
+#define SIM_REASON_ASSOC_LEAVE 8
+#define SIM_REASON_BEACON_TIMEOUT 200
+
+WiFiClass WiFi;
+ElegantOTAClass ElegantOTA;
+
+static wifi_mode_t wifiMode = WIFI_OFF;
+static wl_status_t staStatus = WL_IDLE_STATUS;
+static bool apInRange = true;
+static bool apUp = false;
+static uint32_t attempt = 0;   // a join in flight completes only if still current
+static std::vector<WiFiEventFuncCb> wifiCallbacks;
+
+// Event callbacks run from the driver's event task on the target: later,
+// never inside the call that caused them
+static void postWifiEvent(arduino_event_id_t event, uint8_t reason) {
+  simAt(simNowNs(), [event, reason]() {
+    arduino_event_info_t info;
+    info.wifi_sta_disconnected.reason = reason;
+    for (WiFiEventFuncCb cb : wifiCallbacks) cb(event, info);
+  });
+}
+
+String IPAddress::toString() const {
+  char text[16];
+  snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return String(text);
+}
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+  wifiMode = mode;
+  return true;
+}
+
+wifi_mode_t WiFiClass::getMode() {
+  return wifiMode;
+}
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *password) {
+  uint32_t id = ++attempt;
+  staStatus = WL_DISCONNECTED;
+  simAt(simNowNs() + SIM_WIFI_JOIN_MS * SIM_NS_PER_MS, [id]() {
+    if (id != attempt || !apInRange) return;
+    staStatus = WL_CONNECTED;
+    postWifiEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP, 0);
+  });
+  return staStatus;
+}
+
+bool WiFiClass::disconnect(bool wifiOff, bool eraseAp) {
+  attempt++;
+  staStatus = WL_DISCONNECTED;
+  postWifiEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, SIM_REASON_ASSOC_LEAVE);
+  return true;
+}
+
+wl_status_t WiFiClass::status() {
+  return staStatus;
+}
+
+IPAddress WiFiClass::localIP() {
+  return staStatus == WL_CONNECTED ? SIM_STA_IP : IPAddress();
+}
+
+int8_t WiFiClass::RSSI() {
+  return staStatus == WL_CONNECTED ? SIM_RSSI : 0;
+}
+
+int WiFiClass::onEvent(WiFiEventFuncCb cb) {
+  wifiCallbacks.push_back(cb);
+  return wifiCallbacks.size();
+}
+
+bool WiFiClass::softAP(const char *ssid, const char *password) {
+  apUp = password == NULL || strlen(password) >= 8;
+  return apUp;
+}
+
+bool WiFiClass::softAPdisconnect(bool wifiOff) {
+  apUp = false;
+  return true;
+}
+
+IPAddress WiFiClass::softAPIP() {
+  return apUp ? SIM_AP_IP : IPAddress();
+}
+
+void simSetWifiAvailable(bool available) {
+  apInRange = available;
+  if (!available && staStatus == WL_CONNECTED) {
+    staStatus = WL_DISCONNECTED;
+    postWifiEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, SIM_REASON_BEACON_TIMEOUT);
+  }
+}
+
+uint8_t WiFiClient::connected() {
+  return conn && conn->open;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size) {
+  if (!connected()) return 0;
+  conn->data.append((const char *)buf, size);
+  return size;
+}
+
+void WiFiClient::stop() {
+  if (conn) conn->open = false;
+  conn.reset();
+}
+
+// ============================================
+// WebServer
+// ============================================
+
+struct SimHttpRequest {
+  HTTPMethod method;
+  std::string path;
+  std::map<std::string, std::string> args;
+  std::string body;
+  std::map<std::string, std::string> headers;
+  std::shared_ptr<SimConnection> conn;   // once the handler asked for it
+  bool answered = false;
+  SimResponse response;
+};
+
+// Requests waiting per port. Servers are globals in the firmware, so this
+// has to exist before any constructor runs.
+static std::deque<SimHttpRequest *> &pendingFor(int port) {
+  static std::map<int, std::deque<SimHttpRequest *>> pending;
+  return pending[port];
+}
+
+static HTTPMethod methodFor(const char *name) {
+  static const struct {
+    const char *name;
+    HTTPMethod method;
+  } methods[] = {
+    {"GET", HTTP_GET}, {"HEAD", HTTP_HEAD}, {"POST", HTTP_POST}, {"PUT", HTTP_PUT},
+    {"PATCH", HTTP_PATCH}, {"DELETE", HTTP_DELETE}, {"OPTIONS", HTTP_OPTIONS},
+  };
+  for (const auto &m : methods) {
+    if (strcasecmp(name, m.name) == 0) return m.method;
+  }
+  return HTTP_ANY;
+}
+
+static void parseQuery(const std::string &query, std::map<std::string, std::string> &args) {
+  size_t start = 0;
+  while (start < query.size()) {
+    size_t end = query.find('&', start);
+    if (end == std::string::npos) end = query.size();
+    std::string pair = query.substr(start, end - start);
+    size_t eq = pair.find('=');
+    if (eq == std::string::npos) args[pair] = "";
+    else args[pair.substr(0, eq)] = pair.substr(eq + 1);
+    start = end + 1;
+  }
+}
+
+SimResponse simRequest(const char *method, const char *uri, const std::string &body,
+                       const std::map<std::string, std::string> &headers) {
+  SimHttpRequest request;
+  request.method = methodFor(method);
+  std::string target(uri);
+  size_t q = target.find('?');
+  request.path = target.substr(0, q);
+  if (q != std::string::npos) parseQuery(target.substr(q + 1), request.args);
+  request.body = body;
+  request.headers = headers;
+
+  std::deque<SimHttpRequest *> &pending = pendingFor(80);
+  pending.push_back(&request);
+  uint64_t deadline = simNowNs() + SIM_REQUEST_TIMEOUT_MS * SIM_NS_PER_MS;
+  while (!request.answered && simNowNs() < deadline) simRunFor(SIM_NS_PER_MS);
+  if (!request.answered) pending.erase(std::find(pending.begin(), pending.end(), &request));
+  return request.response;
+}
+
+WebServer::WebServer(int port) : port(port) {}
+
+void WebServer::begin() {
+  started = true;
+}
+
+void WebServer::handleClient() {
+  std::deque<SimHttpRequest *> &pending = pendingFor(port);
+  if (!started || pending.empty()) return;
+  current = pending.front();
+  pending.pop_front();
+  pendingHeaders.clear();
+
+  THandlerFunction handler = notFound;
+  for (const Route &route : routes) {
+    if (route.uri == current->path && (route.method == HTTP_ANY || route.method == current->method)) {
+      handler = route.handler;
+      break;
+    }
+  }
+  if (handler) handler();
+  else send(404, "text/plain", String("Not found: ") + current->path);
+
+  // A handler that took the connection answers through it
+  if (!current->answered && current->conn) {
+    current->response.code = 200;
+    current->response.stream = current->conn;
+  }
+  current->answered = true;
+  current = NULL;
+}
+
+void WebServer::on(const String &uri, THandlerFunction handler) {
+  on(uri, HTTP_ANY, handler);
+}
+
+void WebServer::on(const String &uri, HTTPMethod method, THandlerFunction handler) {
+  routes.push_back({uri, method, handler});
+}
+
+void WebServer::onNotFound(THandlerFunction handler) {
+  notFound = handler;
+}
+
+HTTPMethod WebServer::method() {
+  return current ? current->method : HTTP_ANY;
+}
+
+String WebServer::uri() {
+  return current ? String(current->path) : String();
+}
+
+// The body arrives as "plain", like a non-form body on the target
+bool WebServer::hasArg(const String &name) {
+  if (!current) return false;
+  if (name == "plain") return !current->body.empty();
+  return current->args.count(name) > 0;
+}
+
+String WebServer::arg(const String &name) {
+  if (!current) return String();
+  if (name == "plain") return String(current->body);
+  auto it = current->args.find(name);
+  return it != current->args.end() ? String(it->second) : String();
+}
+
+void WebServer::collectHeaders(const char *headerKeys[], const size_t count) {
+  collected.assign(headerKeys, headerKeys + count);
+}
+
+// Only collected headers are kept, as on the target
+bool WebServer::hasHeader(const String &name) {
+  if (!current) return false;
+  bool wanted = std::any_of(collected.begin(), collected.end(),
+                            [&](const String &key) { return strcasecmp(key.c_str(), name.c_str()) == 0; });
+  if (!wanted) return false;
+  for (const auto &h : current->headers) {
+    if (strcasecmp(h.first.c_str(), name.c_str()) == 0) return true;
+  }
+  return false;
+}
+
+String WebServer::header(const String &name) {
+  if (!hasHeader(name)) return String();
+  for (const auto &h : current->headers) {
+    if (strcasecmp(h.first.c_str(), name.c_str()) == 0) return String(h.second);
+  }
+  return String();
+}
+
+WiFiClient WebServer::client() {
+  if (!current) return WiFiClient();
+  if (!current->conn) current->conn = std::make_shared<SimConnection>();
+  return WiFiClient(current->conn);
+}
+
+void WebServer::sendHeader(const String &name, const String &value, bool first) {
+  pendingHeaders.emplace_back(name, value);
+}
+
+void WebServer::send(int code, const char *contentType, const String &content) {
+  send_P(code, contentType, content.data(), content.size());
+}
+
+void WebServer::send_P(int code, PGM_P contentType, PGM_P content) {
+  send_P(code, contentType, content, content ? strlen(content) : 0);
+}
+
+void WebServer::send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength) {
+  if (!current || current->answered) return;
+  SimResponse &r = current->response;
+  r.code = code;
+  r.type = contentType ? contentType : "";
+  r.body.assign(content ? content : "", content ? contentLength : 0);
+  for (const auto &h : pendingHeaders) r.headers[h.first] = h.second;
+  pendingHeaders.clear();
+  current->answered = true;
+}
+
+// ============================================
+// Preferences
+// ============================================
+// Values keep their type, so reading a key as another type fails as it
+// does in NVS.
+
+#define SIM_NVS_KEY_MAX 15
+
+struct SimNvsValue {
+  char type;   // 'f' float, 'u' uint32, 'b' bool, 'B' blob
+  std::vector<uint8_t> bytes;
+};
+
+static std::map<std::string, std::map<std::string, SimNvsValue>> nvs;
+static uint32_t flashWrites = 0;
+
+uint32_t simFlashWrites() {
+  return flashWrites;
+}
+
+static void flashWrite() {
+  flashWrites++;
+  simFlashStall(SIM_NVS_WRITE_US * 1000ULL);
+}
+
+bool Preferences::begin(const char *ns, bool readOnly, const char *partition) {
+  if (!ns || strlen(ns) > SIM_NVS_KEY_MAX) return false;
+  name = ns;
+  open = true;
+  this->readOnly = readOnly;
+  return true;
+}
+
+void Preferences::end() {
+  open = false;
+}
+
+bool Preferences::clear() {
+  if (!open || readOnly) return false;
+  nvs[name].clear();
+  flashWrite();
+  return true;
+}
+
+bool Preferences::remove(const char *key) {
+  if (!open || readOnly || nvs[name].erase(key) == 0) return false;
+  flashWrite();
+  return true;
+}
+
+bool Preferences::isKey(const char *key) {
+  return open && nvs[name].count(key) > 0;
+}
+
+static size_t putValue(bool writable, const std::string &ns, const char *key, char type,
+                       const void *value, size_t len) {
+  if (!writable || !key || strlen(key) > SIM_NVS_KEY_MAX) return 0;
+  const uint8_t *bytes = (const uint8_t *)value;
+  nvs[ns][key] = {type, std::vector<uint8_t>(bytes, bytes + len)};
+  flashWrite();
+  return len;
+}
+
+static const SimNvsValue *getValue(bool open, const std::string &ns, const char *key, char type) {
+  if (!open) return NULL;
+  auto &space = nvs[ns];
+  auto it = space.find(key);
+  return it != space.end() && it->second.type == type ? &it->second : NULL;
+}
+
+size_t Preferences::putFloat(const char *key, float value) {
+  return putValue(open && !readOnly, name, key, 'f', &value, sizeof(value));
+}
+
+size_t Preferences::putUInt(const char *key, uint32_t value) {
+  return putValue(open && !readOnly, name, key, 'u', &value, sizeof(value));
+}
+
+size_t Preferences::putBool(const char *key, bool value) {
+  uint8_t byte = value;
+  return putValue(open && !readOnly, name, key, 'b', &byte, sizeof(byte));
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len) {
+  return putValue(open && !readOnly, name, key, 'B', value, len);
+}
+
+float Preferences::getFloat(const char *key, float defaultValue) {
+  const SimNvsValue *v = getValue(open, name, key, 'f');
+  float value = defaultValue;
+  if (v) memcpy(&value, v->bytes.data(), sizeof(value));
+  return value;
+}
+
+uint32_t Preferences::getUInt(const char *key, uint32_t defaultValue) {
+  const SimNvsValue *v = getValue(open, name, key, 'u');
+  uint32_t value = defaultValue;
+  if (v) memcpy(&value, v->bytes.data(), sizeof(value));
+  return value;
+}
+
+bool Preferences::getBool(const char *key, bool defaultValue) {
+  const SimNvsValue *v = getValue(open, name, key, 'b');
+  return v ? v->bytes[0] != 0 : defaultValue;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  const SimNvsValue *v = getValue(open, name, key, 'B');
+  return v ? v->bytes.size() : 0;
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) {
+  const SimNvsValue *v = getValue(open, name, key, 'B');
+  if (!v || v->bytes.size() > maxLen) return 0;
+  memcpy(buf, v->bytes.data(), v->bytes.size());
+  return v->bytes.size();
+}
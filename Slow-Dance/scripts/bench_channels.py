@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Edge jitter against the number of scheduled channels.
+#
+# Needs a board running the ISR backend with EDGE_PROFILER enabled and
+# extra channels in WAVEFORM_EXTRA_CHANNELS (the default table has five
+# without output pins). For n = 0..extra channels it enables the first n
+# at spread frequencies, resets the metrics, lets the profiler collect and
+# reports the LED and magnet edge timing. The extra channels are switched
+# off again at the end.
+#
+#   python3 scripts/bench_channels.py 192.168.1.50 --seconds 20
+
+import argparse
+import json
+import time
+import urllib.request
+
+
+def request(host, path, method="GET", body=None):
+    data = json.dumps(body).encode() if body is not None else None
+    req = urllib.request.Request("http://%s%s" % (host, path), data=data, method=method,
+                                 headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(req, timeout=5) as resp:
+        text = resp.read().decode()
+    return json.loads(text) if text.startswith("{") else text
+
+
+def set_extra(host, channels, count):
+    for k, ch in enumerate(channels):
+        # Free channels spread over the range so their edges keep colliding
+        # with the LED and magnet edges at different offsets
+        body = {"index": ch["index"], "enabled": k < count}
+        if ch["leader"] < 0:
+            body.update(freq=60.0 + 7.3 * k, duty=30.0)
+        request(host, "/api/channels", "POST", body)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("host")
+    parser.add_argument("--seconds", type=float, default=10.0, help="collection time per step")
+    args = parser.parse_args()
+
+    table = request(args.host, "/api/channels")
+    extra = [ch for ch in table["channels"] if "enabled" in ch]
+    if not extra:
+        raise SystemExit("no extra channels: build with the ISR backend and WAVEFORM_EXTRA_CHANNELS")
+
+    print("%8s %12s %12s %12s %12s %8s" %
+          ("channels", "led jit us", "led max us", "mag jit us", "mag max us", "dropped"))
+    try:
+        for count in range(len(extra) + 1):
+            set_extra(args.host, extra, count)
+            request(args.host, "/api/metrics", "DELETE")
+            time.sleep(args.seconds)
+            m = request(args.host, "/api/metrics")
+            led, mag = m["led"], m["magnet"]
+            worst = lambda c: max(abs(c["minErrUs"] or 0), abs(c["maxErrUs"] or 0))
+            print("%8d %12.3f %12.3f %12.3f %12.3f %8d" %
+                  (3 + count, led["jitterUs"] or 0, worst(led),
+                   mag["jitterUs"] or 0, worst(mag), m["dropped"]))
+    finally:
+        set_extra(args.host, extra, 0)
+
+
+if __name__ == "__main__":
+    main()
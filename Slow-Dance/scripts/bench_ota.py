@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+# Edge timing with and without flash writes going on.
+#
+# Needs a board built with EDGE_PROFILER and OTA_TEST. Collects the LED
+# and magnet edge timing for a quiet baseline, then again while the board
+# rewrites its idle OTA partition at an upload's pace (/api/otatest), and
+# prints the two side by side. Whatever firmware was in the idle OTA slot
+# is overwritten.
+#
+#   python3 scripts/bench_ota.py 192.168.1.50 --seconds 30
+
+import argparse
+import json
+import time
+import urllib.request
+
+
+def request(host, path, method="GET", body=None):
+    data = json.dumps(body).encode() if body is not None else None
+    req = urllib.request.Request("http://%s%s" % (host, path), data=data, method=method,
+                                 headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(req, timeout=5) as resp:
+        text = resp.read().decode()
+    return json.loads(text) if text.startswith("{") else text
+
+
+def row(name, m):
+    led, mag = m["led"], m["magnet"]
+    worst = lambda c: max(abs(c["minErrUs"] or 0), abs(c["maxErrUs"] or 0))
+    print("%-10s %12.3f %12.3f %12.3f %12.3f %8d" %
+          (name, led["jitterUs"] or 0, worst(led), mag["jitterUs"] or 0, worst(mag), m["dropped"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("host")
+    parser.add_argument("--seconds", type=float, default=20.0, help="collection time per run")
+    args = parser.parse_args()
+
+    request(args.host, "/api/metrics", "DELETE")
+    time.sleep(args.seconds)
+    baseline = request(args.host, "/api/metrics")
+
+    request(args.host, "/api/otatest", "POST", {"seconds": int(args.seconds)})
+    while request(args.host, "/api/otatest")["running"]:
+        time.sleep(1)
+    loaded = request(args.host, "/api/metrics")
+    test = request(args.host, "/api/otatest")
+
+    print("%-10s %12s %12s %12s %12s %8s" %
+          ("run", "led jit us", "led max us", "mag jit us", "mag max us", "dropped"))
+    row("baseline", baseline)
+    row("flash", loaded)
+    print("%d sectors rewritten, longest %.1f ms" % (test["sectors"], test["maxWriteUs"] / 1000.0))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+# Waveform precision benchmark over a matrix of (LED Hz, magnet Hz, LED
+# duty) configurations, on both firmwares without hardware:
+#
+#   esp32  the ISR backend on the native simulation (env:bench, bench/)
+#   avr    the Twin's lib/PWM on the host ATmega328P timer model
+#          ("Slow dance - Twin", env:bench, bench/)
+#
+# Each bench program writes a VCD trace of the LED and magnet pins per
+# configuration (open them in GTKWave); this script builds and runs them
+# and works out, per configuration:
+#
+#   led/mag ppm   mean frequency over the trace against the one asked for
+#   jit rms/pk    period deviation from the mean period, ns
+#   beat mHz      (LED - magnet) measured against (LED - magnet) asked for
+#   duty %        mean LED high time against the duty asked for, points
+#   irq/edge      interrupts taken per traced edge
+#   host ns/edge  host CPU time of the run per traced edge
+#
+# --save keeps the numbers as CSV; --compare checks a run against such a
+# file and exits non-zero if a precision figure got worse.
+#
+#   python3 scripts/bench_waveforms.py
+#   python3 scripts/bench_waveforms.py 80.4:79.8:10 84.8:79.8:10 --seconds 30 --paths avr
+#   python3 scripts/bench_waveforms.py --save before.csv
+#   python3 scripts/bench_waveforms.py --compare before.csv
+
+import argparse
+import csv
+import math
+import os
+import re
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+PROJECTS = {
+    "esp32": os.path.normpath(os.path.join(HERE, "..")),
+    "avr": os.path.normpath(os.path.join(HERE, "..", "..", "Slow dance - Twin")),
+}
+
+COLUMNS = ["led_ppm", "mag_ppm", "led_jit_ns", "mag_jit_ns", "jit_pk_ns", "beat_mhz", "duty_pts",
+           "irq_per_edge", "host_ns_per_edge"]
+
+# Worse than the saved figure by more than this (and 5 %) is a regression.
+# Host time is too noisy to judge.
+TOLERANCE = {"led_ppm": 1.0, "mag_ppm": 1.0, "led_jit_ns": 1.0, "mag_jit_ns": 1.0,
+             "jit_pk_ns": 1.0, "beat_mhz": 0.1, "duty_pts": 0.01, "irq_per_edge": 0.01}
+
+TIMESCALE_S = {"s": 1.0, "ms": 1e-3, "us": 1e-6, "ns": 1e-9, "ps": 1e-12, "fs": 1e-15}
+
+
+def read_vcd(path):
+    """Header fields and {signal name: [(seconds, level), ...]}, changes only"""
+    with open(path) as f:
+        text = f.read()
+    header, _, body = text.partition("$enddefinitions $end")
+    fields = dict(re.findall(r"(\w+)=(\S+)", re.search(r"\$comment(.*?)\$end", header, re.S).group(1)))
+    count, unit = re.search(r"\$timescale\s*(\d+)\s*(\w+)\s*\$end", header).groups()
+    scale = int(count) * TIMESCALE_S[unit]
+    names = dict((ident, name) for ident, name in
+                 re.findall(r"\$var\s+\w+\s+1\s+(\S+)\s+(\S+)", header))
+    traces = dict((name, []) for name in names.values())
+    levels = {}
+    t = 0.0
+    for token in body.split():
+        if token.startswith("#"):
+            t = int(token[1:]) * scale
+        elif token[0] in "01" and token[1:] in names:
+            name, level = names[token[1:]], int(token[0])
+            if name in levels and levels[name] != level:   # not the $dumpvars values
+                traces[name].append((t, level))
+            levels[name] = level
+    return fields, traces
+
+
+def rising(trace):
+    return [t for t, level in trace if level]
+
+
+def frequency(rises):
+    if len(rises) < 2:
+        return float("nan")
+    return (len(rises) - 1) / (rises[-1] - rises[0])
+
+
+def jitter(rises):
+    """RMS and peak period deviation from the mean period, ns"""
+    periods = [b - a for a, b in zip(rises, rises[1:])]
+    if len(periods) < 2:
+        return float("nan"), float("nan")
+    mean = sum(periods) / len(periods)
+    devs = [p - mean for p in periods]
+    return (math.sqrt(sum(d * d for d in devs) / len(devs)) * 1e9,
+            max(abs(d) for d in devs) * 1e9)
+
+
+def duty(trace):
+    """Mean high time over whole periods, % of the mean period"""
+    high, rise = [], None
+    for t, level in trace:
+        if level:
+            rise = t
+        elif rise is not None:
+            high.append(t - rise)
+    rises = rising(trace)
+    if not high or len(rises) < 2:
+        return float("nan")
+    return 100.0 * (sum(high) / len(high)) * frequency(rises)
+
+
+def analyse(path):
+    fields, traces = read_vcd(path)
+    led_hz, mag_hz, want_duty = (float(fields[k]) for k in ("led_hz", "mag_hz", "duty"))
+    led, mag = rising(traces["led"]), rising(traces["magnet"])
+    led_f, mag_f = frequency(led), frequency(mag)
+    led_rms, led_pk = jitter(led)
+    mag_rms, mag_pk = jitter(mag)
+    edges = sum(len(trace) for trace in traces.values())
+    return {
+        "path": fields["path"], "led_hz": led_hz, "mag_hz": mag_hz, "duty": want_duty,
+        "led_ppm": (led_f / led_hz - 1) * 1e6,
+        "mag_ppm": (mag_f / mag_hz - 1) * 1e6,
+        "led_jit_ns": led_rms, "mag_jit_ns": mag_rms, "jit_pk_ns": max(led_pk, mag_pk),
+        "beat_mhz": ((led_f - mag_f) - (led_hz - mag_hz)) * 1e3,
+        "duty_pts": duty(traces["led"]) - want_duty,
+        "irq_per_edge": int(fields["interrupts"]) / edges if edges else float("nan"),
+        "host_ns_per_edge": int(fields["host_ns"]) / edges if edges else float("nan"),
+        "vcd": path,
+    }
+
+
+def run_path(name, configs, seconds, out, build):
+    project = PROJECTS[name]
+    if build:
+        subprocess.run(["pio", "run", "-e", "bench", "-d", project], check=True,
+                       stdout=subprocess.DEVNULL)
+    program = os.path.join(project, ".pio", "build", "bench", "program")
+    cmd = [program, "--seconds", str(seconds), "--out", out] + configs
+    result = subprocess.run(cmd, check=True, stdout=subprocess.PIPE, universal_newlines=True)
+    return [analyse(p) for p in result.stdout.split()]
+
+
+def key(row):
+    return (row["path"], float(row["led_hz"]), float(row["mag_hz"]), float(row["duty"]))
+
+
+def print_table(rows):
+    print("%-5s %7s %7s %5s %10s %10s %8s %8s %8s %9s %8s %8s %11s" %
+          ("path", "led Hz", "mag Hz", "duty", "led ppm", "mag ppm", "led jit", "mag jit",
+           "jit pk", "beat mHz", "duty %", "irq/edge", "host ns/edge"))
+    for r in rows:
+        print("%-5s %7g %7g %5g %10.1f %10.1f %8.1f %8.1f %8.1f %9.2f %8.3f %8.2f %11.0f" %
+              (r["path"], r["led_hz"], r["mag_hz"], r["duty"], r["led_ppm"], r["mag_ppm"],
+               r["led_jit_ns"], r["mag_jit_ns"], r["jit_pk_ns"], r["beat_mhz"], r["duty_pts"],
+               r["irq_per_edge"], r["host_ns_per_edge"]))
+
+
+def compare(rows, path):
+    with open(path) as f:
+        saved = dict((key(r), r) for r in csv.DictReader(f))
+    worse = 0
+    for r in rows:
+        old = saved.get(key(r))
+        if not old:
+            continue
+        for col, tol in TOLERANCE.items():
+            before, now = abs(float(old[col])), abs(r[col])
+            if now > before * 1.05 + tol:
+                print("%s %g:%g:%g %s: %.3f -> %.3f" %
+                      (r["path"], r["led_hz"], r["mag_hz"], r["duty"], col, float(old[col]), r[col]))
+                worse += 1
+    print("%d regression(s) against %s" % (worse, path))
+    return worse
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("configs", nargs="*", help="LED_HZ:MAG_HZ:DUTY (default: the benches' matrix)")
+    parser.add_argument("--seconds", type=float, default=10.0, help="trace length per configuration")
+    parser.add_argument("--paths", default="esp32,avr", help="comma-separated: esp32, avr")
+    parser.add_argument("--out", default=os.path.join(PROJECTS["esp32"], ".pio", "bench"),
+                        help="directory for the VCD traces")
+    parser.add_argument("--no-build", action="store_true", help="run the programs as built")
+    parser.add_argument("--save", metavar="CSV", help="write the numbers to CSV")
+    parser.add_argument("--compare", metavar="CSV", help="report regressions against a saved run")
+    args = parser.parse_args()
+
+    out = os.path.abspath(args.out)
+    os.makedirs(out, exist_ok=True)
+    rows = []
+    for name in args.paths.split(","):
+        rows += run_path(name, args.configs, args.seconds, out, not args.no_build)
+    print_table(rows)
+    print("traces in %s" % out)
+
+    if args.save:
+        with open(args.save, "w", newline="") as f:
+            w = csv.DictWriter(f, fieldnames=["path", "led_hz", "mag_hz", "duty"] + COLUMNS,
+                               extrasaction="ignore")
+            w.writeheader()
+            w.writerows(rows)
+    if args.compare and compare(rows, args.compare):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
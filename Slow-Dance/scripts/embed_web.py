@@ -0,0 +1,64 @@
+# Pre-build step: gzip the web UI and embed it as a C array.
+#
+# Every file in web/ becomes WEB_<NAME>_GZ / WEB_<NAME>_GZ_LEN /
+# WEB_<NAME>_ETAG in web_assets.h, generated in the build directory so
+# the source tree stays clean. The ETag is a hash of the content, so
+# browsers revalidate with If-None-Match and get a 304 until the page
+# actually changes.
+
+Import("env")
+
+import gzip
+import hashlib
+import os
+import re
+
+project_dir = env.subst("$PROJECT_DIR")
+web_dir = os.path.join(project_dir, "web")
+out_dir = os.path.join(env.subst("$BUILD_DIR"), "generated")
+out_path = os.path.join(out_dir, "web_assets.h")
+
+
+def symbol(filename):
+    return "WEB_" + re.sub(r"[^A-Za-z0-9]", "_", os.path.splitext(filename)[0]).upper()
+
+
+def embed(name, data):
+    # mtime=0 keeps the output (and the ETag) reproducible
+    packed = gzip.compress(data, compresslevel=9, mtime=0)
+    etag = hashlib.sha1(data).hexdigest()[:16]
+    rows = []
+    for i in range(0, len(packed), 16):
+        rows.append("  " + ", ".join("0x%02x" % b for b in packed[i:i + 16]) + ",")
+    return (
+        '#define %s_ETAG "\\"%s\\""\n' % (name, etag)
+        + "const size_t %s_GZ_LEN = %d;  // %d bytes uncompressed\n" % (name, len(packed), len(data))
+        + "const uint8_t %s_GZ[] PROGMEM = {\n%s\n};\n" % (name, "\n".join(rows))
+    )
+
+
+def generate():
+    parts = [
+        "// Generated by scripts/embed_web.py from web/ - do not edit\n",
+        "#ifndef WEB_ASSETS_H\n#define WEB_ASSETS_H\n\n#include <Arduino.h>\n",
+    ]
+    for filename in sorted(os.listdir(web_dir)):
+        with open(os.path.join(web_dir, filename), "rb") as f:
+            parts.append("\n" + embed(symbol(filename), f.read()))
+    parts.append("\n#endif // WEB_ASSETS_H\n")
+    text = "".join(parts)
+
+    # Only touch the header when it changes, so unchanged pages don't
+    # trigger a rebuild
+    if os.path.exists(out_path):
+        with open(out_path) as f:
+            if f.read() == text:
+                return
+    os.makedirs(out_dir, exist_ok=True)
+    with open(out_path, "w") as f:
+        f.write(text)
+    print("embed_web: wrote %s" % out_path)
+
+
+generate()
+env.Append(CPPPATH=[out_dir])
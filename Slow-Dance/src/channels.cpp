@@ -0,0 +1,63 @@
+#include "channels.h"
+#include "config.h"
+#include "settings_store.h"
+
+static portMUX_TYPE channelsMux = portMUX_INITIALIZER_UNLOCKED;
+static WaveformChannel extra[CHANNELS_EXTRA_MAX];
+
+void channelsBegin() {
+  if (storeAttach(STORE_CHANNELS, extra, sizeof(extra))) {
+    // Tables saved before extra channels were held to the coil limit
+    for (int i = 0; i < CHANNELS_EXTRA_MAX; i++) {
+      if (extra[i].duty <= MAGNET_DUTY_MAX) continue;
+      extra[i].duty = MAGNET_DUTY_MAX;
+      storeMarkDirty(STORE_CHANNELS);
+    }
+    return;
+  }
+
+  // Padding included, so the stored CRC only changes with the values
+  memset(extra, 0, sizeof(extra));
+  for (int i = 0; i < CHANNELS_EXTRA_MAX; i++) {
+    extra[i].freq = DEFAULT_MAGNET_FREQ;
+    extra[i].duty = DEFAULT_MAGNET_DUTY;
+  }
+}
+
+int channelsExtraCount() {
+  return waveformChannelCount() - WAVEFORM_FIRST_EXTRA;
+}
+
+bool channelsGet(int index, WaveformChannel &channel) {
+  int i = index - WAVEFORM_FIRST_EXTRA;
+  if (i < 0 || i >= channelsExtraCount()) return false;
+  channel = extra[i];
+  return true;
+}
+
+bool channelsSet(int index, const WaveformChannel &channel) {
+  int i = index - WAVEFORM_FIRST_EXTRA;
+  if (i < 0 || i >= channelsExtraCount()) return false;
+  // Any extra channel may drive a coil, and the thermal model only covers
+  // the built-in magnets: hold them all to the magnet's duty limit
+  if (channel.freq < FREQ_MIN || channel.freq > FREQ_MAX ||
+      channel.duty < LED_DUTY_MIN || channel.duty > MAGNET_DUTY_MAX ||
+      channel.phase < MAGNET_PHASE_MIN || channel.phase > MAGNET_PHASE_MAX) {
+    return false;
+  }
+
+  portENTER_CRITICAL(&channelsMux);
+  extra[i].enabled = channel.enabled;
+  extra[i].freq = channel.freq;
+  extra[i].duty = channel.duty;
+  extra[i].phase = channel.phase;
+  portEXIT_CRITICAL(&channelsMux);
+  storeMarkDirty(STORE_CHANNELS);
+  return true;
+}
+
+void channelsCopy(WaveformChannel *channels) {
+  portENTER_CRITICAL(&channelsMux);
+  memcpy(channels, extra, sizeof(extra));
+  portEXIT_CRITICAL(&channelsMux);
+}
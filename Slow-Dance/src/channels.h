@@ -0,0 +1,32 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+#include <Arduino.h>
+#include "waveform.h"
+
+// ============================================
+// Extra Channels
+// ============================================
+// Settings of the channels scheduled after the LED and the magnets (see
+// WAVEFORM_EXTRA_CHANNELS), e.g. further objects with their own beat.
+// Kept in RAM and persisted through the settings store. The network task
+// edits them; the waveform task copies them out when told to publish.
+
+#define CHANNELS_EXTRA_MAX (WAVEFORM_MAX_CHANNELS - WAVEFORM_FIRST_EXTRA)
+
+void channelsBegin();
+
+// Extra channels in this build; 0 on the LEDC backend.
+int channelsExtraCount();
+
+// `index` is the channel number, from WAVEFORM_FIRST_EXTRA.
+bool channelsGet(int index, WaveformChannel &channel);
+
+// Validates the ranges; returns false and changes nothing if one is off.
+// Duty tops out at MAGNET_DUTY_MAX, as a channel may drive a coil.
+bool channelsSet(int index, const WaveformChannel &channel);
+
+// Copy all extra channels, for waveformPublishChannels().
+void channelsCopy(WaveformChannel *channels);
+
+#endif // CHANNELS_H
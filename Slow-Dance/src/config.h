@@ -4,8 +4,14 @@
 // ============================================
 // WiFi Configuration
 // ============================================
-const char* WIFI_SSID = "DUSHYANT-NEW";
-const char* WIFI_PASSWORD = "ahuja987";
+const char* const WIFI_SSID = "DUSHYANT-NEW";
+const char* const WIFI_PASSWORD = "ahuja987";
+#define WIFI_CONNECT_TIMEOUT_MS 10000  // one connection attempt
+#define WIFI_BACKOFF_MIN_MS 1000       // retry delay, doubles up to the max
+#define WIFI_BACKOFF_MAX_MS 60000
+#define WIFI_AP_FALLBACK_MS 30000      // station down this long opens the AP
+const char* const WIFI_AP_SSID = "SlowDance";
+const char* const WIFI_AP_PASSWORD = "slowdance";   // at least 8 characters
 
 // ============================================
 // GPIO Pin Configuration
@@ -14,6 +20,7 @@ const int LED_PIN = 27;
 const int MAGNET_PIN = 14;
 const int MAGNET2_PIN = 12;
 const int BUTTON_PIN = 26;
+const int SHUTTER_PIN = -1;   // camera frame / shutter trigger input, -1 = none
 
 // ============================================
 // Default PWM Settings
@@ -22,16 +29,141 @@ const int BUTTON_PIN = 26;
 #define DEFAULT_MAGNET_FREQ 79.8
 #define DEFAULT_LED_DUTY 50.0
 #define DEFAULT_MAGNET_DUTY 50.0
+#define DEFAULT_MAGNET2_DUTY 50.0
+#define DEFAULT_MAGNET2_PHASE 0.0     // degrees behind the first magnet
+
+// Accepted ranges (match the web UI input limits)
+#define FREQ_MIN 50.0
+#define FREQ_MAX 150.0
+#define LED_DUTY_MIN 1.0
+#define LED_DUTY_MAX 100.0
+#define MAGNET_DUTY_MIN 10.0
+#define MAGNET_DUTY_MAX 90.0
+#define MAGNET_PHASE_MIN 0.0
+#define MAGNET_PHASE_MAX 360.0
+
+// ============================================
+// Waveform Backend
+// ============================================
+#define WAVEFORM_BACKEND_ISR 0   // timer interrupts toggle the pins on every edge
+#define WAVEFORM_BACKEND_LEDC 1  // LEDC peripheral generates the waves in hardware
+
+#ifndef WAVEFORM_BACKEND
+#define WAVEFORM_BACKEND WAVEFORM_BACKEND_LEDC
+#endif
+
+// Lowest frequency the waveforms must reach
+#define WAVEFORM_MIN_FREQ FREQ_MIN
+
+// Shared timebase of the ISR backend's numerically controlled oscillators
+#define WAVEFORM_TIMEBASE_HZ 10000000UL
+
+// Magnet phase behind the LED when the outputs (re)start, in degrees
+#define WAVEFORM_START_PHASE_DEG 0.0
+
+// Channels the ISR backend schedules after the LED and the two magnets,
+// as {pin, leader}, e.g. the strobe and coil of a second object. Leader -1
+// gives a channel its own frequency; otherwise it runs at the leader's
+// frequency and rises `phase` degrees after it. Pin -1 schedules a channel
+// without an output, which is how the channel-count benchmark loads the
+// scheduler (scripts/bench_channels.py). Extra channels start disabled and
+// are set up through /api/channels. The LEDC backend ignores them.
+#define WAVEFORM_MAX_CHANNELS 8
+#ifndef WAVEFORM_EXTRA_CHANNELS
+#define WAVEFORM_EXTRA_CHANNELS {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}
+#endif
+
+// ============================================
+// Task Configuration
+// ============================================
+// Waveform timers and their interrupts live on one core, WiFi, the web
+// server, OTA and the settings store on the other (WiFi runs on core 0).
+#define WAVEFORM_CORE 1
+#define NETWORK_CORE 0
+#define WAVEFORM_TASK_PRIORITY 10
+#define NETWORK_TASK_PRIORITY 2
+#define COMMAND_QUEUE_LENGTH 8
+#define COMMAND_QUEUE_TIMEOUT_MS 10
+
+// ============================================
+// Magnet Thermal Budget
+// ============================================
+// Estimated, not measured: calibrate RISE and TAU against the real coils
+// (thermocouple on the winding, run at 100% duty until it settles).
+#define THERMAL_AMBIENT_C 25.0
+#define THERMAL_RISE_C 60.0        // steady-state rise above ambient at 100% duty
+#define THERMAL_TAU_S 300.0        // coil thermal time constant
+#define THERMAL_DERATE_C 70.0      // magnet duty is limited above this
+#define THERMAL_MAX_C 80.0         // magnets pause at this
+#define THERMAL_RESUME_C 65.0      // and resume below this
+#define THERMAL_MAGNET_WATTS 10.0  // both coils at 100% duty, for energy accounting
+#define THERMAL_STEP_MS 250
+
+// ============================================
+// Multi-Unit Sync
+// ============================================
+// One leader, any number of followers on the same network. Needs the ISR
+// backend and the same settings on every unit.
+#define SYNC_OFF 0
+#define SYNC_LEADER 1
+#define SYNC_FOLLOWER 2
+
+#ifndef SYNC_ROLE
+#define SYNC_ROLE SYNC_OFF
+#endif
+
+#define SYNC_PORT 4210
+#define SYNC_REQUEST_MS 50         // follower timing exchanges
+#define SYNC_PHASE_MS 1000         // leader edge broadcasts
+#define SYNC_TIMEOUT_MS 5000       // leader silent this long drops the lock
+#define SYNC_MAX_DELAY_US 20000    // slower exchanges are not used
+#define SYNC_DEADBAND_US 25        // smaller edge errors are left alone
+#define SYNC_TRIM_STEP_PPM 0.05    // smaller rate changes are not republished
+
+// ============================================
+// Camera Shutter Lock
+// ============================================
+// Trigger on SHUTTER_PIN (rising edge, 3.3 V, pulled up) locks the LED to
+// a whole multiple of the frame rate; see shutter.h.
+#define SHUTTER_MIN_HZ 10.0
+#define SHUTTER_MAX_HZ 150.0
+#define SHUTTER_PHASE_DEG 0.0     // LED rise after the trigger, of an LED period
+#define SHUTTER_STEP_MS 100
+#define SHUTTER_TIMEOUT_MS 500    // no trigger this long releases the lock
+#define SHUTTER_GAIN 2.0          // Hz of pull per cycle of phase error
+#define SHUTTER_INTEGRAL 0.5      // Hz per cycle-second of phase error
+#define SHUTTER_PULL_HZ 0.5       // largest pull away from the trigger multiple
+#define SHUTTER_LOCK_DEG 5.0      // reported locked within this
+#define SHUTTER_LOCK_STEPS 10     // for this many steps in a row
 
 // ============================================
 // Button Configuration
 // ============================================
 const unsigned long DEBOUNCE_DELAY = 300;  // milliseconds
+const unsigned long BUTTON_LONG_PRESS_MS = 800;  // hold to step to the next preset
+
+// ============================================
+// Web Interface Configuration
+// ============================================
+#define EVENTS_METRICS_INTERVAL_MS 2000  // max rate of metrics pushes
+#define SETTINGS_JSON_SIZE 256           // response buffers, no heap on the request path
+#define METRICS_JSON_SIZE 2048
+#define SUMMARY_JSON_SIZE 192
+#define PRESETS_JSON_SIZE 1536
+#define CHANNELS_JSON_SIZE 1024
+#define SYNC_JSON_SIZE 320
+#define SHUTTER_JSON_SIZE 192
 
 // ============================================
 // Debug Configuration
 // ============================================
 #define DEBUG  // Comment out to disable debug output
+#define EDGE_PROFILER  // Comment out to stop timestamping edges for /api/metrics
+#define MAGNET_SELF_TEST  // Comment out to skip pulsing the magnets at boot
+// #define OTA_TEST  // Uncomment for /api/otatest (rewrites the idle OTA slot)
+#define OTA_TEST_SECTOR_MS 20   // one 4 KB sector per step, about an upload's pace
+#define SELF_TEST_ON_MS 1000
+#define SELF_TEST_OFF_MS 500
 
 #ifndef DEBUG_PRINT
 #ifdef DEBUG
@@ -41,187 +173,4 @@ const unsigned long DEBOUNCE_DELAY = 300;  // milliseconds
 #endif
 #endif
 
-// ============================================
-// Web Interface HTML
-// ============================================
-const char HTML_PAGE[] PROGMEM = R"(
-<!DOCTYPE html>
-<html>
-<head>
-  <meta charset='UTF-8'>
-  <meta name='viewport' content='width=device-width, initial-scale=1'>
-  <title>Slow Motion Controller</title>
-  <style>
-    body {
-      font-family: Arial, sans-serif;
-      max-width: 600px;
-      margin: 20px auto;
-      padding: 20px;
-      background: #1a1a2e;
-      color: #eee;
-    }
-    h1 { text-align: center; color: #00d4ff; }
-    .section {
-      background: #16213e;
-      padding: 20px;
-      margin: 15px 0;
-      border-radius: 8px;
-      border: 1px solid #00d4ff;
-    }
-    .section h2 { margin-top: 0; color: #00d4ff; font-size: 1.2em; }
-    label {
-      display: block;
-      margin: 10px 0 5px;
-      font-weight: bold;
-    }
-    input[type='number'] {
-      width: 100%;
-      padding: 10px;
-      background: #0f3460;
-      border: 1px solid #00d4ff;
-      border-radius: 5px;
-      color: #eee;
-      font-size: 16px;
-      box-sizing: border-box;
-    }
-    .value-display {
-      display: inline-block;
-      float: right;
-      color: #00d4ff;
-      font-weight: bold;
-    }
-    button {
-      width: 100%;
-      padding: 15px;
-      margin: 10px 0;
-      font-size: 16px;
-      border: none;
-      border-radius: 5px;
-      cursor: pointer;
-      font-weight: bold;
-      transition: all 0.3s;
-    }
-    .btn-save { background: #00d4ff; color: #000; }
-    .btn-reset { background: #e74c3c; color: #fff; }
-    .btn-ota { background: #f39c12; color: #000; }
-    button:hover { opacity: 0.8; transform: scale(1.02); }
-    .status {
-      text-align: center;
-      padding: 10px;
-      margin: 20px 0;
-      background: #0f3460;
-      border-radius: 5px;
-      font-weight: bold;
-    }
-    .info { font-size: 0.9em; color: #aaa; margin-top: 5px; }
-  </style>
-</head>
-<body>
-  <h1>Slow Motion Controller</h1>
-  
-  <div class='status' id='status'>Loading...</div>
-  
-  <div class='section'>
-    <h2>LED Strip</h2>
-    <label>Frequency (Hz): <span class='value-display' id='ledFreqVal'>0</span></label>
-    <input type='number' id='ledFreq' min='50' max='150' step='0.1' value='80.5'>
-    <div class='info'>Recommended: 70-90 Hz</div>
-    
-    <label>Brightness (%): <span class='value-display' id='ledDutyVal'>0</span></label>
-    <input type='number' id='ledDuty' min='1' max='100' step='1' value='50'>
-    <div class='info'>Recommended: 30-70%</div>
-  </div>
-  
-  <div class='section'>
-    <h2>Electromagnets</h2>
-    <label>Frequency (Hz): <span class='value-display' id='magFreqVal'>0</span></label>
-    <input type='number' id='magFreq' min='50' max='150' step='0.1' value='79.8'>
-    <div class='info'>Recommended: 70-90 Hz</div>
-    
-    <label>Duty Cycle (%): <span class='value-display' id='magDutyVal'>0</span></label>
-    <input type='number' id='magDuty' min='10' max='90' step='1' value='50'>
-    <div class='info'>Recommended: 40-60%</div>
-  </div>
-  
-  <button class='btn-save' onclick='saveSettings()'>Save Settings</button>
-  <button class='btn-reset' onclick='resetDefaults()'>Reset to Defaults</button>
-  <button class='btn-ota' onclick='location.href="/update"'>OTA Update</button>
-
-  <script>
-    let autoRefresh = true;
-    let userIsEditing = false;
-    
-    function updateDisplays() {
-      document.getElementById('ledFreqVal').textContent = document.getElementById('ledFreq').value;
-      document.getElementById('ledDutyVal').textContent = document.getElementById('ledDuty').value;
-      document.getElementById('magFreqVal').textContent = document.getElementById('magFreq').value;
-      document.getElementById('magDutyVal').textContent = document.getElementById('magDuty').value;
-    }
-    
-    ['ledFreq', 'ledDuty', 'magFreq', 'magDuty'].forEach(id => {
-      const elem = document.getElementById(id);
-      elem.oninput = () => {
-        updateDisplays();
-        userIsEditing = true;
-        setTimeout(() => { userIsEditing = false; }, 5000);
-      };
-    });
-    
-    function loadSettings() {
-      if (userIsEditing) return;
-      
-      fetch('/api/settings')
-        .then(r => r.json())
-        .then(data => {
-          document.getElementById('ledFreq').value = data.ledFreq;
-          document.getElementById('ledDuty').value = data.ledDuty;
-          document.getElementById('magFreq').value = data.magFreq;
-          document.getElementById('magDuty').value = data.magDuty;
-          updateDisplays();
-          document.getElementById('status').textContent = 'Status: ' + (data.enabled ? 'ENABLED' : 'DISABLED');
-        });
-    }
-    
-    function saveSettings() {
-      const data = {
-        ledFreq: parseFloat(document.getElementById('ledFreq').value),
-        ledDuty: parseFloat(document.getElementById('ledDuty').value),
-        magFreq: parseFloat(document.getElementById('magFreq').value),
-        magDuty: parseFloat(document.getElementById('magDuty').value)
-      };
-      
-      fetch('/api/settings', {
-        method: 'POST',
-        headers: {'Content-Type': 'application/json'},
-        body: JSON.stringify(data)
-      })
-      .then(r => r.text())
-      .then(msg => {
-        userIsEditing = false;
-        loadSettings();
-        document.getElementById('status').textContent = 'Settings Saved!';
-        setTimeout(() => { loadSettings(); }, 1000);
-      });
-    }
-    
-    function resetDefaults() {
-      if (confirm('Reset to default settings?')) {
-        fetch('/api/reset', {method: 'POST'})
-          .then(r => r.text())
-          .then(msg => {
-            userIsEditing = false;
-            loadSettings();
-            document.getElementById('status').textContent = 'Reset to Defaults!';
-            setTimeout(() => { loadSettings(); }, 1000);
-          });
-      }
-    }
-    
-    loadSettings();
-    setInterval(loadSettings, 3000);
-  </script>
-</body>
-</html>
-)";
-
 #endif // CONFIG_H
\ No newline at end of file
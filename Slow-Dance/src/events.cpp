@@ -0,0 +1,75 @@
+#include "events.h"
+
+static WiFiClient clients[EVENTS_MAX_CLIENTS];
+static unsigned long lastWriteMs[EVENTS_MAX_CLIENTS];
+
+static bool writeClient(int i, const char *text) {
+  WiFiClient &client = clients[i];
+  size_t len = strlen(text);
+  if (!client.connected() || client.write((const uint8_t *)text, len) != len) {
+    client.stop();
+    return false;
+  }
+  lastWriteMs[i] = millis();
+  return true;
+}
+
+int eventsAddClient(WiFiClient client) {
+  int slot = -1;
+  for (int i = 0; i < EVENTS_MAX_CLIENTS; i++) {
+    if (!clients[i].connected()) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot < 0) return -1;
+
+  clients[slot] = client;
+  char header[192];
+  snprintf(header, sizeof(header),
+           "HTTP/1.1 200 OK\r\n"
+           "Content-Type: text/event-stream\r\n"
+           "Cache-Control: no-cache\r\n"
+           "Connection: keep-alive\r\n"
+           "\r\n"
+           "retry: %d\n\n", EVENTS_RETRY_MS);
+  return writeClient(slot, header) ? slot : -1;
+}
+
+// Frame an event into a shared buffer; only the network task sends events
+static const char *formatEvent(const char *event, const char *data) {
+  static char message[EVENTS_MAX_MESSAGE];
+  int len = snprintf(message, sizeof(message), "event: %s\ndata: %s\n\n", event, data);
+  return len > 0 && len < (int)sizeof(message) ? message : NULL;
+}
+
+bool eventsSend(int slot, const char *event, const char *data) {
+  if (slot < 0 || slot >= EVENTS_MAX_CLIENTS || !clients[slot].connected()) return false;
+  const char *message = formatEvent(event, data);
+  return message && writeClient(slot, message);
+}
+
+void eventsBroadcast(const char *event, const char *data) {
+  const char *message = formatEvent(event, data);
+  if (!message) return;
+  for (int i = 0; i < EVENTS_MAX_CLIENTS; i++) {
+    if (clients[i].connected()) writeClient(i, message);
+  }
+}
+
+void eventsKeepAlive() {
+  unsigned long now = millis();
+  for (int i = 0; i < EVENTS_MAX_CLIENTS; i++) {
+    if (clients[i].connected() && now - lastWriteMs[i] >= EVENTS_KEEPALIVE_MS) {
+      writeClient(i, ":\n\n");
+    }
+  }
+}
+
+int eventsClientCount() {
+  int count = 0;
+  for (int i = 0; i < EVENTS_MAX_CLIENTS; i++) {
+    if (clients[i].connected()) count++;
+  }
+  return count;
+}
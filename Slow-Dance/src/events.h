@@ -0,0 +1,34 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// ============================================
+// Server-Sent Events
+// ============================================
+// Browsers open one long-lived GET /api/events connection and receive
+// state changes as they happen instead of polling. Connections are kept
+// in a small fixed table and serviced from the network task.
+
+#define EVENTS_MAX_CLIENTS 4
+#define EVENTS_KEEPALIVE_MS 15000
+#define EVENTS_RETRY_MS 3000
+#define EVENTS_MAX_MESSAGE 512   // framed event, longer data is dropped
+
+// Take over the connection of the request being handled. Writes the
+// event-stream headers; the web server must not send a response itself.
+// Returns the client slot, or -1 if the table is full.
+int eventsAddClient(WiFiClient client);
+
+// Send one event to a single client / to every connected client. Dead
+// connections are dropped.
+bool eventsSend(int slot, const char *event, const char *data);
+void eventsBroadcast(const char *event, const char *data);
+
+// Send a comment line to idle connections so dropped clients are noticed.
+void eventsKeepAlive();
+
+int eventsClientCount();
+
+#endif // EVENTS_H
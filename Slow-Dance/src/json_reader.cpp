@@ -0,0 +1,402 @@
+#include "json_reader.h"
+
+#include <math.h>
+#include <string.h>
+
+// What the next significant character may be
+enum JsonState : uint8_t {
+  STATE_VALUE,           // start of document, after ':' or ',' in an array
+  STATE_VALUE_OR_END,    // after '['
+  STATE_KEY,             // after ',' in an object
+  STATE_KEY_OR_END,      // after '{'
+  STATE_COMMA_OR_END,    // after a value inside a container
+  STATE_DONE             // top-level value complete
+};
+
+static JsonToken fail(JsonReader &r, size_t pos, const char *message) {
+  if (r.token != JSON_ERROR) {
+    r.error = message;
+    r.errorPos = pos;
+    r.token = JSON_ERROR;
+  }
+  return JSON_ERROR;
+}
+
+static void afterValue(JsonReader &r) {
+  r.state = r.depth == 0 ? STATE_DONE : STATE_COMMA_OR_END;
+}
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static void skipSpace(JsonReader &r) {
+  while (r.pos < r.len && isSpace(r.buf[r.pos])) r.pos++;
+}
+
+// Scan a string starting at the opening quote. Escapes are validated but
+// left in place; jsonCopyString() decodes them.
+static bool scanString(JsonReader &r) {
+  size_t start = ++r.pos;
+  while (r.pos < r.len) {
+    char c = r.buf[r.pos];
+    if (c == '"') {
+      r.str = r.buf + start;
+      r.strLen = r.pos - start;
+      r.pos++;
+      return true;
+    }
+    if ((unsigned char)c < 0x20) {
+      fail(r, r.pos, "control character in string");
+      return false;
+    }
+    if (c == '\\') {
+      if (++r.pos >= r.len) break;
+      c = r.buf[r.pos];
+      if (c == 'u') {
+        if (r.pos + 4 >= r.len) break;
+        for (int i = 1; i <= 4; i++) {
+          if (hexValue(r.buf[r.pos + i]) < 0) {
+            fail(r, r.pos + i, "invalid \\u escape");
+            return false;
+          }
+        }
+        r.pos += 4;
+      } else if (!strchr("\"\\/bfnrt", c) || c == '\0') {
+        fail(r, r.pos, "invalid escape");
+        return false;
+      }
+    }
+    r.pos++;
+  }
+  fail(r, r.len, "unterminated string");
+  return false;
+}
+
+// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+// Up to 19 significant digits are kept exactly; the decimal exponent is
+// applied with one multiply or divide so short decimals such as 80.5
+// convert without rounding error.
+static bool scanNumber(JsonReader &r) {
+  const char *p = r.buf;
+  size_t i = r.pos;
+  bool negative = false;
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+
+  if (p[i] == '-') {
+    negative = true;
+    i++;
+  }
+  if (i >= r.len || !isDigit(p[i])) {
+    fail(r, i, "expected digit");
+    return false;
+  }
+  if (p[i] == '0') {
+    i++;
+  } else {
+    while (i < r.len && isDigit(p[i])) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (p[i] - '0');
+        digits++;
+      } else {
+        exponent++;
+      }
+      i++;
+    }
+  }
+
+  if (i < r.len && p[i] == '.') {
+    i++;
+    if (i >= r.len || !isDigit(p[i])) {
+      fail(r, i, "expected digit after '.'");
+      return false;
+    }
+    while (i < r.len && isDigit(p[i])) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (p[i] - '0');
+        if (mantissa != 0) digits++;
+        exponent--;
+      }
+      i++;
+    }
+  }
+
+  if (i < r.len && (p[i] == 'e' || p[i] == 'E')) {
+    i++;
+    bool expNegative = false;
+    if (i < r.len && (p[i] == '+' || p[i] == '-')) {
+      expNegative = p[i] == '-';
+      i++;
+    }
+    if (i >= r.len || !isDigit(p[i])) {
+      fail(r, i, "expected digit in exponent");
+      return false;
+    }
+    int e = 0;
+    while (i < r.len && isDigit(p[i])) {
+      if (e < 10000) e = e * 10 + (p[i] - '0');
+      i++;
+    }
+    exponent += expNegative ? -e : e;
+  }
+
+  double value = (double)mantissa;
+  if (mantissa != 0) {
+    if (exponent > 308 || exponent < -340) {
+      fail(r, r.pos, "number out of range");
+      return false;
+    }
+    double scale = 1.0;
+    for (int e = exponent < 0 ? -exponent : exponent; e > 0; e--) scale *= 10.0;
+    value = exponent < 0 ? value / scale : value * scale;
+    if (isinf(value)) {   // long mantissa near the top of the range
+      fail(r, r.pos, "number out of range");
+      return false;
+    }
+  }
+  r.number = negative ? -value : value;
+  r.pos = i;
+  return true;
+}
+
+static bool scanLiteral(JsonReader &r, const char *literal) {
+  size_t n = strlen(literal);
+  if (r.len - r.pos < n || memcmp(r.buf + r.pos, literal, n) != 0) {
+    fail(r, r.pos, "invalid literal");
+    return false;
+  }
+  r.pos += n;
+  return true;
+}
+
+static JsonToken push(JsonReader &r, char bracket, JsonState state, JsonToken token) {
+  if (r.depth >= JSON_MAX_DEPTH) return fail(r, r.pos, "nesting too deep");
+  r.stack[r.depth++] = bracket;
+  r.state = state;
+  r.pos++;
+  return r.token = token;
+}
+
+static JsonToken pop(JsonReader &r, JsonToken token) {
+  r.depth--;
+  r.pos++;
+  afterValue(r);
+  return r.token = token;
+}
+
+static JsonToken readValue(JsonReader &r) {
+  char c = r.buf[r.pos];
+  switch (c) {
+    case '{':
+      return push(r, '{', STATE_KEY_OR_END, JSON_OBJECT_BEGIN);
+    case '[':
+      return push(r, '[', STATE_VALUE_OR_END, JSON_ARRAY_BEGIN);
+    case '"':
+      if (!scanString(r)) return JSON_ERROR;
+      afterValue(r);
+      return r.token = JSON_STRING;
+    case 't':
+      if (!scanLiteral(r, "true")) return JSON_ERROR;
+      afterValue(r);
+      return r.token = JSON_TRUE;
+    case 'f':
+      if (!scanLiteral(r, "false")) return JSON_ERROR;
+      afterValue(r);
+      return r.token = JSON_FALSE;
+    case 'n':
+      if (!scanLiteral(r, "null")) return JSON_ERROR;
+      afterValue(r);
+      return r.token = JSON_NULL;
+    default:
+      if (c != '-' && !isDigit(c)) return fail(r, r.pos, "expected value");
+      if (!scanNumber(r)) return JSON_ERROR;
+      afterValue(r);
+      return r.token = JSON_NUMBER;
+  }
+}
+
+static JsonToken readKey(JsonReader &r) {
+  if (r.buf[r.pos] != '"') return fail(r, r.pos, "expected key");
+  if (!scanString(r)) return JSON_ERROR;
+  skipSpace(r);
+  if (r.pos >= r.len || r.buf[r.pos] != ':') return fail(r, r.pos, "expected ':'");
+  r.pos++;
+  r.state = STATE_VALUE;
+  return r.token = JSON_KEY;
+}
+
+void jsonBegin(JsonReader &r, const char *buf, size_t len) {
+  memset(&r, 0, sizeof(r));
+  r.buf = buf;
+  r.len = len;
+  r.token = JSON_END;
+  r.state = STATE_VALUE;
+}
+
+JsonToken jsonNext(JsonReader &r) {
+  if (r.token == JSON_ERROR) return JSON_ERROR;
+
+  for (;;) {
+    skipSpace(r);
+    r.tokenPos = r.pos;
+    if (r.pos >= r.len) {
+      if (r.state == STATE_DONE) return r.token = JSON_END;
+      return fail(r, r.pos, "unexpected end of input");
+    }
+
+    char c = r.buf[r.pos];
+    char open = r.depth ? r.stack[r.depth - 1] : 0;
+    switch (r.state) {
+      case STATE_DONE:
+        return fail(r, r.pos, "unexpected data after document");
+
+      case STATE_COMMA_OR_END:
+        if (c == ',') {
+          r.pos++;
+          r.state = open == '{' ? STATE_KEY : STATE_VALUE;
+          continue;
+        }
+        if (c == '}' && open == '{') return pop(r, JSON_OBJECT_END);
+        if (c == ']' && open == '[') return pop(r, JSON_ARRAY_END);
+        return fail(r, r.pos, open == '{' ? "expected ',' or '}'" : "expected ',' or ']'");
+
+      case STATE_KEY_OR_END:
+        if (c == '}') return pop(r, JSON_OBJECT_END);
+        return readKey(r);
+
+      case STATE_KEY:
+        return readKey(r);
+
+      case STATE_VALUE_OR_END:
+        if (c == ']') return pop(r, JSON_ARRAY_END);
+        return readValue(r);
+
+      default:
+        return readValue(r);
+    }
+  }
+}
+
+JsonToken jsonFail(JsonReader &r, const char *message) {
+  return fail(r, r.tokenPos, message);
+}
+
+bool jsonStringIs(const JsonReader &r, const char *literal) {
+  return strlen(literal) == r.strLen && memcmp(r.str, literal, r.strLen) == 0;
+}
+
+bool jsonCopyString(const JsonReader &r, char *dst, size_t size) {
+  if (size == 0) return false;
+  size_t n = 0;
+  for (size_t i = 0; i < r.strLen; i++) {
+    char c = r.str[i];
+    if (c == '\\') {
+      c = r.str[++i];
+      switch (c) {
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'n': c = '\n'; break;
+        case 'r': c = '\r'; break;
+        case 't': c = '\t'; break;
+        case 'u': {
+          int code = 0;
+          for (int k = 1; k <= 4; k++) code = code * 16 + hexValue(r.str[i + k]);
+          i += 4;
+          c = code < 0x80 ? (char)code : '?';   // names are ASCII
+          break;
+        }
+        default: break;                         // \" \\ \/
+      }
+    }
+    if (n + 1 >= size) {
+      dst[n] = '\0';
+      return false;
+    }
+    dst[n++] = c;
+  }
+  dst[n] = '\0';
+  return true;
+}
+
+bool jsonSkipValue(JsonReader &r) {
+  if (r.token != JSON_OBJECT_BEGIN && r.token != JSON_ARRAY_BEGIN) {
+    return r.token != JSON_ERROR;
+  }
+  uint8_t depth = r.depth;
+  while (r.depth >= depth) {
+    if (jsonNext(r) == JSON_ERROR) return false;
+  }
+  return true;
+}
+
+// ============================================
+// Flat objects of numbers
+// ============================================
+
+int32_t jsonParseFloatFields(const char *buf, size_t len,
+                             const JsonFloatField *fields, int count,
+                             JsonParseError &err) {
+  float values[31];
+  uint32_t present = 0;
+  err.message = NULL;
+  err.offset = 0;
+  err.field = NULL;
+  if (count > 31) count = 31;
+
+  JsonReader r;
+  jsonBegin(r, buf, len);
+
+  if (jsonNext(r) != JSON_OBJECT_BEGIN) {
+    if (r.token != JSON_ERROR) jsonFail(r, "expected object");
+  } else {
+    while (jsonNext(r) == JSON_KEY) {
+      int i = 0;
+      while (i < count && !jsonStringIs(r, fields[i].name)) i++;
+      if (i == count) {
+        jsonFail(r, "unknown key");
+        break;
+      }
+      err.field = &fields[i];
+      if (present & (1UL << i)) {
+        jsonFail(r, "duplicate key");
+        break;
+      }
+      if (jsonNext(r) != JSON_NUMBER) {
+        if (r.token != JSON_ERROR) jsonFail(r, "expected number");
+        break;
+      }
+      if (!(r.number >= fields[i].min && r.number <= fields[i].max)) {
+        jsonFail(r, "out of range");
+        break;
+      }
+      values[i] = (float)r.number;
+      present |= 1UL << i;
+      err.field = NULL;
+    }
+    if (r.token == JSON_OBJECT_END) jsonNext(r);   // must be JSON_END
+  }
+
+  if (r.token != JSON_END) {
+    err.message = r.error ? r.error : "malformed document";
+    err.offset = r.errorPos;
+    return -1;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (present & (1UL << i)) *fields[i].target = values[i];
+  }
+  return (int32_t)present;
+}
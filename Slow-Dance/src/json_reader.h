@@ -0,0 +1,101 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================
+// JSON Pull Reader
+// ============================================
+// Single-pass tokenizer over a caller-owned buffer. It never allocates:
+// keys and strings are returned as slices into the buffer, and numbers
+// are converted without strtod() (which allocates in newlib). The full
+// JSON grammar is validated as tokens are pulled. Any violation stops
+// the reader with a message and the byte offset it was found at.
+
+#define JSON_MAX_DEPTH 8
+
+enum JsonToken {
+  JSON_OBJECT_BEGIN,
+  JSON_OBJECT_END,
+  JSON_ARRAY_BEGIN,
+  JSON_ARRAY_END,
+  JSON_KEY,
+  JSON_STRING,
+  JSON_NUMBER,
+  JSON_TRUE,
+  JSON_FALSE,
+  JSON_NULL,
+  JSON_END,      // complete document consumed
+  JSON_ERROR
+};
+
+struct JsonReader {
+  const char *buf;
+  size_t len;
+  size_t pos;
+
+  // Current token
+  JsonToken token;
+  size_t tokenPos;
+  const char *str;     // JSON_KEY / JSON_STRING, raw (escapes not decoded)
+  size_t strLen;
+  double number;       // JSON_NUMBER
+
+  // First error, if any
+  const char *error;
+  size_t errorPos;
+
+  // Parser state
+  uint8_t state;
+  uint8_t depth;
+  char stack[JSON_MAX_DEPTH];
+};
+
+void jsonBegin(JsonReader &r, const char *buf, size_t len);
+
+// Advance to the next token. Returns JSON_ERROR forever after an error.
+JsonToken jsonNext(JsonReader &r);
+
+// Stop the reader with a caller-detected (semantic) error at the current token.
+JsonToken jsonFail(JsonReader &r, const char *message);
+
+// Compare the current key / string with a NUL-terminated literal.
+bool jsonStringIs(const JsonReader &r, const char *literal);
+
+// Decode the current string into dst (always NUL-terminated). Returns
+// false if it did not fit.
+bool jsonCopyString(const JsonReader &r, char *dst, size_t size);
+
+// Skip the value that starts with the current token, including nested
+// objects and arrays.
+bool jsonSkipValue(JsonReader &r);
+
+// ============================================
+// Flat objects of numbers
+// ============================================
+// Parses {"name": number, ...} into a table of range-checked fields.
+// Targets are only written once the whole document has been accepted;
+// unknown keys, duplicates, non-numbers and out-of-range values are
+// rejected.
+
+struct JsonFloatField {
+  const char *name;
+  float *target;
+  float min;
+  float max;
+};
+
+struct JsonParseError {
+  const char *message;
+  size_t offset;
+  const JsonFloatField *field;   // offending field, or NULL
+};
+
+// Returns a bit mask of the fields present (bit i = fields[i]), or -1 on
+// error. At most 31 fields.
+int32_t jsonParseFloatFields(const char *buf, size_t len,
+                             const JsonFloatField *fields, int count,
+                             JsonParseError &err);
+
+#endif // JSON_READER_H
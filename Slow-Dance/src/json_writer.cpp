@@ -0,0 +1,146 @@
+#include "json_writer.h"
+
+#include <math.h>
+#include <string.h>
+
+static void put(JsonWriter &w, const char *text, size_t n) {
+  if (w.overflow) return;
+  if (w.len + n >= w.size) {
+    n = w.size - 1 - w.len;
+    w.overflow = true;
+  }
+  memcpy(w.buf + w.len, text, n);
+  w.len += n;
+  w.buf[w.len] = '\0';
+}
+
+static void putChar(JsonWriter &w, char c) {
+  put(w, &c, 1);
+}
+
+static void putText(JsonWriter &w, const char *text) {
+  put(w, text, strlen(text));
+}
+
+static void putUInt(JsonWriter &w, uint64_t value) {
+  char digits[20];
+  int n = 0;
+  do {
+    digits[sizeof(digits) - 1 - n++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  put(w, digits + sizeof(digits) - n, n);
+}
+
+static void putQuoted(JsonWriter &w, const char *text) {
+  putChar(w, '"');
+  for (const char *p = text; *p; p++) {
+    char c = *p;
+    if (c == '"' || c == '\\') {
+      putChar(w, '\\');
+      putChar(w, c);
+    } else if ((unsigned char)c < 0x20) {
+      static const char hex[] = "0123456789abcdef";
+      char escape[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+      put(w, escape, sizeof(escape));
+    } else {
+      putChar(w, c);
+    }
+  }
+  putChar(w, '"');
+}
+
+// Comma and key in front of every value
+static void member(JsonWriter &w, const char *key) {
+  if (!w.first) putChar(w, ',');
+  w.first = false;
+  if (key) {
+    putQuoted(w, key);
+    putChar(w, ':');
+  }
+}
+
+void jsonWriterBegin(JsonWriter &w, char *buf, size_t size) {
+  w.buf = buf;
+  w.size = size;
+  w.len = 0;
+  w.overflow = size == 0;
+  w.first = true;
+  if (size) buf[0] = '\0';
+}
+
+void jsonBeginObject(JsonWriter &w, const char *key) {
+  member(w, key);
+  putChar(w, '{');
+  w.first = true;
+}
+
+void jsonEndObject(JsonWriter &w) {
+  putChar(w, '}');
+  w.first = false;
+}
+
+void jsonBeginArray(JsonWriter &w, const char *key) {
+  member(w, key);
+  putChar(w, '[');
+  w.first = true;
+}
+
+void jsonEndArray(JsonWriter &w) {
+  putChar(w, ']');
+  w.first = false;
+}
+
+void jsonAddFloat(JsonWriter &w, const char *key, double value, uint8_t decimals) {
+  member(w, key);
+  if (decimals > 9) decimals = 9;
+  uint64_t scale = 1;
+  for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+
+  // JSON has no NaN/Infinity; anything that does not fit is null
+  double scaled = fabs(value) * scale + 0.5;
+  if (!(scaled < 1.8e19)) {
+    putText(w, "null");
+    return;
+  }
+  uint64_t fixed = (uint64_t)scaled;
+  if (value < 0 && fixed) putChar(w, '-');
+  putUInt(w, fixed / scale);
+  if (decimals) {
+    char frac[9];
+    uint64_t rest = fixed % scale;
+    for (int i = decimals - 1; i >= 0; i--) {
+      frac[i] = '0' + rest % 10;
+      rest /= 10;
+    }
+    putChar(w, '.');
+    put(w, frac, decimals);
+  }
+}
+
+void jsonAddInt(JsonWriter &w, const char *key, int32_t value) {
+  member(w, key);
+  if (value < 0) putChar(w, '-');
+  putUInt(w, value < 0 ? -(int64_t)value : value);
+}
+
+void jsonAddUInt(JsonWriter &w, const char *key, uint32_t value) {
+  member(w, key);
+  putUInt(w, value);
+}
+
+void jsonAddBool(JsonWriter &w, const char *key, bool value) {
+  member(w, key);
+  putText(w, value ? "true" : "false");
+}
+
+void jsonAddString(JsonWriter &w, const char *key, const char *value) {
+  member(w, key);
+  putQuoted(w, value);
+}
+
+void jsonAddUIntArray(JsonWriter &w, const char *key, const uint32_t *values, int count) {
+  jsonBeginArray(w, key);
+  for (int i = 0; i < count; i++) jsonAddUInt(w, NULL, values[i]);
+  jsonEndArray(w);
+}
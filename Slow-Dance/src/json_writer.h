@@ -0,0 +1,39 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================
+// JSON Writer
+// ============================================
+// Serializes into a caller-owned buffer; nothing is allocated. Numbers
+// are formatted in fixed point without printf, so newlib's float
+// conversion (and its Bigint allocations) is never reached. If the
+// buffer fills up the output is truncated and `overflow` is set.
+//
+// A NULL key adds an array element instead of an object member.
+
+struct JsonWriter {
+  char *buf;
+  size_t size;
+  size_t len;
+  bool overflow;
+  bool first;      // no comma needed before the next value
+};
+
+void jsonWriterBegin(JsonWriter &w, char *buf, size_t size);
+
+void jsonBeginObject(JsonWriter &w, const char *key = NULL);
+void jsonEndObject(JsonWriter &w);
+void jsonBeginArray(JsonWriter &w, const char *key = NULL);
+void jsonEndArray(JsonWriter &w);
+
+void jsonAddFloat(JsonWriter &w, const char *key, double value, uint8_t decimals);
+void jsonAddInt(JsonWriter &w, const char *key, int32_t value);
+void jsonAddUInt(JsonWriter &w, const char *key, uint32_t value);
+void jsonAddBool(JsonWriter &w, const char *key, bool value);
+void jsonAddString(JsonWriter &w, const char *key, const char *value);
+void jsonAddUIntArray(JsonWriter &w, const char *key, const uint32_t *values, int count);
+
+#endif // JSON_WRITER_H
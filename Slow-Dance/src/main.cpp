@@ -2,68 +2,65 @@
 #include <WiFi.h>
 #include <WebServer.h>
 #include <ElegantOTA.h>
-#include <Preferences.h>
 #include "config.h"
+#include "web_assets.h"
+#include "waveform.h"
+#include "profiler.h"
+#include "events.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "settings_store.h"
+#include "presets.h"
+#include "timeline.h"
+#include "wifi_manager.h"
+#include "thermal.h"
+#include "channels.h"
+#include "sync.h"
+#include "shutter.h"
+#include "ota_test.h"
 
-// Settings (will be loaded from preferences)
+// Settings (will be loaded from flash)
 float LED_FREQ = DEFAULT_LED_FREQ;
 float MAGNET_FREQ = DEFAULT_MAGNET_FREQ;
 float LED_DUTY = DEFAULT_LED_DUTY;
 float MAGNET_DUTY = DEFAULT_MAGNET_DUTY;
+float MAGNET2_DUTY = DEFAULT_MAGNET2_DUTY;
+float MAGNET2_PHASE = DEFAULT_MAGNET2_PHASE;
 
-// Timer handles
-hw_timer_t *ledTimer = NULL;
-hw_timer_t *magnetTimer = NULL;
-
-// State variables
-volatile bool ledState = false;
-volatile bool magnetState = false;
-volatile uint32_t ledHighUs = 0;
-volatile uint32_t ledLowUs = 0;
-volatile uint32_t magnetHighUs = 0;
-volatile uint32_t magnetLowUs = 0;
+// State variables (owned by the network task)
 volatile bool deviceEnabled = true;
 volatile bool buttonPressed = false;
 volatile unsigned long lastButtonTime = 0;
+uint32_t stateVersion = 1;   // bumped on every settings / enable change
+int activePreset = -1;       // preset matching the live settings, or -1
 
-// Web server and preferences
+// Web server
 WebServer server(80);
-Preferences preferences;
 
-// Function prototypes
-void updateLEDTimer();
-void updateMagnetTimer();
-void saveSettings();
-void loadSettings();
+// Commands from the network task to the waveform task
+enum WaveformCommandType {
+  CMD_PUBLISH,         // also ends timeline playback
+  CMD_START,
+  CMD_STOP,
+  CMD_TIMELINE_PLAY,   // play the staged timeline from `settings`
+  CMD_OVERRIDE_MAGNETS,// hold the magnets at `level` (or release them)
+  CMD_CHANNELS,        // publish the extra channel table
+  CMD_SYNC_TRIM        // run the timebase `ppm` faster to match the sync leader
+};
 
-void IRAM_ATTR onLedTimer() {
-  if (!deviceEnabled) return;
-  
-  ledState = !ledState;
-  digitalWrite(LED_PIN, ledState);
-  
-  timerRestart(ledTimer);
-  if (ledState) {
-    timerAlarm(ledTimer, ledHighUs, false, 0);
-  } else {
-    timerAlarm(ledTimer, ledLowUs, false, 0);
-  }
-}
+struct WaveformCommand {
+  WaveformCommandType type;
+  WaveformSettings settings;
+  int level;
+  double ppm;
+};
 
-void IRAM_ATTR onMagnetTimer() {
-  if (!deviceEnabled) return;
-  
-  magnetState = !magnetState;
-  digitalWrite(MAGNET_PIN, magnetState);
-  digitalWrite(MAGNET2_PIN, magnetState);
-  
-  timerRestart(magnetTimer);
-  if (magnetState) {
-    timerAlarm(magnetTimer, magnetHighUs, false, 0);
-  } else {
-    timerAlarm(magnetTimer, magnetLowUs, false, 0);
-  }
-}
+QueueHandle_t commandQueue = NULL;
+
+// Function prototypes
+void loadSettings();
+void waveformTask(void *arg);
+void networkTask(void *arg);
 
 void IRAM_ATTR onButtonPress() {
   unsigned long currentTime = millis();
@@ -73,124 +70,927 @@ void IRAM_ATTR onButtonPress() {
   }
 }
 
-void updateLEDTimer() {
-  float ledPeriodUs = 1000000.0f / LED_FREQ;
-  ledHighUs = (uint32_t)(ledPeriodUs * (LED_DUTY / 100.0f));
-  ledLowUs = (uint32_t)(ledPeriodUs * (1.0f - LED_DUTY / 100.0f));
-  
-  if (ledTimer != NULL && deviceEnabled) {
-    timerRestart(ledTimer);
-    timerAlarm(ledTimer, ledLowUs, false, 0);
-  }
+WaveformSettings currentSettings() {
+  WaveformSettings settings;
+  settings.ledFreq = LED_FREQ;
+  settings.ledDuty = LED_DUTY;
+  settings.magnetFreq = MAGNET_FREQ;
+  settings.magnetDuty = MAGNET_DUTY;
+  settings.magnet2Duty = MAGNET2_DUTY;
+  settings.magnet2Phase = MAGNET2_PHASE;
+  return settings;
 }
 
-void updateMagnetTimer() {
-  float magnetPeriodUs = 1000000.0f / MAGNET_FREQ;
-  magnetHighUs = (uint32_t)(magnetPeriodUs * (MAGNET_DUTY / 100.0f));
-  magnetLowUs = (uint32_t)(magnetPeriodUs * (1.0f - MAGNET_DUTY / 100.0f));
-  
-  if (magnetTimer != NULL && deviceEnabled) {
-    timerRestart(magnetTimer);
-    timerAlarm(magnetTimer, magnetLowUs, false, 0);
-  }
+// What the waveform task publishes: the requested settings with the magnet
+// duty capped by the coil thermal budget and, while a camera trigger is
+// locked, the frequencies pulled onto it
+WaveformSettings outputSettings(const WaveformSettings &requested, float dutyLimit) {
+  WaveformSettings settings = requested;
+  if (settings.magnetDuty > dutyLimit) settings.magnetDuty = dutyLimit;
+  if (settings.magnet2Duty > dutyLimit) settings.magnet2Duty = dutyLimit;
+  shutterApply(settings);
+  return settings;
 }
 
-void saveSettings() {
-  preferences.begin("slowmo", false);
-  preferences.putFloat("led_freq", LED_FREQ);
-  preferences.putFloat("mag_freq", MAGNET_FREQ);
-  preferences.putFloat("led_duty", LED_DUTY);
-  preferences.putFloat("mag_duty", MAGNET_DUTY);
-  preferences.end();
-  DEBUG_PRINT("Settings saved to flash");
+// Hand a command to the waveform task. Fails instead of blocking if the
+// queue stays full, so web traffic can never back up into edge timing.
+bool sendWaveformCommand(WaveformCommandType type, const WaveformSettings &settings) {
+  WaveformCommand cmd;
+  cmd.type = type;
+  cmd.settings = settings;
+  cmd.level = WAVEFORM_RELEASE;
+  cmd.ppm = 0;
+  return xQueueSend(commandQueue, &cmd, pdMS_TO_TICKS(COMMAND_QUEUE_TIMEOUT_MS)) == pdTRUE;
+}
+
+// Make `settings` live: the waveforms pick them up at their next cycle
+// boundary, flash follows once the edits settle.
+bool applyWaveformSettings(const WaveformSettings &settings) {
+  if (!sendWaveformCommand(CMD_PUBLISH, settings)) return false;
+  LED_FREQ = settings.ledFreq;
+  LED_DUTY = settings.ledDuty;
+  MAGNET_FREQ = settings.magnetFreq;
+  MAGNET_DUTY = settings.magnetDuty;
+  MAGNET2_DUTY = settings.magnet2Duty;
+  MAGNET2_PHASE = settings.magnet2Phase;
+  activePreset = presetFind(settings);
+  stateVersion++;
+  storeUpdate(settings);
+  return true;
+}
+
+bool selectPreset(int slot) {
+  const Preset *preset = presetGet(slot);
+  if (!preset || !applyWaveformSettings(preset->settings)) return false;
+  activePreset = slot;
+
+  #ifdef DEBUG
+  Serial.printf("Preset %d: %s\n", slot, preset->name);
+  #endif
+  return true;
+}
+
+void setEnabled(bool enabled) {
+  if (!sendWaveformCommand(enabled ? CMD_START : CMD_STOP, currentSettings())) return;
+  deviceEnabled = enabled;
+  stateVersion++;
+  DEBUG_PRINT(enabled ? "\n>>> DEVICE ENABLED <<<" : "\n>>> DEVICE DISABLED <<<");
 }
 
 void loadSettings() {
-  preferences.begin("slowmo", true);
-  LED_FREQ = preferences.getFloat("led_freq", DEFAULT_LED_FREQ);
-  MAGNET_FREQ = preferences.getFloat("mag_freq", DEFAULT_MAGNET_FREQ);
-  LED_DUTY = preferences.getFloat("led_duty", DEFAULT_LED_DUTY);
-  MAGNET_DUTY = preferences.getFloat("mag_duty", DEFAULT_MAGNET_DUTY);
-  preferences.end();
+  WaveformSettings settings;
+  storeBegin(settings);
+  LED_FREQ = settings.ledFreq;
+  MAGNET_FREQ = settings.magnetFreq;
+  LED_DUTY = settings.ledDuty;
+  MAGNET_DUTY = settings.magnetDuty;
+  MAGNET2_DUTY = settings.magnet2Duty;
+  MAGNET2_PHASE = settings.magnet2Phase;
   
   #ifdef DEBUG
-  Serial.printf("Loaded settings: LED=%.1fHz@%.0f%%, Magnet=%.1fHz@%.0f%%\n", 
-                LED_FREQ, LED_DUTY, MAGNET_FREQ, MAGNET_DUTY);
+  Serial.printf("Loaded settings: LED=%.1fHz@%.0f%%, Magnet=%.1fHz@%.0f%%, Magnet2=%.0f%%@%.0fdeg\n", 
+                LED_FREQ, LED_DUTY, MAGNET_FREQ, MAGNET_DUTY, MAGNET2_DUTY, MAGNET2_PHASE);
   #endif
 }
 
+// The page is gzipped at build time (scripts/embed_web.py). Browsers must
+// revalidate on each load; an unchanged page costs a bodiless 304.
 void handleRoot() {
-  server.send_P(200, "text/html", HTML_PAGE);
+  server.sendHeader("Cache-Control", "no-cache");
+  server.sendHeader("ETag", WEB_INDEX_ETAG);
+  if (server.header("If-None-Match").equals(WEB_INDEX_ETAG)) {
+    server.send(304);
+    return;
+  }
+  server.sendHeader("Content-Encoding", "gzip");
+  server.send_P(200, "text/html", (const char *)WEB_INDEX_GZ, WEB_INDEX_GZ_LEN);
+}
+
+// Returns the length, or 0 if the document did not fit in `size`
+size_t settingsJson(char *buf, size_t size) {
+  WaveformStatus wave;
+  waveformGetStatus(wave);
+
+  JsonWriter w;
+  jsonWriterBegin(w, buf, size);
+  jsonBeginObject(w);
+  jsonAddFloat(w, "ledFreq", LED_FREQ, 1);
+  jsonAddFloat(w, "ledDuty", LED_DUTY, 1);
+  jsonAddFloat(w, "magFreq", MAGNET_FREQ, 1);
+  jsonAddFloat(w, "magDuty", MAGNET_DUTY, 1);
+  jsonAddFloat(w, "mag2Duty", MAGNET2_DUTY, 1);
+  jsonAddFloat(w, "mag2Phase", MAGNET2_PHASE, 1);
+  jsonAddFloat(w, "ledFreqActual", wave.ledHz, 4);
+  jsonAddFloat(w, "magFreqActual", wave.magnetHz, 4);
+  jsonAddFloat(w, "beat", wave.beatHz, 4);
+  jsonAddBool(w, "enabled", deviceEnabled);
+  jsonAddInt(w, "preset", activePreset);
+  TimelineStatus timeline;
+  timelineGetStatus(timeline);
+  jsonAddBool(w, "timeline", timeline.playing);
+  jsonEndObject(w);
+  return w.overflow ? 0 : w.len;
 }
 
 void handleGetSettings() {
-  String json = "{";
-  json += "\"ledFreq\":" + String(LED_FREQ, 1) + ",";
-  json += "\"ledDuty\":" + String(LED_DUTY, 1) + ",";
-  json += "\"magFreq\":" + String(MAGNET_FREQ, 1) + ",";
-  json += "\"magDuty\":" + String(MAGNET_DUTY, 1) + ",";
-  json += "\"enabled\":" + String(deviceEnabled ? "true" : "false");
-  json += "}";
-  server.send(200, "application/json", json);
+  char json[SETTINGS_JSON_SIZE];
+  size_t len = settingsJson(json, sizeof(json));
+  if (len == 0) {
+    server.send(500, "text/plain", "Settings too large");
+    return;
+  }
+  server.send_P(200, "application/json", json, len);
+}
+
+void handleGetMetrics() {
+  static char json[METRICS_JSON_SIZE];   // network task only
+  ProfilerSnapshot snap;
+  profilerSnapshot(snap);
+  const char *names[PROFILER_CHANNELS] = {"led", "magnet"};
+
+  JsonWriter w;
+  jsonWriterBegin(w, json, sizeof(json));
+  jsonBeginObject(w);
+  jsonAddUInt(w, "sinceMs", millis() - snap.sinceMs);
+  jsonAddUInt(w, "edges", snap.edges);
+  jsonAddUInt(w, "dropped", snap.dropped);
+  jsonAddUInt(w, "periodBinNs", PROFILER_PERIOD_BIN_NS);
+  for (int i = 0; i < PROFILER_CHANNELS; i++) {
+    const ProfilerChannelStats &c = snap.channel[i];
+    jsonBeginObject(w, names[i]);
+    jsonAddUInt(w, "periods", c.periods);
+    jsonAddFloat(w, "meanErrUs", c.meanErrorUs, 3);
+    jsonAddFloat(w, "jitterUs", c.jitterUs, 3);
+    jsonAddFloat(w, "minErrUs", c.minErrorUs, 3);
+    jsonAddFloat(w, "maxErrUs", c.maxErrorUs, 3);
+    jsonAddUIntArray(w, "hist", c.hist, PROFILER_BINS);
+    jsonEndObject(w);
+  }
+  jsonBeginObject(w, "beat");
+  jsonAddUInt(w, "windows", snap.beat.windows);
+  jsonAddFloat(w, "targetHz", snap.beat.targetHz, 4);
+  jsonAddFloat(w, "lastHz", snap.beat.lastHz, 4);
+  jsonAddFloat(w, "meanErrMilliHz", snap.beat.meanErrorMilliHz, 3);
+  jsonAddFloat(w, "maxErrMilliHz", snap.beat.maxAbsErrorMilliHz, 3);
+  jsonAddUInt(w, "binMicroHz", PROFILER_BEAT_BIN_UHZ);
+  jsonAddUIntArray(w, "hist", snap.beat.hist, PROFILER_BINS);
+  jsonEndObject(w);
+
+  // Watch these over a long run to spot leaks and fragmentation
+  jsonBeginObject(w, "heap");
+  jsonAddUInt(w, "free", ESP.getFreeHeap());
+  jsonAddUInt(w, "minFree", ESP.getMinFreeHeap());
+  jsonAddUInt(w, "maxBlock", ESP.getMaxAllocHeap());
+  jsonEndObject(w);
+  jsonEndObject(w);
+
+  if (w.overflow) {
+    server.send(500, "text/plain", "Metrics too large");
+    return;
+  }
+  server.send_P(200, "application/json", json, w.len);
+}
+
+// Short form of the metrics for the live event stream. Returns the
+// length, or 0 if it did not fit in `size`.
+size_t metricsSummaryJson(char *buf, size_t size) {
+  ProfilerSnapshot snap;
+  profilerSnapshot(snap);
+
+  JsonWriter w;
+  jsonWriterBegin(w, buf, size);
+  jsonBeginObject(w);
+  jsonAddFloat(w, "ledJitterUs", snap.channel[PROFILER_LED].jitterUs, 2);
+  jsonAddFloat(w, "magJitterUs", snap.channel[PROFILER_MAGNET].jitterUs, 2);
+  jsonAddFloat(w, "beatHz", snap.beat.lastHz, 4);
+  jsonAddFloat(w, "beatErrMilliHz", snap.beat.meanErrorMilliHz, 2);
+  WifiStatus wifi;
+  wifiManagerGetStatus(wifi);
+  jsonAddInt(w, "rssi", wifi.rssi);
+  ThermalStatus thermal;
+  thermalGetStatus(thermal);
+  jsonAddFloat(w, "coilC", thermal.coilC, 1);
+  jsonAddFloat(w, "magLimit", thermal.dutyLimit, 1);
+  jsonAddBool(w, "thermalPaused", thermal.paused);
+  jsonEndObject(w);
+  return w.overflow ? 0 : w.len;
+}
+
+void handleEvents() {
+  int slot = eventsAddClient(server.client());
+  if (slot < 0) {
+    server.send(503, "text/plain", "Too many event clients");
+    return;
+  }
+  char settings[SETTINGS_JSON_SIZE];
+  char metrics[SUMMARY_JSON_SIZE];
+  // A document that did not fit is left out rather than sent cut short
+  if (settingsJson(settings, sizeof(settings)) > 0) eventsSend(slot, "settings", settings);
+  if (metricsSummaryJson(metrics, sizeof(metrics)) > 0) eventsSend(slot, "metrics", metrics);
+}
+
+// Push settings as soon as they change and metrics when their rounded
+// values move, at most every EVENTS_METRICS_INTERVAL_MS.
+void publishEvents() {
+  static bool wasPlaying = false;
+  static uint32_t sentVersion = 0;
+  static unsigned long lastMetricsMs = 0;
+  static char sentMetrics[SUMMARY_JSON_SIZE];
+  
+  TimelineStatus timeline;
+  timelineGetStatus(timeline);
+  if (timeline.playing != wasPlaying) {
+    wasPlaying = timeline.playing;
+    stateVersion++;
+  }
+  
+  if (eventsClientCount() == 0) {
+    sentVersion = stateVersion;
+    return;
+  }
+  
+  if (sentVersion != stateVersion) {
+    char settings[SETTINGS_JSON_SIZE];
+    if (settingsJson(settings, sizeof(settings)) > 0) eventsBroadcast("settings", settings);
+    sentVersion = stateVersion;
+  }
+  
+  if (millis() - lastMetricsMs >= EVENTS_METRICS_INTERVAL_MS) {
+    lastMetricsMs = millis();
+    char metrics[SUMMARY_JSON_SIZE];
+    if (metricsSummaryJson(metrics, sizeof(metrics)) > 0 && strcmp(metrics, sentMetrics) != 0) {
+      eventsBroadcast("metrics", metrics);
+      strcpy(sentMetrics, metrics);
+    }
+  }
+  
+  eventsKeepAlive();
+}
+
+void handleResetMetrics() {
+  profilerReset();
+  server.send(200, "text/plain", "Metrics reset");
+}
+
+void sendParseError(const char *message, size_t offset) {
+  char text[96];
+  snprintf(text, sizeof(text), "Invalid JSON: %s at offset %u", message, (unsigned)offset);
+  server.send(400, "text/plain", text);
 }
 
 void handleSetSettings() {
-  if (server.hasArg("plain")) {
-    String body = server.arg("plain");
-    
-    // Simple JSON parsing
-    int ledFreqIdx = body.indexOf("\"ledFreq\":");
-    int ledDutyIdx = body.indexOf("\"ledDuty\":");
-    int magFreqIdx = body.indexOf("\"magFreq\":");
-    int magDutyIdx = body.indexOf("\"magDuty\":");
-    
-    if (ledFreqIdx > 0) LED_FREQ = body.substring(ledFreqIdx + 10).toFloat();
-    if (ledDutyIdx > 0) LED_DUTY = body.substring(ledDutyIdx + 10).toFloat();
-    if (magFreqIdx > 0) MAGNET_FREQ = body.substring(magFreqIdx + 10).toFloat();
-    if (magDutyIdx > 0) MAGNET_DUTY = body.substring(magDutyIdx + 10).toFloat();
-    
-    // Update timers
-    updateLEDTimer();
-    updateMagnetTimer();
-    
-    // Save to flash
-    saveSettings();
-    
-    #ifdef DEBUG
-    Serial.printf("Updated: LED=%.1fHz@%.0f%%, Mag=%.1fHz@%.0f%%\n", 
-                  LED_FREQ, LED_DUTY, MAGNET_FREQ, MAGNET_DUTY);
-    #endif
-    
-    server.send(200, "text/plain", "Settings updated and saved");
-  } else {
+  if (!server.hasArg("plain")) {
     server.send(400, "text/plain", "Bad Request");
+    return;
   }
+  const String &body = server.arg("plain");
+
+  // Parse straight into a copy; nothing changes unless every field is valid
+  WaveformSettings settings = currentSettings();
+  const JsonFloatField fields[] = {
+    {"ledFreq", &settings.ledFreq, FREQ_MIN, FREQ_MAX},
+    {"ledDuty", &settings.ledDuty, LED_DUTY_MIN, LED_DUTY_MAX},
+    {"magFreq", &settings.magnetFreq, FREQ_MIN, FREQ_MAX},
+    {"magDuty", &settings.magnetDuty, MAGNET_DUTY_MIN, MAGNET_DUTY_MAX},
+    {"mag2Duty", &settings.magnet2Duty, MAGNET_DUTY_MIN, MAGNET_DUTY_MAX},
+    {"mag2Phase", &settings.magnet2Phase, MAGNET_PHASE_MIN, MAGNET_PHASE_MAX},
+  };
+  JsonParseError err;
+  if (jsonParseFloatFields(body.c_str(), body.length(), fields,
+                           sizeof(fields) / sizeof(fields[0]), err) < 0) {
+    char message[96];
+    if (err.field && strcmp(err.message, "out of range") == 0) {
+      snprintf(message, sizeof(message), "%s: out of range (%g-%g)",
+               err.field->name, err.field->min, err.field->max);
+    } else if (err.field) {
+      snprintf(message, sizeof(message), "%s: %s at offset %u",
+               err.field->name, err.message, (unsigned)err.offset);
+    } else {
+      sendParseError(err.message, err.offset);
+      return;
+    }
+    server.send(400, "text/plain", message);
+    return;
+  }
+
+  // Update waveforms
+  if (!applyWaveformSettings(settings)) {
+    server.send(503, "text/plain", "Busy, try again");
+    return;
+  }
+
+  #ifdef DEBUG
+  Serial.printf("Updated: LED=%.1fHz@%.0f%%, Mag=%.1fHz@%.0f%%\n", 
+                LED_FREQ, LED_DUTY, MAGNET_FREQ, MAGNET_DUTY);
+  #endif
+
+  server.send(200, "text/plain", "Settings updated, save pending");   // flash follows once edits settle
 }
 
 void handleReset() {
-  LED_FREQ = DEFAULT_LED_FREQ;
-  MAGNET_FREQ = DEFAULT_MAGNET_FREQ;
-  LED_DUTY = DEFAULT_LED_DUTY;
-  MAGNET_DUTY = DEFAULT_MAGNET_DUTY;
+  WaveformSettings settings;
+  storeDefaults(settings);
   
-  updateLEDTimer();
-  updateMagnetTimer();
-  saveSettings();
+  if (!applyWaveformSettings(settings)) {
+    server.send(503, "text/plain", "Busy, try again");
+    return;
+  }
   
   DEBUG_PRINT("Settings reset to defaults");
   server.send(200, "text/plain", "Reset to defaults");
 }
 
+void handleGetPresets() {
+  static char json[PRESETS_JSON_SIZE];   // network task only
+  JsonWriter w;
+  jsonWriterBegin(w, json, sizeof(json));
+  jsonBeginObject(w);
+  jsonAddInt(w, "slots", PRESET_COUNT);
+  jsonAddInt(w, "active", activePreset);
+  jsonBeginArray(w, "presets");
+  for (int i = 0; i < PRESET_COUNT; i++) {
+    const Preset *p = presetGet(i);
+    if (!p) continue;
+    jsonBeginObject(w);
+    jsonAddInt(w, "slot", i);
+    jsonAddString(w, "name", p->name);
+    jsonAddFloat(w, "ledFreq", p->settings.ledFreq, 1);
+    jsonAddFloat(w, "ledDuty", p->settings.ledDuty, 1);
+    jsonAddFloat(w, "magFreq", p->settings.magnetFreq, 1);
+    jsonAddFloat(w, "magDuty", p->settings.magnetDuty, 1);
+    jsonAddFloat(w, "mag2Duty", p->settings.magnet2Duty, 1);
+    jsonAddFloat(w, "mag2Phase", p->settings.magnet2Phase, 1);
+    jsonEndObject(w);
+  }
+  jsonEndArray(w);
+  jsonEndObject(w);
+  server.send_P(200, "application/json", json, w.len);
+}
+
+// {"action": "select" | "save" | "delete", "slot": n, "name": "..."}
+// "save" stores the live settings under `name`.
+void handlePresetAction() {
+  if (!server.hasArg("plain")) {
+    server.send(400, "text/plain", "Bad Request");
+    return;
+  }
+  const String &body = server.arg("plain");
+
+  char action[8] = "";
+  char name[PRESET_NAME_LEN] = "";
+  int slot = -1;
+
+  JsonReader r;
+  jsonBegin(r, body.c_str(), body.length());
+  if (jsonNext(r) != JSON_OBJECT_BEGIN) {
+    jsonFail(r, "expected object");
+  }
+  while (jsonNext(r) == JSON_KEY) {
+    if (jsonStringIs(r, "action")) {
+      if (jsonNext(r) != JSON_STRING || !jsonCopyString(r, action, sizeof(action))) {
+        jsonFail(r, "invalid action");
+      }
+    } else if (jsonStringIs(r, "slot")) {
+      if (jsonNext(r) != JSON_NUMBER || r.number < 0 || r.number >= PRESET_COUNT ||
+          r.number != (int)r.number) {
+        jsonFail(r, "invalid slot");
+      }
+      slot = (int)r.number;
+    } else if (jsonStringIs(r, "name")) {
+      if (jsonNext(r) != JSON_STRING || !jsonCopyString(r, name, sizeof(name))) {
+        jsonFail(r, "name must be a string of up to 15 characters");
+      }
+    } else {
+      jsonFail(r, "unknown key");
+    }
+  }
+  if (r.token == JSON_OBJECT_END) jsonNext(r);
+  if (r.token != JSON_END) {
+    sendParseError(r.error, r.errorPos);
+    return;
+  }
+  if (slot < 0) {
+    server.send(400, "text/plain", "Missing slot");
+    return;
+  }
+
+  bool ok;
+  if (strcmp(action, "select") == 0) {
+    if (!presetGet(slot)) {
+      server.send(404, "text/plain", "Empty preset slot");
+      return;
+    }
+    ok = selectPreset(slot);
+  } else if (strcmp(action, "save") == 0) {
+    ok = presetSave(slot, name, currentSettings());
+    if (!ok) {
+      server.send(400, "text/plain", "Missing name");
+      return;
+    }
+    activePreset = presetFind(currentSettings());
+    stateVersion++;
+  } else if (strcmp(action, "delete") == 0) {
+    ok = presetDelete(slot);
+    if (!ok) {
+      server.send(404, "text/plain", "Empty preset slot");
+      return;
+    }
+    activePreset = presetFind(currentSettings());
+    stateVersion++;
+  } else {
+    server.send(400, "text/plain", "Unknown action");
+    return;
+  }
+
+  if (!ok) {
+    server.send(503, "text/plain", "Busy, try again");
+    return;
+  }
+  server.send(200, "text/plain", "OK");
+}
+
+void handleGetTimeline() {
+  TimelineStatus status;
+  timelineGetStatus(status);
+
+  char json[96];
+  JsonWriter w;
+  jsonWriterBegin(w, json, sizeof(json));
+  jsonBeginObject(w);
+  jsonAddBool(w, "playing", status.playing);
+  jsonAddUInt(w, "index", status.index);
+  jsonAddUInt(w, "count", status.count);
+  jsonAddBool(w, "loop", status.loop);
+  jsonEndObject(w);
+  server.send_P(200, "application/json", json, w.len);
+}
+
+// Upload a timeline and start playing it from the live settings
+void handlePlayTimeline() {
+  if (!server.hasArg("plain")) {
+    server.send(400, "text/plain", "Bad Request");
+    return;
+  }
+  if (!deviceEnabled) {
+    server.send(409, "text/plain", "Device is disabled");
+    return;
+  }
+  const String &body = server.arg("plain");
+
+  static Timeline timeline;   // network task only
+  JsonReader r;
+  if (!timelineParse(r, body.c_str(), body.length(), timeline)) {
+    sendParseError(r.error, r.errorPos);
+    return;
+  }
+  timelineStage(timeline);
+  if (!sendWaveformCommand(CMD_TIMELINE_PLAY, currentSettings())) {
+    server.send(503, "text/plain", "Busy, try again");
+    return;
+  }
+  server.send(200, "text/plain", "Timeline playing");
+}
+
+// Stop playback and return to the live settings
+void handleStopTimeline() {
+  if (!sendWaveformCommand(CMD_PUBLISH, currentSettings())) {
+    server.send(503, "text/plain", "Busy, try again");
+    return;
+  }
+  server.send(200, "text/plain", "Timeline stopped");
+}
+
+void handleGetThermal() {
+  ThermalStatus status;
+  thermalGetStatus(status);
+
+  char json[192];
+  JsonWriter w;
+  jsonWriterBegin(w, json, sizeof(json));
+  jsonBeginObject(w);
+  jsonAddFloat(w, "coilC", status.coilC, 2);
+  jsonAddFloat(w, "deratedAboveC", THERMAL_DERATE_C, 1);
+  jsonAddFloat(w, "pauseAtC", THERMAL_MAX_C, 1);
+  jsonAddFloat(w, "magDutyLimit", status.dutyLimit, 1);
+  jsonAddBool(w, "paused", status.paused);
+  if (status.budgetS < 0) jsonAddFloat(w, "budgetS", NAN, 0);   // null: never reached
+  else jsonAddFloat(w, "budgetS", status.budgetS, 0);
+  jsonAddFloat(w, "dutyHours", status.dutyHours, 4);
+  jsonAddFloat(w, "energyWh", status.energyWh, 3);
+  jsonEndObject(w);
+  server.send_P(200, "application/json", json, w.len);
+}
+
+void handleGetChannels() {
+  static char json[CHANNELS_JSON_SIZE];   // network task only
+  JsonWriter w;
+  jsonWriterBegin(w, json, sizeof(json));
+  jsonBeginObject(w);
+  jsonAddInt(w, "max", WAVEFORM_MAX_CHANNELS);
+  jsonBeginArray(w, "channels");
+  for (int i = 0; i < waveformChannelCount(); i++) {
+    WaveformChannelInfo info;
+    waveformChannelInfo(i, info);
+    jsonBeginObject(w);
+    jsonAddInt(w, "index", i);
+    jsonAddInt(w, "pin", info.pin);
+    jsonAddInt(w, "leader", info.leader);
+    WaveformChannel c;
+    if (channelsGet(i, c)) {
+      jsonAddBool(w, "enabled", c.enabled);
+      jsonAddFloat(w, "freq", c.freq, 3);
+      jsonAddFloat(w, "duty", c.duty, 1);
+      jsonAddFloat(w, "phase", c.phase, 1);
+    }
+    jsonAddFloat(w, "hz", waveformChannelHz(i), 4);
+    jsonEndObject(w);
+  }
+  jsonEndArray(w);
+  jsonEndObject(w);
+
+  if (w.overflow) {
+    server.send(500, "text/plain", "Channel table too large");
+    return;
+  }
+  server.send_P(200, "application/json", json, w.len);
+}
+
+// {"index": n, "enabled": bool, "freq": Hz, "duty": %, "phase": deg}
+// Only extra channels can be set here; omitted keys keep their value.
+void handleSetChannel() {
+  if (!server.hasArg("plain")) {
+    server.send(400, "text/plain", "Bad Request");
+    return;
+  }
+  const String &body = server.arg("plain");
+
+  int index = -1;
+  bool hasEnabled = false, enabled = false;
+  float freq = NAN, duty = NAN, phase = NAN;
+
+  JsonReader r;
+  jsonBegin(r, body.c_str(), body.length());
+  if (jsonNext(r) != JSON_OBJECT_BEGIN) {
+    jsonFail(r, "expected object");
+  }
+  while (jsonNext(r) == JSON_KEY) {
+    if (jsonStringIs(r, "index")) {
+      if (jsonNext(r) != JSON_NUMBER || r.number < 0 || r.number >= waveformChannelCount() ||
+          r.number != (int)r.number) {
+        jsonFail(r, "invalid index");
+      }
+      index = (int)r.number;
+    } else if (jsonStringIs(r, "enabled")) {
+      JsonToken t = jsonNext(r);
+      if (t != JSON_TRUE && t != JSON_FALSE) jsonFail(r, "enabled must be true or false");
+      hasEnabled = true;
+      enabled = t == JSON_TRUE;
+    } else if (jsonStringIs(r, "freq")) {
+      if (jsonNext(r) != JSON_NUMBER) jsonFail(r, "freq must be a number");
+      freq = r.number;
+    } else if (jsonStringIs(r, "duty")) {
+      if (jsonNext(r) != JSON_NUMBER) jsonFail(r, "duty must be a number");
+      duty = r.number;
+    } else if (jsonStringIs(r, "phase")) {
+      if (jsonNext(r) != JSON_NUMBER) jsonFail(r, "phase must be a number");
+      phase = r.number;
+    } else {
+      jsonFail(r, "unknown key");
+    }
+  }
+  if (r.token == JSON_OBJECT_END) jsonNext(r);
+  if (r.token != JSON_END) {
+    sendParseError(r.error, r.errorPos);
+    return;
+  }
+
+  WaveformChannel c, previous;
+  if (!channelsGet(index, c)) {
+    server.send(404, "text/plain", "No such extra channel");
+    return;
+  }
+  previous = c;
+  if (hasEnabled) c.enabled = enabled;
+  if (!isnan(freq)) c.freq = freq;
+  if (!isnan(duty)) c.duty = duty;
+  if (!isnan(phase)) c.phase = phase;
+  if (!channelsSet(index, c)) {
+    server.send(400, "text/plain", "Value out of range");
+    return;
+  }
+  // The waveform task copies the table when the command arrives, so the
+  // table changes first and goes back if the command cannot be queued
+  if (!sendWaveformCommand(CMD_CHANNELS, currentSettings())) {
+    channelsSet(index, previous);
+    server.send(503, "text/plain", "Busy, try again");
+    return;
+  }
+  server.send(200, "text/plain", "OK");
+}
+
+void handleGetWifi() {
+  WifiStatus status;
+  wifiManagerGetStatus(status);
+  char ip[16];
+  IPAddress addr = WiFi.localIP();
+  snprintf(ip, sizeof(ip), "%u.%u.%u.%u", addr[0], addr[1], addr[2], addr[3]);
+
+  char json[192];
+  JsonWriter w;
+  jsonWriterBegin(w, json, sizeof(json));
+  jsonBeginObject(w);
+  jsonAddString(w, "state", wifiStateName(status.state));
+  jsonAddString(w, "ip", ip);
+  jsonAddInt(w, "rssi", status.rssi);
+  jsonAddUInt(w, "reconnects", status.reconnects);
+  jsonAddUInt(w, "retryInMs", status.retryInMs);
+  jsonAddBool(w, "ap", status.apActive);
+  jsonAddUInt(w, "apClients", status.apClients);
+  jsonEndObject(w);
+  server.send_P(200, "application/json", json, w.len);
+}
+
+void handleGetSync() {
+  SyncStatus status;
+  syncGetStatus(status);
+  char leader[16];
+  IPAddress addr(status.leaderIp);
+  snprintf(leader, sizeof(leader), "%u.%u.%u.%u", addr[0], addr[1], addr[2], addr[3]);
+
+  char json[SYNC_JSON_SIZE];
+  JsonWriter w;
+  jsonWriterBegin(w, json, sizeof(json));
+  jsonBeginObject(w);
+  jsonAddString(w, "role", syncRoleName(status.role));
+  jsonAddUInt(w, "exchanges", status.exchanges);
+  if (status.role == SYNC_FOLLOWER) {
+    jsonAddString(w, "leader", leader);
+    jsonAddBool(w, "locked", status.locked);
+    jsonAddBool(w, "aligned", status.aligned);
+    jsonAddBool(w, "settingsMatch", status.settingsMatch);
+    jsonAddFloat(w, "offsetUs", status.offsetUs, 1);
+    jsonAddFloat(w, "delayUs", status.delayUs, 1);
+    jsonAddFloat(w, "ppm", status.ppm, 3);
+    jsonAddFloat(w, "ledErrUs", status.ledErrUs, 1);
+    jsonAddFloat(w, "magErrUs", status.magnetErrUs, 1);
+    jsonAddUInt(w, "steps", status.steps);
+  }
+  jsonEndObject(w);
+  server.send_P(200, "application/json", json, w.len);
+}
+
+void handleGetShutter() {
+  ShutterStatus status;
+  shutterGetStatus(status);
+
+  char json[SHUTTER_JSON_SIZE];
+  JsonWriter w;
+  jsonWriterBegin(w, json, sizeof(json));
+  jsonBeginObject(w);
+  jsonAddString(w, "state", shutterStateName(status.state));
+  if (status.state >= SHUTTER_ACQUIRING) {
+    jsonAddFloat(w, "triggerHz", status.triggerHz, 4);
+    jsonAddInt(w, "multiple", status.multiple);
+    jsonAddFloat(w, "phaseErrDeg", status.phaseErrDeg, 2);
+    jsonAddFloat(w, "phaseErrUs", status.phaseErrUs, 1);
+    jsonAddFloat(w, "correctionHz", status.correctionHz, 4);
+  }
+  jsonEndObject(w);
+  server.send_P(200, "application/json", json, w.len);
+}
+
+#ifdef OTA_TEST
+void handleGetOtaTest() {
+  OtaTestStatus status;
+  otaTestGetStatus(status);
+
+  char json[128];
+  JsonWriter w;
+  jsonWriterBegin(w, json, sizeof(json));
+  jsonBeginObject(w);
+  jsonAddBool(w, "running", status.running);
+  jsonAddUInt(w, "elapsedMs", status.elapsedMs);
+  jsonAddUInt(w, "durationMs", status.durationMs);
+  jsonAddUInt(w, "sectors", status.sectors);
+  jsonAddUInt(w, "maxWriteUs", status.maxWriteUs);
+  jsonEndObject(w);
+  server.send_P(200, "application/json", json, w.len);
+}
+
+// {"seconds": n}: reset the metrics and rewrite flash for n seconds
+void handleStartOtaTest() {
+  if (!server.hasArg("plain")) {
+    server.send(400, "text/plain", "Bad Request");
+    return;
+  }
+  const String &body = server.arg("plain");
+
+  float seconds = NAN;
+  JsonReader r;
+  jsonBegin(r, body.c_str(), body.length());
+  if (jsonNext(r) != JSON_OBJECT_BEGIN) {
+    jsonFail(r, "expected object");
+  }
+  while (jsonNext(r) == JSON_KEY) {
+    if (jsonStringIs(r, "seconds")) {
+      if (jsonNext(r) != JSON_NUMBER || r.number < 1 || r.number > 600) {
+        jsonFail(r, "seconds must be 1 to 600");
+      }
+      seconds = r.number;
+    } else {
+      jsonFail(r, "unknown key");
+    }
+  }
+  if (r.token == JSON_OBJECT_END) jsonNext(r);
+  if (r.token != JSON_END || isnan(seconds)) {
+    sendParseError(r.error ? r.error : "seconds missing", r.errorPos);
+    return;
+  }
+
+  if (!otaTestStart((uint32_t)seconds)) {
+    server.send(409, "text/plain", "Already running, or no OTA partition");
+    return;
+  }
+  profilerReset();
+  server.send(202, "text/plain", "Started");
+}
+#endif
+
+// ============================================
+// Boot sequence
+// ============================================
+// setup() only loads the settings and starts the waveform task, so the
+// strobe runs within milliseconds of power-on. Joining WiFi, starting the
+// web server and the magnet self-test are phases of non-blocking state
+// machines polled by the network task. Each phase logs its duration.
+
+enum BootPhase {
+  BOOT_WIFI_BEGIN,
+  BOOT_WEB_START,
+  BOOT_WIFI_WAIT,
+  BOOT_DONE
+};
+
+enum SelfTestPhase {
+  SELF_TEST_START,
+  SELF_TEST_ON,
+  SELF_TEST_OFF,
+  SELF_TEST_DONE
+};
+
+BootPhase bootPhase = BOOT_WIFI_BEGIN;
+unsigned long bootPhaseMs = 0;   // millis() when the current phase began
+#ifdef MAGNET_SELF_TEST
+SelfTestPhase selfTestPhase = SELF_TEST_START;
+#else
+SelfTestPhase selfTestPhase = SELF_TEST_DONE;
+#endif
+unsigned long selfTestPhaseMs = 0;
+unsigned long selfTestStartMs = 0;
+
+void bootLog(const char *phase, unsigned long startMs) {
+  #ifdef DEBUG
+  unsigned long now = millis();
+  Serial.printf("[boot] %-16s %5lu ms (at %lu ms)\n", phase, now - startMs, now);
+  #endif
+}
+
+void startWebServer() {
+  const char *headerKeys[] = {"If-None-Match"};
+  server.collectHeaders(headerKeys, 1);
+  server.on("/", HTTP_GET, handleRoot);
+  server.on("/api/settings", HTTP_GET, handleGetSettings);
+  server.on("/api/settings", HTTP_POST, handleSetSettings);
+  server.on("/api/reset", HTTP_POST, handleReset);
+  server.on("/api/presets", HTTP_GET, handleGetPresets);
+  server.on("/api/presets", HTTP_POST, handlePresetAction);
+  server.on("/api/timeline", HTTP_GET, handleGetTimeline);
+  server.on("/api/timeline", HTTP_POST, handlePlayTimeline);
+  server.on("/api/timeline", HTTP_DELETE, handleStopTimeline);
+  server.on("/api/metrics", HTTP_GET, handleGetMetrics);
+  server.on("/api/metrics", HTTP_DELETE, handleResetMetrics);
+  server.on("/api/events", HTTP_GET, handleEvents);
+  server.on("/api/wifi", HTTP_GET, handleGetWifi);
+  server.on("/api/thermal", HTTP_GET, handleGetThermal);
+  server.on("/api/channels", HTTP_GET, handleGetChannels);
+  server.on("/api/channels", HTTP_POST, handleSetChannel);
+  server.on("/api/sync", HTTP_GET, handleGetSync);
+  server.on("/api/shutter", HTTP_GET, handleGetShutter);
+  #ifdef OTA_TEST
+  server.on("/api/otatest", HTTP_GET, handleGetOtaTest);
+  server.on("/api/otatest", HTTP_POST, handleStartOtaTest);
+  #endif
+  
+  ElegantOTA.begin(&server);
+  ElegantOTA.onEnd([](bool success) { storeFlush(); });   // before the reboot
+  server.begin();
+}
+
+void serviceBoot() {
+  switch (bootPhase) {
+    case BOOT_WIFI_BEGIN:
+      wifiManagerBegin();
+      bootLog("wifi begin", bootPhaseMs);
+      bootPhase = BOOT_WEB_START;
+      bootPhaseMs = millis();
+      break;
+      
+    case BOOT_WEB_START:
+      startWebServer();
+      syncBegin();
+      bootLog("web server", bootPhaseMs);
+      bootPhase = BOOT_WIFI_WAIT;
+      bootPhaseMs = millis();
+      break;
+      
+    case BOOT_WIFI_WAIT:
+      // Only timed here; the WiFi manager keeps trying after boot
+      if (WiFi.status() == WL_CONNECTED) {
+        bootLog("wifi join", bootPhaseMs);
+        bootPhase = BOOT_DONE;
+      } else if (millis() - bootPhaseMs >= WIFI_CONNECT_TIMEOUT_MS) {
+        bootLog("wifi pending", bootPhaseMs);
+        bootPhase = BOOT_DONE;
+      }
+      break;
+      
+    case BOOT_DONE:
+      break;
+  }
+}
+
+bool sendMagnetOverride(int level) {
+  WaveformCommand cmd;
+  cmd.type = CMD_OVERRIDE_MAGNETS;
+  cmd.settings = currentSettings();
+  cmd.level = level;
+  cmd.ppm = 0;
+  return xQueueSend(commandQueue, &cmd, 0) == pdTRUE;
+}
+
+// Follower rate trims; one the queue had no room for is retried
+void serviceSync() {
+  static bool trimPending = false;
+  static double trimPpm = 0;
+
+  syncLoop();
+  if (syncTakeTrim(trimPpm)) trimPending = true;
+  if (!trimPending) return;
+  WaveformCommand cmd;
+  cmd.type = CMD_SYNC_TRIM;
+  cmd.settings = currentSettings();
+  cmd.level = WAVEFORM_RELEASE;
+  cmd.ppm = trimPpm;
+  if (xQueueSend(commandQueue, &cmd, 0) == pdTRUE) trimPending = false;
+}
+
+// Energise the magnets once, then release them to the waveform. A command
+// that doesn't fit in the queue is retried on the next pass.
+void serviceSelfTest() {
+  unsigned long elapsed = millis() - selfTestPhaseMs;
+  switch (selfTestPhase) {
+    case SELF_TEST_START:
+      if (sendMagnetOverride(HIGH)) {
+        selfTestPhase = SELF_TEST_ON;
+        selfTestPhaseMs = selfTestStartMs = millis();
+      }
+      break;
+      
+    case SELF_TEST_ON:
+      if (elapsed >= SELF_TEST_ON_MS && sendMagnetOverride(LOW)) {
+        selfTestPhase = SELF_TEST_OFF;
+        selfTestPhaseMs = millis();
+      }
+      break;
+      
+    case SELF_TEST_OFF:
+      if (elapsed >= SELF_TEST_OFF_MS && sendMagnetOverride(WAVEFORM_RELEASE)) {
+        bootLog("magnet self-test", selfTestStartMs);
+        selfTestPhase = SELF_TEST_DONE;
+      }
+      break;
+      
+    case SELF_TEST_DONE:
+      break;
+  }
+}
+
 void setup() {
+  unsigned long setupMs = millis();
+  
   #ifdef DEBUG
   Serial.begin(115200);
-  delay(1000);
   #endif
   
   DEBUG_PRINT("\nESP32 Precise PWM with OTA Updates");
   
   // Load saved settings
+  unsigned long phaseMs = millis();
   loadSettings();
+  presetsBegin();
+  channelsBegin();
+  activePreset = presetFind(currentSettings());
+  bootLog("settings", phaseMs);
   
   // Configure GPIO pins
   pinMode(LED_PIN, OUTPUT);
@@ -200,135 +1000,227 @@ void setup() {
   
   attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), onButtonPress, FALLING);
   
-  // Test magnets
-  DEBUG_PRINT("Testing magnet pins directly...");
-  digitalWrite(MAGNET_PIN, HIGH);
-  digitalWrite(MAGNET2_PIN, HIGH);
-  delay(1000);
-  digitalWrite(MAGNET_PIN, LOW);
-  digitalWrite(MAGNET2_PIN, LOW);
-  delay(500);
-  DEBUG_PRINT("Direct test complete");
-  
-  digitalWrite(LED_PIN, LOW);
-  digitalWrite(MAGNET_PIN, LOW);
-  digitalWrite(MAGNET2_PIN, LOW);
-  
-  // Calculate timer values
-  updateLEDTimer();
-  updateMagnetTimer();
-  
   #ifdef DEBUG
   Serial.printf("\nLED: %.1f Hz @ %.0f%% duty\n", LED_FREQ, LED_DUTY);
   Serial.printf("Magnet: %.1f Hz @ %.0f%% duty\n\n", MAGNET_FREQ, MAGNET_DUTY);
   #endif
   
-  // Connect to WiFi
-  DEBUG_PRINT("Connecting to WiFi");
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-  
-  int wifiTimeout = 0;
-  while (WiFi.status() != WL_CONNECTED && wifiTimeout < 20) {
-    delay(500);
-    #ifdef DEBUG
-    Serial.print(".");
-    #endif
-    wifiTimeout++;
-  }
-  
-  if (WiFi.status() == WL_CONNECTED) {
-    DEBUG_PRINT("\nWiFi connected!");
-    #ifdef DEBUG
-    Serial.print("IP address: ");
-    Serial.println(WiFi.localIP());
-    Serial.print("Control panel: http://");
-    Serial.println(WiFi.localIP());
-    #endif
-  } else {
-    DEBUG_PRINT("\nWiFi connection failed - continuing without web interface");
-  }
-  
-  // Setup web server
-  server.on("/", HTTP_GET, handleRoot);
-  server.on("/api/settings", HTTP_GET, handleGetSettings);
-  server.on("/api/settings", HTTP_POST, handleSetSettings);
-  server.on("/api/reset", HTTP_POST, handleReset);
-  
-  ElegantOTA.begin(&server);
-  server.begin();
-  DEBUG_PRINT("Web server started");
-  
-  // Create timers
-  DEBUG_PRINT("\nCreating timers...");
-  ledTimer = timerBegin(1000000);
-  magnetTimer = timerBegin(1000000);
-  
-  if (ledTimer == NULL || magnetTimer == NULL) {
-    DEBUG_PRINT("ERROR: Failed to create timers!");
+  // Start the real-time and network tasks on separate cores; the network
+  // task brings up WiFi and the web server in the background
+  commandQueue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(WaveformCommand));
+  xTaskCreatePinnedToCore(waveformTask, "waveform", 4096, NULL,
+                          WAVEFORM_TASK_PRIORITY, NULL, WAVEFORM_CORE);
+  bootPhaseMs = millis();
+  xTaskCreatePinnedToCore(networkTask, "network", 8192, NULL,
+                          NETWORK_TASK_PRIORITY, NULL, NETWORK_CORE);
+  bootLog("setup", setupMs);
+}
+
+// ============================================
+// Waveform task (WAVEFORM_CORE)
+// ============================================
+// Owns the waveform timers; their interrupts are allocated on this core
+// because they are created here. Executes queued commands and steps the
+// timeline and the coil thermal model, so it is the single publisher into
+// the waveform parameter block; magnet duty is capped here before every
+// publish, whatever the source.
+
+void publishChannels() {
+  WaveformChannel extra[CHANNELS_EXTRA_MAX];
+  channelsCopy(extra);
+  waveformPublishChannels(extra, channelsExtraCount());
+}
+
+void waveformTask(void *arg) {
+  unsigned long startMs = millis();
+  if (!waveformBegin(currentSettings())) {
+    DEBUG_PRINT("ERROR: Failed to start waveforms!");
+    vTaskDelete(NULL);
     return;
   }
+  publishChannels();
+  bootLog("waveforms", startMs);
   
-  timerAttachInterrupt(ledTimer, &onLedTimer);
-  timerAttachInterrupt(magnetTimer, &onMagnetTimer);
+  #ifdef EDGE_PROFILER
+  profilerBegin();
+  #endif
+  shutterBegin();
   
-  timerAlarm(ledTimer, ledLowUs, false, 0);
-  timerAlarm(magnetTimer, magnetLowUs, false, 0);
+  #ifdef DEBUG
+  WaveformStatus wave;
+  waveformGetStatus(wave);
+  Serial.printf("Achieved: LED=%.4fHz, Magnet=%.4fHz, Beat=%.4fHz\n",
+                wave.ledHz, wave.magnetHz, wave.beatHz);
+  #endif
   
   DEBUG_PRINT("\n=================================");
   DEBUG_PRINT("PWM running!");
   DEBUG_PRINT("=================================\n");
+  
+  WaveformCommand cmd;
+  WaveformSettings step;
+  WaveformSettings requested = currentSettings();   // before limiting and locking
+  bool running = true;
+  int magnetOverride = WAVEFORM_RELEASE;            // from CMD_OVERRIDE_MAGNETS
+  bool thermalHold = false;
+  float dutyLimit = 100.0f;
+  thermalBegin(millis());
+  for (;;) {
+    // Wake for timeline steps while one is playing, otherwise often enough
+    // to keep the coil temperature estimate and the shutter lock current
+    TimelineStatus timeline;
+    timelineGetStatus(timeline);
+    uint32_t waitMs = timeline.playing ? TIMELINE_STEP_MS : THERMAL_STEP_MS;
+    if (shutterActive() && waitMs > SHUTTER_STEP_MS) waitMs = SHUTTER_STEP_MS;
+    TickType_t wait = pdMS_TO_TICKS(waitMs);
+    bool changed = false;
+    
+    if (xQueueReceive(commandQueue, &cmd, wait) == pdTRUE) {
+      switch (cmd.type) {
+        case CMD_PUBLISH:
+          timelineStop();
+          requested = cmd.settings;
+          changed = true;
+          break;
+        case CMD_START:
+          requested = cmd.settings;
+          waveformPublish(outputSettings(requested, dutyLimit));
+          waveformStart();
+          running = true;
+          break;
+        case CMD_STOP:
+          timelineStop();
+          waveformStop();
+          running = false;
+          break;
+        case CMD_TIMELINE_PLAY:
+          timelinePlay(cmd.settings, millis());
+          break;
+        case CMD_OVERRIDE_MAGNETS:
+          magnetOverride = cmd.level;
+          if (!thermalHold) waveformOverrideMagnets(magnetOverride);
+          break;
+        case CMD_CHANNELS:
+          publishChannels();
+          break;
+        case CMD_SYNC_TRIM:
+          waveformTrim(cmd.ppm);
+          break;
+      }
+    }
+    
+    if (timelineStep(millis(), step)) {
+      requested = step;
+      changed = true;
+    }
+    if (running && shutterStep(millis(), requested)) changed = true;
+    
+    // Duty the coils actually saw since the last update
+    float duty = 0.0f, duty2 = 0.0f;
+    if (running && !thermalHold) {
+      if (magnetOverride == HIGH) {
+        duty = duty2 = 100.0f;
+      } else if (magnetOverride == WAVEFORM_RELEASE) {
+        WaveformSettings applied = outputSettings(requested, dutyLimit);
+        duty = applied.magnetDuty;
+        duty2 = applied.magnet2Duty;
+      }
+    }
+    float limit = thermalUpdate(millis(), duty, duty2);
+    
+    if (thermalPaused() != thermalHold) {
+      thermalHold = !thermalHold;
+      waveformOverrideMagnets(thermalHold ? LOW : magnetOverride);
+      DEBUG_PRINT(thermalHold ? "Thermal: magnets paused" : "Thermal: magnets resumed");
+    }
+    if (limit != dutyLimit) {
+      dutyLimit = limit;
+      changed = true;
+    }
+    if (changed) waveformPublish(outputSettings(requested, dutyLimit));
+  }
 }
 
-void loop() {
-  // Handle web server - MUST be called frequently
-  server.handleClient();
-  
-  #ifdef DEBUG
-  ElegantOTA.loop();
-  #endif
-  
+// ============================================
+// Network task (NETWORK_CORE)
+// ============================================
+// Web server, OTA, button and the settings store. Talks to the waveform
+// only through the command queue.
+
+// Short press toggles the device, long press steps to the next preset.
+// Polled without blocking; the interrupt only reports the press.
+void serviceButton() {
+  static bool held = false;
+  static bool longFired = false;
+  static unsigned long pressMs = 0;
+  static unsigned long releaseMs = 0;
+
   if (buttonPressed) {
     buttonPressed = false;
-    
-    // Quick check without blocking
-    if (digitalRead(BUTTON_PIN) == LOW) {
-      deviceEnabled = !deviceEnabled;
-      
-      if (deviceEnabled) {
-        DEBUG_PRINT("\n>>> DEVICE ENABLED <<<");
-        ledState = false;
-        magnetState = false;
-        digitalWrite(LED_PIN, LOW);
-        digitalWrite(MAGNET_PIN, LOW);
-        digitalWrite(MAGNET2_PIN, LOW);
-        
-        timerRestart(ledTimer);
-        timerRestart(magnetTimer);
-        timerAlarm(ledTimer, ledLowUs, false, 0);
-        timerAlarm(magnetTimer, magnetLowUs, false, 0);
-      } else {
-        DEBUG_PRINT("\n>>> DEVICE DISABLED <<<");
-        digitalWrite(LED_PIN, LOW);
-        digitalWrite(MAGNET_PIN, LOW);
-        digitalWrite(MAGNET2_PIN, LOW);
-        ledState = false;
-        magnetState = false;
-      }
+    // Ignore release bounce and presses that are already over
+    if (!held && millis() - releaseMs > DEBOUNCE_DELAY && digitalRead(BUTTON_PIN) == LOW) {
+      held = true;
+      longFired = false;
+      pressMs = millis();
     }
   }
+  if (!held) return;
+
+  if (digitalRead(BUTTON_PIN) == HIGH) {
+    held = false;
+    releaseMs = millis();
+    if (!longFired) setEnabled(!deviceEnabled);
+  } else if (!longFired && millis() - pressMs >= BUTTON_LONG_PRESS_MS) {
+    longFired = true;
+    selectPreset(presetNext(activePreset));
+  }
+}
+
+void serviceNetwork() {
+  serviceBoot();
+  serviceSelfTest();
+  
+  if (bootPhase > BOOT_WIFI_BEGIN) wifiManagerLoop();
+  
+  // Handle web server - MUST be called frequently
+  if (bootPhase > BOOT_WEB_START) {
+    serviceSync();   // first, so packets are timestamped promptly
+    server.handleClient();
+    ElegantOTA.loop();
+  }
+  publishEvents();
+  storeLoop();
+  #ifdef OTA_TEST
+  otaTestLoop();
+  #endif
+  
+  serviceButton();
   
   #ifdef DEBUG
   static unsigned long lastDebug = 0;
   if (millis() - lastDebug > 5000) {
-    Serial.printf("Status: %s | LED: %.1fHz@%.0f%% | Mag: %.1fHz@%.0f%% | IP: %s\n", 
+    WifiStatus wifi;
+    wifiManagerGetStatus(wifi);
+    Serial.printf("Status: %s | LED: %.1fHz@%.0f%% | Mag: %.1fHz@%.0f%% | IP: %s | WiFi: %s %d dBm%s\n", 
                   deviceEnabled ? "ON" : "OFF",
                   LED_FREQ, LED_DUTY, MAGNET_FREQ, MAGNET_DUTY,
-                  WiFi.localIP().toString().c_str());
+                  WiFi.localIP().toString().c_str(),
+                  wifiStateName(wifi.state), wifi.rssi, wifi.apActive ? " +AP" : "");
     lastDebug = millis();
   }
   #endif
-  
-  // Minimal delay - don't block web server
-  delay(1);
+}
+
+void networkTask(void *arg) {
+  for (;;) {
+    serviceNetwork();
+    
+    // Minimal delay - don't block web server
+    vTaskDelay(1);
+  }
+}
+
+void loop() {
+  // All work happens in the waveform and network tasks
+  vTaskDelete(NULL);
 }
\ No newline at end of file
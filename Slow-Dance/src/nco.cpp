@@ -0,0 +1,31 @@
+#include "nco.h"
+#include <math.h>
+
+bool ncoTimingFor(double timebaseHz, double freq, double duty, NcoTiming &t) {
+  if (freq <= 0 || timebaseHz <= 0) return false;
+
+  // A period must fit the 32-bit integer part and span at least two ticks.
+  double periodTicks = timebaseHz / freq;
+  if (periodTicks < 2.0 || periodTicks >= 4294967296.0) return false;
+
+  if (duty < 0) duty = 0;
+  if (duty > 100) duty = 100;
+
+  // Below 2^53 a double holds the 32.32 period exactly.
+  nco_fixed_t period = (nco_fixed_t)llround(periodTicks * 4294967296.0);
+  t.highTicks = (nco_fixed_t)llround((double)period * (duty / 100.0));
+  t.lowTicks = period - t.highTicks;
+  return true;
+}
+
+double ncoFrequency(double timebaseHz, const NcoTiming &t) {
+  nco_fixed_t period = t.highTicks + t.lowTicks;
+  if (period == 0) return 0;
+  return timebaseHz * 4294967296.0 / (double)period;
+}
+
+void ncoReset(NcoChannel &ch, uint64_t now, nco_fixed_t delayTicks) {
+  ch.level = false;
+  ch.edgeTicks = now + (delayTicks >> NCO_FRAC_BITS);
+  ch.edgeFrac = (uint32_t)delayTicks;
+}
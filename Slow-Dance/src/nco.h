@@ -0,0 +1,49 @@
+#ifndef NCO_H
+#define NCO_H
+
+#include <stdint.h>
+
+// ============================================
+// Numerically Controlled Oscillator
+// ============================================
+// Every channel is clocked from one shared timebase. Half periods are kept
+// as 32.32 fixed-point timebase ticks and the fractional part of each edge
+// time is carried forward, so individual edges are rounded to a whole tick
+// but the long-run frequency is exact to ~1e-9 Hz. The beat between two
+// channels is therefore exactly the difference of the requested values.
+
+#define NCO_FRAC_BITS 32
+
+typedef uint64_t nco_fixed_t;   // 32.32 timebase ticks
+
+struct NcoTiming {
+  nco_fixed_t highTicks;
+  nco_fixed_t lowTicks;
+};
+
+struct NcoChannel {
+  uint64_t edgeTicks;   // whole tick of the next edge
+  uint32_t edgeFrac;    // fractional tick carried between edges
+  bool level;           // output level after the previous edge
+};
+
+// Split one period of `freq` Hz into high/low times for `duty` percent.
+// Returns false for frequencies the timebase cannot represent.
+bool ncoTimingFor(double timebaseHz, double freq, double duty, NcoTiming &t);
+
+// Frequency actually produced by `t` on a `timebaseHz` clock.
+double ncoFrequency(double timebaseHz, const NcoTiming &t);
+
+// Schedule the first (rising) edge `delayTicks` after `now`, output LOW.
+void ncoReset(NcoChannel &ch, uint64_t now, nco_fixed_t delayTicks);
+
+// Toggle the channel and schedule its next edge. Called from the timer ISR.
+static inline void ncoAdvance(NcoChannel &ch, const NcoTiming &t) {
+  ch.level = !ch.level;
+  nco_fixed_t step = ch.level ? t.highTicks : t.lowTicks;
+  uint64_t frac = (uint64_t)ch.edgeFrac + (uint32_t)step;
+  ch.edgeFrac = (uint32_t)frac;
+  ch.edgeTicks += (step >> NCO_FRAC_BITS) + (frac >> NCO_FRAC_BITS);
+}
+
+#endif // NCO_H
@@ -0,0 +1,63 @@
+#include "ota_test.h"
+#include "config.h"
+
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+
+#define OTA_TEST_SECTOR 4096
+#define OTA_TEST_CHUNK 1024   // written in chunks, like the upload handler
+
+// Network task only
+static const esp_partition_t *partition = NULL;
+static OtaTestStatus status;
+static uint32_t startMs = 0;
+static uint32_t lastSectorMs = 0;
+static uint32_t offset = 0;
+
+bool otaTestStart(uint32_t seconds) {
+  if (status.running) return false;
+  partition = esp_ota_get_next_update_partition(NULL);
+  if (partition == NULL) return false;
+
+  memset(&status, 0, sizeof(status));
+  status.running = true;
+  status.durationMs = seconds * 1000;
+  startMs = millis();
+  lastSectorMs = startMs;
+  offset = 0;
+  return true;
+}
+
+void otaTestLoop() {
+  if (!status.running) return;
+  uint32_t now = millis();
+  status.elapsedMs = now - startMs;
+  if (status.elapsedMs >= status.durationMs) {
+    status.running = false;
+    return;
+  }
+  if (now - lastSectorMs < OTA_TEST_SECTOR_MS) return;
+  lastSectorMs = now;
+
+  static uint8_t chunk[OTA_TEST_CHUNK];
+  memset(chunk, (uint8_t)status.sectors, sizeof(chunk));
+
+  uint32_t t0 = micros();
+  if (esp_partition_erase_range(partition, offset, OTA_TEST_SECTOR) != ESP_OK) {
+    status.running = false;
+    return;
+  }
+  for (uint32_t k = 0; k < OTA_TEST_SECTOR; k += OTA_TEST_CHUNK) {
+    esp_partition_write(partition, offset + k, chunk, OTA_TEST_CHUNK);
+  }
+  uint32_t us = micros() - t0;
+  if (us > status.maxWriteUs) status.maxWriteUs = us;
+
+  status.sectors++;
+  offset += OTA_TEST_SECTOR;
+  if (offset + OTA_TEST_SECTOR > partition->size) offset = 0;
+}
+
+void otaTestGetStatus(OtaTestStatus &s) {
+  s = status;
+}
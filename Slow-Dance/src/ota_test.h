@@ -0,0 +1,30 @@
+#ifndef OTA_TEST_H
+#define OTA_TEST_H
+
+#include <Arduino.h>
+
+// ============================================
+// Simulated OTA Load
+// ============================================
+// Erases and rewrites the idle OTA partition one 4 KB sector every
+// OTA_TEST_SECTOR_MS, which is what an upload does to the flash, so the
+// effect on the edge timing can be read from /api/metrics without
+// flashing anything. The running image and the boot selection are never
+// touched, but whatever was in the idle slot (the previous firmware) is
+// gone afterwards.
+
+struct OtaTestStatus {
+  bool running;
+  uint32_t elapsedMs;
+  uint32_t durationMs;
+  uint32_t sectors;      // sectors rewritten so far
+  uint32_t maxWriteUs;   // longest erase + write of one sector
+};
+
+// Start a run of `seconds`. False if there is no idle OTA partition or a
+// run is already going.
+bool otaTestStart(uint32_t seconds);
+void otaTestLoop();
+void otaTestGetStatus(OtaTestStatus &status);
+
+#endif // OTA_TEST_H
@@ -0,0 +1,79 @@
+#include "presets.h"
+#include "config.h"
+#include "settings_store.h"
+
+static Preset presets[PRESET_COUNT];
+
+// Table layout of STORE_VERSION 1
+struct PresetV1 {
+  char name[PRESET_NAME_LEN];
+  WaveformSettingsV1 settings;
+};
+
+static bool upgradePresets(uint8_t version, const void *old, size_t size, void *data) {
+  if (version != 1 || size != sizeof(PresetV1) * PRESET_COUNT) return false;
+  Preset *table = (Preset *)data;
+  memset(table, 0, sizeof(Preset) * PRESET_COUNT);
+  for (int i = 0; i < PRESET_COUNT; i++) {
+    PresetV1 v1;
+    memcpy(&v1, (const uint8_t *)old + i * sizeof(PresetV1), sizeof(v1));
+    memcpy(table[i].name, v1.name, PRESET_NAME_LEN);
+    if (table[i].name[0] != '\0') storeUpgradeSettings(v1.settings, table[i].settings);
+  }
+  return true;
+}
+
+void presetsBegin() {
+  if (storeAttach(STORE_PRESETS, presets, sizeof(presets), upgradePresets)) {
+    for (int i = 0; i < PRESET_COUNT; i++) {
+      if (presets[i].name[0] == '\0') continue;
+      if (storeClampSettings(presets[i].settings)) storeMarkDirty(STORE_PRESETS);
+    }
+    return;
+  }
+
+  memset(presets, 0, sizeof(presets));
+  strcpy(presets[0].name, "Default");
+  storeDefaults(presets[0].settings);
+}
+
+const Preset *presetGet(int slot) {
+  if (slot < 0 || slot >= PRESET_COUNT || presets[slot].name[0] == '\0') return NULL;
+  return &presets[slot];
+}
+
+bool presetSave(int slot, const char *name, const WaveformSettings &settings) {
+  if (slot < 0 || slot >= PRESET_COUNT || name[0] == '\0') return false;
+  if (strlen(name) >= PRESET_NAME_LEN) return false;
+
+  Preset &p = presets[slot];
+  memset(&p, 0, sizeof(p));
+  strcpy(p.name, name);
+  p.settings = settings;
+  storeMarkDirty(STORE_PRESETS);
+  return true;
+}
+
+bool presetDelete(int slot) {
+  if (!presetGet(slot)) return false;
+  memset(&presets[slot], 0, sizeof(presets[slot]));
+  storeMarkDirty(STORE_PRESETS);
+  return true;
+}
+
+int presetFind(const WaveformSettings &settings) {
+  for (int i = 0; i < PRESET_COUNT; i++) {
+    if (presetGet(i) && memcmp(&presets[i].settings, &settings, sizeof(settings)) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int presetNext(int slot) {
+  for (int n = 1; n <= PRESET_COUNT; n++) {
+    int i = ((slot < 0 ? -1 : slot) + n) % PRESET_COUNT;
+    if (presetGet(i)) return i;
+  }
+  return -1;
+}
@@ -0,0 +1,37 @@
+#ifndef PRESETS_H
+#define PRESETS_H
+
+#include <Arduino.h>
+#include "waveform.h"
+
+// ============================================
+// Preset Bank
+// ============================================
+// Named settings sets (one per flower / object) kept in a fixed table.
+// The whole table is loaded into RAM at boot and persisted through the
+// settings store, so switching presets never touches flash.
+
+#define PRESET_COUNT 8
+#define PRESET_NAME_LEN 16   // including the terminator
+
+struct Preset {
+  char name[PRESET_NAME_LEN];   // empty = unused slot
+  WaveformSettings settings;
+};
+
+// Load the table. A fresh device gets the defaults in slot 0.
+void presetsBegin();
+
+// NULL if `slot` is out of range or unused.
+const Preset *presetGet(int slot);
+
+bool presetSave(int slot, const char *name, const WaveformSettings &settings);
+bool presetDelete(int slot);
+
+// Slot holding exactly these settings, or -1.
+int presetFind(const WaveformSettings &settings);
+
+// Next used slot after `slot`, wrapping around; -1 if the bank is empty.
+int presetNext(int slot);
+
+#endif // PRESETS_H
@@ -0,0 +1,282 @@
+#include "profiler.h"
+#include "config.h"
+#include "waveform.h"
+
+#include <atomic>
+#include <math.h>
+#include <esp_cpu.h>
+
+// ============================================
+// Ring buffer (ISR -> reduction task)
+// ============================================
+
+struct EdgeSample {
+  uint32_t cycles;
+  uint8_t channel;
+};
+
+static EdgeSample ring[PROFILER_RING_SIZE];
+static std::atomic<uint32_t> ringHead(0);   // written by the producer only
+static std::atomic<uint32_t> ringTail(0);   // written by the consumer only
+static std::atomic<uint32_t> droppedEdges(0);
+
+void IRAM_ATTR profilerRecordEdge(uint8_t channel) {
+  uint32_t cycles = esp_cpu_get_cycle_count();
+  uint32_t head = ringHead.load(std::memory_order_relaxed);
+  if (head - ringTail.load(std::memory_order_acquire) >= PROFILER_RING_SIZE) {
+    droppedEdges.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  EdgeSample &s = ring[head & (PROFILER_RING_SIZE - 1)];
+  s.cycles = cycles;
+  s.channel = channel;
+  ringHead.store(head + 1, std::memory_order_release);
+}
+
+// ============================================
+// Reduction
+// ============================================
+
+// The task reduces each pass into a ChannelAccum and BeatAccum of its own
+// with no lock held, then adds them to the shared ones inside statsMux, so
+// the critical section is a short merge whatever the ring held.
+
+struct ChannelAccum {
+  uint32_t periods;
+  double sumErrUs;
+  double sumSqErrUs;
+  float minErrUs;
+  float maxErrUs;
+  uint32_t hist[PROFILER_BINS];
+};
+
+struct BeatAccum {
+  uint32_t windows;
+  float targetHz;
+  float lastHz;
+  double sumErrMilliHz;
+  float maxAbsErrMilliHz;
+  uint32_t hist[PROFILER_BINS];
+};
+
+// Per channel state carried from edge to edge, profiler task only
+struct ChannelTrack {
+  bool haveLast;
+  uint32_t lastCycles;
+
+  // Beat window
+  uint32_t windowPeriods;
+  uint64_t windowCycles;
+};
+
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static ChannelAccum accum[PROFILER_CHANNELS];
+static BeatAccum beat;
+static uint32_t totalEdges = 0;
+static uint32_t resetMs = 0;
+static uint32_t resetCount = 0;   // bumped by profilerReset()
+
+// Profiler task only
+static ChannelTrack track[PROFILER_CHANNELS];
+static float targetHz = 0;
+static uint32_t windowStartMs = 0;
+
+static int binFor(double value, double binWidth) {
+  int bin = (int)floor(value / binWidth) + PROFILER_BINS / 2;
+  if (bin < 0) return 0;
+  if (bin >= PROFILER_BINS) return PROFILER_BINS - 1;
+  return bin;
+}
+
+static void clearWindow() {
+  for (int i = 0; i < PROFILER_CHANNELS; i++) {
+    track[i].windowPeriods = 0;
+    track[i].windowCycles = 0;
+  }
+  windowStartMs = millis();
+}
+
+static void reduceEdge(const EdgeSample &s, const double expectedCycles[], double cyclesPerUs,
+                       ChannelAccum pass[]) {
+  ChannelTrack &t = track[s.channel];
+  if (!t.haveLast) {
+    t.haveLast = true;
+    t.lastCycles = s.cycles;
+    return;
+  }
+
+  uint32_t delta = s.cycles - t.lastCycles;
+  t.lastCycles = s.cycles;
+
+  // A gap of more than two periods means the output was stopped; resync.
+  if (delta > 2 * expectedCycles[s.channel]) return;
+
+  ChannelAccum &a = pass[s.channel];
+  double errUs = ((double)delta - expectedCycles[s.channel]) / cyclesPerUs;
+  if (a.periods == 0 || errUs < a.minErrUs) a.minErrUs = errUs;
+  if (a.periods == 0 || errUs > a.maxErrUs) a.maxErrUs = errUs;
+  a.periods++;
+  a.sumErrUs += errUs;
+  a.sumSqErrUs += errUs * errUs;
+  a.hist[binFor(errUs * 1000.0, PROFILER_PERIOD_BIN_NS)]++;
+
+  t.windowPeriods++;
+  t.windowCycles += delta;
+}
+
+static void closeBeatWindow(double cyclesPerUs, BeatAccum &pass) {
+  ChannelTrack &led = track[PROFILER_LED];
+  ChannelTrack &mag = track[PROFILER_MAGNET];
+  if (led.windowPeriods == 0 || mag.windowPeriods == 0) return;
+
+  double cpuHz = cyclesPerUs * 1e6;
+  double ledHz = led.windowPeriods * cpuHz / (double)led.windowCycles;
+  double magHz = mag.windowPeriods * cpuHz / (double)mag.windowCycles;
+  double errMilliHz = (ledHz - magHz - targetHz) * 1000.0;
+
+  pass.windows++;
+  pass.lastHz = ledHz - magHz;
+  pass.sumErrMilliHz += errMilliHz;
+  if (fabs(errMilliHz) > pass.maxAbsErrMilliHz) pass.maxAbsErrMilliHz = fabs(errMilliHz);
+  pass.hist[binFor(errMilliHz * 1000.0, PROFILER_BEAT_BIN_UHZ)]++;
+}
+
+// Add a pass to the shared stats. Inside statsMux.
+static void mergePass(const ChannelAccum pass[], const BeatAccum &passBeat, uint32_t edges) {
+  for (int i = 0; i < PROFILER_CHANNELS; i++) {
+    const ChannelAccum &p = pass[i];
+    ChannelAccum &a = accum[i];
+    if (p.periods == 0) continue;
+    if (a.periods == 0 || p.minErrUs < a.minErrUs) a.minErrUs = p.minErrUs;
+    if (a.periods == 0 || p.maxErrUs > a.maxErrUs) a.maxErrUs = p.maxErrUs;
+    a.periods += p.periods;
+    a.sumErrUs += p.sumErrUs;
+    a.sumSqErrUs += p.sumSqErrUs;
+    for (int b = 0; b < PROFILER_BINS; b++) a.hist[b] += p.hist[b];
+  }
+
+  beat.targetHz = targetHz;
+  if (passBeat.windows) {
+    beat.windows += passBeat.windows;
+    beat.lastHz = passBeat.lastHz;
+    beat.sumErrMilliHz += passBeat.sumErrMilliHz;
+    if (passBeat.maxAbsErrMilliHz > beat.maxAbsErrMilliHz) beat.maxAbsErrMilliHz = passBeat.maxAbsErrMilliHz;
+    for (int b = 0; b < PROFILER_BINS; b++) beat.hist[b] += passBeat.hist[b];
+  }
+  totalEdges += edges;
+}
+
+static void profilerTask(void *arg) {
+  portENTER_CRITICAL(&statsMux);
+  uint32_t seenResets = resetCount;
+  portEXIT_CRITICAL(&statsMux);
+  clearWindow();
+
+  for (;;) {
+    WaveformStatus wave;
+    waveformGetStatus(wave);
+    double cyclesPerUs = getCpuFrequencyMhz();
+    double expected[PROFILER_CHANNELS];
+    expected[PROFILER_LED] = cyclesPerUs * 1e6 / wave.ledHz;
+    expected[PROFILER_MAGNET] = cyclesPerUs * 1e6 / wave.magnetHz;
+
+    uint32_t tail = ringTail.load(std::memory_order_relaxed);
+    uint32_t head = ringHead.load(std::memory_order_acquire);
+
+    if ((float)wave.beatHz != targetHz) {
+      targetHz = wave.beatHz;
+      clearWindow();
+    }
+    ChannelAccum pass[PROFILER_CHANNELS] = {};
+    BeatAccum passBeat = {};
+    uint32_t edges = head - tail;
+    for (; tail != head; tail++) {
+      reduceEdge(ring[tail & (PROFILER_RING_SIZE - 1)], expected, cyclesPerUs, pass);
+    }
+    if (millis() - windowStartMs >= PROFILER_BEAT_WINDOW_MS) {
+      closeBeatWindow(cyclesPerUs, passBeat);
+      clearWindow();
+    }
+
+    portENTER_CRITICAL(&statsMux);
+    bool reset = resetCount != seenResets;
+    seenResets = resetCount;
+    // A reset during the pass: its edges straddle it, so they are dropped
+    if (!reset) mergePass(pass, passBeat, edges);
+    portEXIT_CRITICAL(&statsMux);
+    if (reset) clearWindow();
+
+    ringTail.store(tail, std::memory_order_release);
+    vTaskDelay(pdMS_TO_TICKS(50));
+  }
+}
+
+#if WAVEFORM_BACKEND == WAVEFORM_BACKEND_LEDC
+#include <driver/gpio.h>
+
+// The LEDC outputs have no software edge path; tap the pins instead.
+// attachInterrupt() switches on the pads' input buffer and leaves the
+// output matrix alone, so LEDC keeps driving them. Nothing here may set
+// the pin direction: gpio_set_direction() and pinMode() route the pad
+// back to plain GPIO output and cut LEDC off (env:native never runs this
+// path, so check the strobe on a board after touching it).
+static void IRAM_ATTR onLedEdge() {
+  profilerRecordEdge(PROFILER_LED);
+}
+
+static void IRAM_ATTR onMagnetEdge() {
+  profilerRecordEdge(PROFILER_MAGNET);
+}
+#endif
+
+void profilerBegin() {
+  profilerReset();
+
+  #if WAVEFORM_BACKEND == WAVEFORM_BACKEND_LEDC
+  attachInterrupt(digitalPinToInterrupt(LED_PIN), onLedEdge, RISING);
+  attachInterrupt(digitalPinToInterrupt(MAGNET_PIN), onMagnetEdge, RISING);
+  #endif
+
+  xTaskCreatePinnedToCore(profilerTask, "profiler", 3072, NULL, 1, NULL, NETWORK_CORE);
+}
+
+void profilerSnapshot(ProfilerSnapshot &snapshot) {
+  portENTER_CRITICAL(&statsMux);
+  snapshot.edges = totalEdges;
+  snapshot.dropped = droppedEdges.load(std::memory_order_relaxed);
+  snapshot.sinceMs = resetMs;
+
+  for (int i = 0; i < PROFILER_CHANNELS; i++) {
+    const ChannelAccum &a = accum[i];
+    ProfilerChannelStats &c = snapshot.channel[i];
+    c.periods = a.periods;
+    c.meanErrorUs = a.periods ? a.sumErrUs / a.periods : 0;
+    c.jitterUs = a.periods ? sqrt(a.sumSqErrUs / a.periods) : 0;
+    c.minErrorUs = a.minErrUs;
+    c.maxErrorUs = a.maxErrUs;
+    memcpy(c.hist, a.hist, sizeof(c.hist));
+  }
+
+  ProfilerBeatStats &b = snapshot.beat;
+  b.windows = beat.windows;
+  b.targetHz = beat.targetHz;
+  b.lastHz = beat.lastHz;
+  b.meanErrorMilliHz = beat.windows ? beat.sumErrMilliHz / beat.windows : 0;
+  b.maxAbsErrorMilliHz = beat.maxAbsErrMilliHz;
+  memcpy(b.hist, beat.hist, sizeof(b.hist));
+  portEXIT_CRITICAL(&statsMux);
+}
+
+void profilerReset() {
+  // The profiler task clears its beat window when it sees resetCount move
+  portENTER_CRITICAL(&statsMux);
+  memset(accum, 0, sizeof(accum));
+  float target = beat.targetHz;
+  memset(&beat, 0, sizeof(beat));
+  beat.targetHz = target;
+  totalEdges = 0;
+  droppedEdges.store(0, std::memory_order_relaxed);
+  resetMs = millis();
+  resetCount++;
+  portEXIT_CRITICAL(&statsMux);
+}
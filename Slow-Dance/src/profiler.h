@@ -0,0 +1,59 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+
+// ============================================
+// Edge Timing Profiler
+// ============================================
+// The waveform edge path stamps every rising edge with the CPU cycle
+// counter and pushes it into a lock-free single-producer ring. A low
+// priority task drains the ring and reduces it into period-error and
+// beat-error histograms that /api/metrics serves.
+
+#define PROFILER_LED 0
+#define PROFILER_MAGNET 1
+#define PROFILER_CHANNELS 2
+
+#define PROFILER_RING_SIZE 256        // entries, power of two
+#define PROFILER_BINS 32              // histogram bins, first/last catch overflow
+#define PROFILER_PERIOD_BIN_NS 500    // period error bin width
+#define PROFILER_BEAT_BIN_UHZ 100     // beat error bin width
+#define PROFILER_BEAT_WINDOW_MS 1000  // beat is measured over this window
+
+struct ProfilerChannelStats {
+  uint32_t periods;
+  float meanErrorUs;     // measured minus expected period
+  float jitterUs;        // RMS period error
+  float minErrorUs;
+  float maxErrorUs;
+  uint32_t hist[PROFILER_BINS];
+};
+
+struct ProfilerBeatStats {
+  uint32_t windows;
+  float targetHz;
+  float lastHz;
+  float meanErrorMilliHz;
+  float maxAbsErrorMilliHz;
+  uint32_t hist[PROFILER_BINS];
+};
+
+struct ProfilerSnapshot {
+  uint32_t edges;
+  uint32_t dropped;      // ring overflows
+  uint32_t sinceMs;      // millis() at the last reset
+  ProfilerChannelStats channel[PROFILER_CHANNELS];
+  ProfilerBeatStats beat;
+};
+
+// Start the reduction task (and, for the LEDC backend, the pin taps).
+void profilerBegin();
+
+// Record a rising edge of `channel`. ISR-safe, never blocks.
+void profilerRecordEdge(uint8_t channel);
+
+void profilerSnapshot(ProfilerSnapshot &snapshot);
+void profilerReset();
+
+#endif // PROFILER_H
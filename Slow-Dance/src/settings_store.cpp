@@ -0,0 +1,233 @@
+#include "settings_store.h"
+#include "config.h"
+
+#include <Preferences.h>
+#include <math.h>
+#include <esp_rom_crc.h>
+
+#define STORE_MAGIC 0x534d   // "SM"
+
+struct StoreHeader {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t size;             // payload bytes that follow
+  uint16_t reserved2;
+  uint32_t crc;              // over the header fields above and the payload
+};
+
+struct RecordState {
+  const char *key;
+  void *data;                // RAM copy owned by the module
+  size_t size;
+  StoreUpgrade upgrade;      // from older versions, may be NULL
+  uint32_t committedCrc;     // what flash holds, 0 if nothing
+  bool dirty;
+  unsigned long dirtySinceMs;
+};
+
+static Preferences preferences;
+static WaveformSettings settingsRecord;
+static RecordState records[STORE_RECORDS] = {
+  {"settings", NULL, 0, NULL, 0, false, 0},
+  {"presets", NULL, 0, NULL, 0, false, 0},
+  {"channels", NULL, 0, NULL, 0, false, 0},
+};
+static uint8_t blob[sizeof(StoreHeader) + STORE_MAX_RECORD];
+
+static uint32_t blobCrc(const StoreHeader &header, const void *data) {
+  uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&header, offsetof(StoreHeader, crc));
+  return esp_rom_crc32_le(crc, (const uint8_t *)data, header.size);
+}
+
+// Read a record into its RAM copy. The namespace must be open.
+static bool readRecord(RecordState &rec) {
+  size_t total = preferences.getBytesLength(rec.key);
+  if (total <= sizeof(StoreHeader) || total > sizeof(blob)) return false;
+  if (preferences.getBytes(rec.key, blob, total) != total) return false;
+
+  StoreHeader header;
+  memcpy(&header, blob, sizeof(header));
+  const uint8_t *payload = blob + sizeof(header);
+  if (header.magic != STORE_MAGIC || header.size != total - sizeof(header) ||
+      header.crc != blobCrc(header, payload)) {
+    return false;
+  }
+
+  if (header.version == STORE_VERSION) {
+    if (header.size != rec.size) return false;
+    memcpy(rec.data, payload, rec.size);
+    rec.committedCrc = header.crc;
+    return true;
+  }
+
+  // Older layout: convert, and write it back in the current one
+  if (header.version > STORE_VERSION || !rec.upgrade ||
+      !rec.upgrade(header.version, payload, header.size, rec.data)) {
+    return false;
+  }
+  #ifdef DEBUG
+  Serial.printf("Upgraded %s from version %u\n", rec.key, header.version);
+  #endif
+  storeMarkDirty((StoreRecord)(&rec - records));
+  return true;
+}
+
+static bool commitRecord(RecordState &rec) {
+  StoreHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = STORE_MAGIC;
+  header.version = STORE_VERSION;
+  header.size = rec.size;
+  header.crc = blobCrc(header, rec.data);
+  rec.dirty = false;
+  if (header.crc == rec.committedCrc) return true;
+
+  memcpy(blob, &header, sizeof(header));
+  memcpy(blob + sizeof(header), rec.data, rec.size);
+  size_t total = sizeof(header) + rec.size;
+  preferences.begin(STORE_NAMESPACE, false);
+  bool ok = preferences.putBytes(rec.key, blob, total) == total;
+  preferences.end();
+
+  if (ok) {
+    rec.committedCrc = header.crc;
+    #ifdef DEBUG
+    Serial.printf("Saved %s to flash\n", rec.key);
+    #endif
+  } else {
+    rec.dirty = true;             // retry after another delay
+    rec.dirtySinceMs = millis();
+  }
+  return ok;
+}
+
+void storeDefaults(WaveformSettings &settings) {
+  settings.ledFreq = DEFAULT_LED_FREQ;
+  settings.ledDuty = DEFAULT_LED_DUTY;
+  settings.magnetFreq = DEFAULT_MAGNET_FREQ;
+  settings.magnetDuty = DEFAULT_MAGNET_DUTY;
+  settings.magnet2Duty = DEFAULT_MAGNET2_DUTY;
+  settings.magnet2Phase = DEFAULT_MAGNET2_PHASE;
+}
+
+static bool clampField(float &value, float min, float max, float fallback) {
+  float held = isnan(value) ? fallback : constrain(value, min, max);
+  if (held == value) return false;
+  value = held;
+  return true;
+}
+
+bool storeClampSettings(WaveformSettings &settings) {
+  WaveformSettings defaults;
+  storeDefaults(defaults);
+  bool changed = false;
+  changed |= clampField(settings.ledFreq, FREQ_MIN, FREQ_MAX, defaults.ledFreq);
+  changed |= clampField(settings.ledDuty, LED_DUTY_MIN, LED_DUTY_MAX, defaults.ledDuty);
+  changed |= clampField(settings.magnetFreq, FREQ_MIN, FREQ_MAX, defaults.magnetFreq);
+  changed |= clampField(settings.magnetDuty, MAGNET_DUTY_MIN, MAGNET_DUTY_MAX, defaults.magnetDuty);
+  changed |= clampField(settings.magnet2Duty, MAGNET_DUTY_MIN, MAGNET_DUTY_MAX, defaults.magnet2Duty);
+  changed |= clampField(settings.magnet2Phase, MAGNET_PHASE_MIN, MAGNET_PHASE_MAX, defaults.magnet2Phase);
+  return changed;
+}
+
+// Version 1 drove both magnets with one duty, in phase
+void storeUpgradeSettings(const WaveformSettingsV1 &old, WaveformSettings &settings) {
+  storeDefaults(settings);
+  settings.ledFreq = old.ledFreq;
+  settings.ledDuty = old.ledDuty;
+  settings.magnetFreq = old.magnetFreq;
+  settings.magnetDuty = old.magnetDuty;
+  settings.magnet2Duty = old.magnetDuty;
+  settings.magnet2Phase = 0;
+}
+
+static bool upgradeSettings(uint8_t version, const void *old, size_t size, void *data) {
+  if (version != 1 || size != sizeof(WaveformSettingsV1)) return false;
+  WaveformSettingsV1 v1;
+  memcpy(&v1, old, sizeof(v1));
+  storeUpgradeSettings(v1, *(WaveformSettings *)data);
+  return true;
+}
+
+// Settings written by older firmware as one float per key
+static bool migrateLegacy(WaveformSettings &settings) {
+  if (!preferences.isKey("led_freq")) return false;
+  storeDefaults(settings);
+  settings.ledFreq = preferences.getFloat("led_freq", DEFAULT_LED_FREQ);
+  settings.magnetFreq = preferences.getFloat("mag_freq", DEFAULT_MAGNET_FREQ);
+  settings.ledDuty = preferences.getFloat("led_duty", DEFAULT_LED_DUTY);
+  settings.magnetDuty = preferences.getFloat("mag_duty", DEFAULT_MAGNET_DUTY);
+  settings.magnet2Duty = settings.magnetDuty;
+  preferences.remove("led_freq");
+  preferences.remove("mag_freq");
+  preferences.remove("led_duty");
+  preferences.remove("mag_duty");
+  return true;
+}
+
+bool storeBegin(WaveformSettings &settings) {
+  RecordState &rec = records[STORE_SETTINGS];
+  rec.data = &settingsRecord;
+  rec.size = sizeof(settingsRecord);
+  rec.upgrade = upgradeSettings;
+
+  preferences.begin(STORE_NAMESPACE, false);
+  bool found = readRecord(rec);
+  bool migrated = !found && migrateLegacy(settingsRecord);
+  preferences.end();
+
+  // The CRC only vouches for the bytes: hold the values to the API's
+  // ranges, and store them back that way
+  if ((found || migrated) && storeClampSettings(settingsRecord)) {
+    DEBUG_PRINT("Stored settings out of range, clamped");
+    storeMarkDirty(STORE_SETTINGS);
+  }
+
+  if (migrated) {
+    DEBUG_PRINT("Migrated legacy settings");
+    commitRecord(rec);
+  } else if (!found) {
+    storeDefaults(settingsRecord);
+  }
+  settings = settingsRecord;
+  return found || migrated;
+}
+
+void storeUpdate(const WaveformSettings &settings) {
+  settingsRecord = settings;
+  storeMarkDirty(STORE_SETTINGS);
+}
+
+bool storeAttach(StoreRecord record, void *data, size_t size, StoreUpgrade upgrade) {
+  RecordState &rec = records[record];
+  if (size > STORE_MAX_RECORD) return false;
+  rec.data = data;
+  rec.size = size;
+  rec.upgrade = upgrade;
+
+  preferences.begin(STORE_NAMESPACE, true);
+  bool found = readRecord(rec);
+  preferences.end();
+  return found;
+}
+
+void storeMarkDirty(StoreRecord record) {
+  records[record].dirty = true;
+  records[record].dirtySinceMs = millis();
+}
+
+void storeLoop() {
+  for (int i = 0; i < STORE_RECORDS; i++) {
+    RecordState &rec = records[i];
+    if (rec.dirty && millis() - rec.dirtySinceMs >= STORE_COMMIT_DELAY_MS) {
+      commitRecord(rec);
+    }
+  }
+}
+
+void storeFlush() {
+  for (int i = 0; i < STORE_RECORDS; i++) {
+    if (records[i].dirty) commitRecord(records[i]);
+  }
+}
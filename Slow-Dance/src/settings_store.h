@@ -0,0 +1,72 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include <Arduino.h>
+#include "waveform.h"
+
+// ============================================
+// Settings Persistence
+// ============================================
+// Changes are taken into RAM immediately and written to NVS later. Each
+// record is a single versioned blob with a CRC. Writes are debounced, so
+// a burst of edits from the UI costs one flash write. A commit that
+// would store the bytes already in flash is skipped.
+
+#define STORE_NAMESPACE "slowmo"
+#define STORE_VERSION 2
+#define STORE_COMMIT_DELAY_MS 5000   // quiet time before a commit
+#define STORE_MAX_RECORD 512         // bytes of payload per record
+
+enum StoreRecord {
+  STORE_SETTINGS,
+  STORE_PRESETS,
+  STORE_CHANNELS,
+  STORE_RECORDS
+};
+
+// WaveformSettings as stored by STORE_VERSION 1, before the second magnet
+// had its own duty and phase
+struct WaveformSettingsV1 {
+  float ledFreq;
+  float ledDuty;
+  float magnetFreq;
+  float magnetDuty;
+};
+
+// Convert a record stored by an older STORE_VERSION (`size` payload bytes
+// at `old`) into the current layout at `data`. Returns false if that
+// version cannot be converted; the record then starts from scratch.
+typedef bool (*StoreUpgrade)(uint8_t version, const void *old, size_t size, void *data);
+
+// Factory defaults from config.h.
+void storeDefaults(WaveformSettings &settings);
+
+// Hold `settings` to the ranges the settings API accepts; a NaN takes the
+// default. For values read back from flash. Returns true if any changed.
+bool storeClampSettings(WaveformSettings &settings);
+
+// Settings as stored by STORE_VERSION 1, completed with the defaults.
+void storeUpgradeSettings(const WaveformSettingsV1 &old, WaveformSettings &settings);
+
+// Load the stored settings into `settings`. Falls back to the legacy
+// per-value keys (and migrates them), then to the defaults. Returns false
+// if nothing valid was found.
+bool storeBegin(WaveformSettings &settings);
+
+// Record new settings in RAM; they are committed after the debounce.
+void storeUpdate(const WaveformSettings &settings);
+
+// Attach a module-owned RAM table to a record and fill it from flash.
+// The table must stay valid; after changing it call storeMarkDirty().
+// Returns false (table untouched) if no valid copy was stored. A copy from
+// an older STORE_VERSION is passed through `upgrade` and rewritten.
+bool storeAttach(StoreRecord record, void *data, size_t size, StoreUpgrade upgrade = NULL);
+void storeMarkDirty(StoreRecord record);
+
+// Commit records whose debounce has expired. Call from the network task.
+void storeLoop();
+
+// Commit pending changes now (e.g. before a reboot).
+void storeFlush();
+
+#endif // SETTINGS_STORE_H
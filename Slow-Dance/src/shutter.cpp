@@ -0,0 +1,222 @@
+#include "shutter.h"
+#include "config.h"
+
+#include <math.h>
+#include <driver/gpio.h>
+#include <driver/mcpwm_cap.h>
+#include <soc/mcpwm_periph.h>
+#include <esp_rom_gpio.h>
+
+// The LED capture channel is created first on its own capture timer, so
+// it is channel 0 of MCPWM group 0
+#define SHUTTER_GROUP 0
+#define SHUTTER_LED_CAPTURE 0
+
+static portMUX_TYPE shutterMux = portMUX_INITIALIZER_UNLOCKED;
+static ShutterStatus status;
+
+// Written by the capture ISR, inside shutterMux
+static uint32_t triggerCap = 0;      // capture clock
+static uint32_t triggerPeriodSum = 0;
+static uint32_t triggerPeriods = 0;  // periods summed since the last step
+static uint32_t ledCap = 0;
+static bool haveTrigger = false;
+static bool haveLed = false;
+
+// Waveform task only
+static bool started = false;
+static uint32_t captureHz = 0;
+static uint32_t lastTriggerMs = 0;
+static uint32_t lastStepMs = 0;
+static double periodCap = 0;         // smoothed trigger period, capture ticks
+static double integralHz = 0;
+static uint8_t inLock = 0;           // consecutive steps within SHUTTER_LOCK_DEG
+static float lockedLedHz = 0;        // output while active
+static float lockedMagnetHz = 0;
+
+static bool IRAM_ATTR onLedCapture(mcpwm_cap_channel_handle_t channel,
+                                   const mcpwm_capture_event_data_t *edata, void *arg) {
+  portENTER_CRITICAL_ISR(&shutterMux);
+  ledCap = edata->cap_value;
+  haveLed = true;
+  portEXIT_CRITICAL_ISR(&shutterMux);
+  return false;
+}
+
+static bool IRAM_ATTR onTriggerCapture(mcpwm_cap_channel_handle_t channel,
+                                       const mcpwm_capture_event_data_t *edata, void *arg) {
+  portENTER_CRITICAL_ISR(&shutterMux);
+  if (haveTrigger) {
+    triggerPeriodSum += edata->cap_value - triggerCap;
+    triggerPeriods++;
+  }
+  triggerCap = edata->cap_value;
+  haveTrigger = true;
+  portEXIT_CRITICAL_ISR(&shutterMux);
+  return false;
+}
+
+static bool captureChannel(mcpwm_cap_timer_handle_t timer, int pin, mcpwm_capture_event_cb_t cb) {
+  mcpwm_cap_channel_handle_t channel = NULL;
+  mcpwm_capture_channel_config_t config = {};
+  config.gpio_num = pin;
+  config.prescale = 1;
+  config.flags.pos_edge = true;
+  config.flags.pull_up = pin >= 0;
+  mcpwm_capture_event_callbacks_t callbacks = {};
+  callbacks.on_cap = cb;
+  return mcpwm_new_capture_channel(timer, &config, &channel) == ESP_OK &&
+         mcpwm_capture_channel_register_event_callbacks(channel, &callbacks, NULL) == ESP_OK &&
+         mcpwm_capture_channel_enable(channel) == ESP_OK;
+}
+
+void shutterBegin() {
+  status.state = SHUTTER_OFF;
+  if (SHUTTER_PIN < 0) return;
+
+  mcpwm_cap_timer_handle_t timer = NULL;
+  mcpwm_capture_timer_config_t config = {};
+  config.group_id = SHUTTER_GROUP;
+  config.clk_src = MCPWM_CAPTURE_CLK_SRC_DEFAULT;
+  if (mcpwm_new_capture_timer(&config, &timer) != ESP_OK ||
+      mcpwm_capture_timer_get_resolution(timer, &captureHz) != ESP_OK) {
+    DEBUG_PRINT("ERROR: Shutter capture timer unavailable");
+    return;
+  }
+
+  // The LED channel gets no GPIO of its own (that would reconfigure the
+  // output pad); the pad's input buffer is switched on and routed to it
+  // through the GPIO matrix, the waveform keeps driving the output. Only
+  // the input enable: gpio_set_direction() would hand the pad back to
+  // plain GPIO output and detach LEDC.
+  if (!captureChannel(timer, -1, onLedCapture) ||
+      !captureChannel(timer, SHUTTER_PIN, onTriggerCapture)) {
+    DEBUG_PRINT("ERROR: Shutter capture channels unavailable");
+    return;
+  }
+  gpio_input_enable((gpio_num_t)LED_PIN);
+  esp_rom_gpio_connect_in_signal(
+      LED_PIN, mcpwm_periph_signals.groups[SHUTTER_GROUP].captures[SHUTTER_LED_CAPTURE].cap_sig,
+      false);
+
+  if (mcpwm_capture_timer_enable(timer) != ESP_OK || mcpwm_capture_timer_start(timer) != ESP_OK) {
+    DEBUG_PRINT("ERROR: Shutter capture timer failed to start");
+    return;
+  }
+  started = true;
+  status.state = SHUTTER_NO_SIGNAL;
+}
+
+// ============================================
+// Lock Loop
+// ============================================
+
+static void setState(ShutterState state) {
+  if (state != SHUTTER_LOCKED && state != SHUTTER_ACQUIRING) {
+    integralHz = 0;
+    inLock = 0;
+  }
+  portENTER_CRITICAL(&shutterMux);
+  status.state = state;
+  portEXIT_CRITICAL(&shutterMux);
+}
+
+bool shutterStep(uint32_t nowMs, const WaveformSettings &requested) {
+  if (!started || nowMs - lastStepMs < SHUTTER_STEP_MS) return false;
+  float dt = (nowMs - lastStepMs) / 1000.0f;
+  lastStepMs = nowMs;
+  bool wasActive = status.state >= SHUTTER_ACQUIRING;
+
+  portENTER_CRITICAL(&shutterMux);
+  uint32_t sum = triggerPeriodSum;
+  uint32_t count = triggerPeriods;
+  uint32_t trigger = triggerCap;
+  uint32_t led = ledCap;
+  bool ledSeen = haveLed;   // the LED flashed since the last step
+  haveLed = false;
+  triggerPeriodSum = 0;
+  triggerPeriods = 0;
+  portEXIT_CRITICAL(&shutterMux);
+
+  // Trigger rate, smoothed over a few steps
+  if (count > 0) {
+    double period = (double)sum / count;
+    double hz = captureHz / period;
+    if (hz >= SHUTTER_MIN_HZ && hz <= SHUTTER_MAX_HZ) {
+      periodCap = periodCap > 0 ? periodCap + (period - periodCap) * 0.25 : period;
+      lastTriggerMs = nowMs;
+    }
+  }
+  if (periodCap <= 0 || nowMs - lastTriggerMs >= SHUTTER_TIMEOUT_MS) {
+    periodCap = 0;
+    setState(SHUTTER_NO_SIGNAL);
+    return wasActive;
+  }
+
+  double triggerHz = captureHz / periodCap;
+  int multiple = (int)lround(requested.ledFreq / triggerHz);
+  if (multiple < 1) multiple = 1;
+  double targetHz = triggerHz * multiple;
+  double beatHz = requested.ledFreq - requested.magnetFreq;
+  if (targetHz < FREQ_MIN || targetHz > FREQ_MAX ||
+      targetHz - beatHz < FREQ_MIN || targetHz - beatHz > FREQ_MAX) {
+    setState(SHUTTER_OUT_OF_RANGE);
+    return wasActive;
+  }
+
+  // LED rise against the trigger, in LED cycles; any flash of the
+  // multiple may carry the lock
+  double error = 0;
+  if (ledSeen) {
+    double ledPeriod = periodCap / multiple;
+    error = fmod((double)(int32_t)(led - trigger) / ledPeriod - SHUTTER_PHASE_DEG / 360.0, 1.0);
+    if (error > 0.5) error -= 1.0;
+    else if (error <= -0.5) error += 1.0;
+  }
+
+  // A late LED (error > 0) runs faster to catch up
+  integralHz = constrain(integralHz + SHUTTER_INTEGRAL * error * dt, -SHUTTER_PULL_HZ, SHUTTER_PULL_HZ);
+  double correction = constrain(SHUTTER_GAIN * error + integralHz, -SHUTTER_PULL_HZ, SHUTTER_PULL_HZ);
+  lockedLedHz = targetHz + correction;
+  lockedMagnetHz = lockedLedHz - beatHz;
+
+  bool within = ledSeen && fabs(error) * 360.0 <= SHUTTER_LOCK_DEG;
+  inLock = within ? (inLock < SHUTTER_LOCK_STEPS ? inLock + 1 : inLock) : 0;
+  ShutterState state = inLock >= SHUTTER_LOCK_STEPS ? SHUTTER_LOCKED : SHUTTER_ACQUIRING;
+
+  portENTER_CRITICAL(&shutterMux);
+  status.state = state;
+  status.triggerHz = triggerHz;
+  status.multiple = multiple;
+  status.phaseErrDeg = ledSeen ? error * 360.0 : NAN;
+  status.phaseErrUs = ledSeen ? error * 1e6 / lockedLedHz : NAN;
+  status.correctionHz = correction;
+  portEXIT_CRITICAL(&shutterMux);
+  return true;
+}
+
+void shutterApply(WaveformSettings &settings) {
+  if (status.state != SHUTTER_ACQUIRING && status.state != SHUTTER_LOCKED) return;
+  settings.ledFreq = lockedLedHz;
+  settings.magnetFreq = lockedMagnetHz;
+}
+
+bool shutterActive() {
+  return started;
+}
+
+void shutterGetStatus(ShutterStatus &s) {
+  portENTER_CRITICAL(&shutterMux);
+  s = status;
+  portEXIT_CRITICAL(&shutterMux);
+}
+
+const char *shutterStateName(ShutterState state) {
+  switch (state) {
+    case SHUTTER_NO_SIGNAL: return "no signal";
+    case SHUTTER_OUT_OF_RANGE: return "out of range";
+    case SHUTTER_ACQUIRING: return "acquiring";
+    case SHUTTER_LOCKED: return "locked";
+    default: return "off";
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef SHUTTER_H
+#define SHUTTER_H
+
+#include <Arduino.h>
+#include "waveform.h"
+
+// ============================================
+// Camera Shutter Lock
+// ============================================
+// Locks the LED strobe to a camera's frame or shutter trigger on
+// SHUTTER_PIN, so filmed footage has no rolling bands. The LED runs at
+// the whole multiple of the trigger rate nearest its set frequency and
+// its rising edge is held SHUTTER_PHASE_DEG after the trigger; the
+// magnet keeps the set beat, so the motion is unchanged.
+//
+// The MCPWM capture unit timestamps both the trigger and the LED output
+// on one clock, so the phase error is measured in hardware, free of
+// interrupt latency, whichever waveform backend drives the LED. A
+// proportional-integral loop then nudges the LED frequency (and with it
+// the magnet's) to pull the error to zero.
+//
+// Owned by the waveform task; other tasks only read the status.
+
+enum ShutterState {
+  SHUTTER_OFF,          // no SHUTTER_PIN, or the capture unit failed
+  SHUTTER_NO_SIGNAL,    // no trigger in SHUTTER_TIMEOUT_MS or out of range
+  SHUTTER_OUT_OF_RANGE, // no multiple of the trigger fits FREQ_MIN..FREQ_MAX
+  SHUTTER_ACQUIRING,
+  SHUTTER_LOCKED
+};
+
+struct ShutterStatus {
+  ShutterState state;
+  float triggerHz;
+  uint8_t multiple;     // LED flashes per trigger
+  float phaseErrDeg;    // LED rise after the wanted point, of an LED period
+  float phaseErrUs;
+  float correctionHz;   // pull applied on top of the trigger multiple
+};
+
+// Call after waveformBegin(): the LED pad has to be an output already.
+void shutterBegin();
+
+// Run the loop at `nowMs` against the `requested` (unlocked) settings.
+// Returns true when the settings going out have changed and need to be
+// published again, i.e. on every step while the lock is active and once
+// when it is released.
+bool shutterStep(uint32_t nowMs, const WaveformSettings &requested);
+
+// Replace the frequencies in `settings` with the locked ones, if active.
+void shutterApply(WaveformSettings &settings);
+
+// True while the loop wants to be stepped every SHUTTER_STEP_MS.
+bool shutterActive();
+
+void shutterGetStatus(ShutterStatus &status);
+const char *shutterStateName(ShutterState state);
+
+#endif // SHUTTER_H
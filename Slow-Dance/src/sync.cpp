@@ -0,0 +1,227 @@
+#include "sync.h"
+#include "config.h"
+#include "sync_protocol.h"
+#include "waveform.h"
+
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <math.h>
+
+#if SYNC_ROLE != SYNC_OFF && WAVEFORM_BACKEND != WAVEFORM_BACKEND_ISR
+#error "SYNC_ROLE needs WAVEFORM_BACKEND_ISR"
+#endif
+
+#define SYNC_TICKS_PER_US (WAVEFORM_TIMEBASE_HZ / 1000000.0)
+#define SYNC_PERIOD_TOLERANCE 1e-4   // relative, well above any crystal error
+
+static portMUX_TYPE syncMux = portMUX_INITIALIZER_UNLOCKED;
+static SyncStatus status;
+
+// Network task only
+static WiFiUDP udp;
+static bool started = false;
+static uint16_t seq = 0;
+static unsigned long lastSendMs = 0;
+static unsigned long lastHeardMs = 0;
+static IPAddress leaderIp;
+static SyncServo servo;
+static double appliedPpm = 0;
+static bool trimDue = false;
+
+static void send(const SyncPacket &p, IPAddress to) {
+  udp.beginPacket(to, SYNC_PORT);
+  udp.write((const uint8_t *)&p, sizeof(p));
+  udp.endPacket();
+}
+
+// ============================================
+// Leader
+// ============================================
+
+static void answerRequest(const SyncPacket &request, uint64_t received) {
+  SyncPacket p;
+  syncPacketInit(p, SYNC_RESPONSE, request.seq);
+  p.t1 = request.t1;
+  p.t2 = received;
+  p.t3 = waveformTicks();
+  send(p, udp.remoteIP());
+
+  portENTER_CRITICAL(&syncMux);
+  status.exchanges++;
+  portEXIT_CRITICAL(&syncMux);
+}
+
+static void broadcastPhase() {
+  uint64_t ledRise, magnetRise;
+  double ledPeriod, magnetPeriod;
+  if (!waveformNextRise(WAVEFORM_LED, ledRise, ledPeriod) ||
+      !waveformNextRise(WAVEFORM_MAGNET, magnetRise, magnetPeriod)) {
+    return;   // stopped: nothing to line up with
+  }
+  SyncPacket p;
+  syncPacketInit(p, SYNC_PHASE, seq++);
+  p.ledRise = ledRise;
+  p.magnetRise = magnetRise;
+  p.ledPeriod = ledPeriod;
+  p.magnetPeriod = magnetPeriod;
+  send(p, IPAddress(255, 255, 255, 255));
+}
+
+// ============================================
+// Follower
+// ============================================
+
+static void dropLock() {
+  syncServoReset(servo);
+  portENTER_CRITICAL(&syncMux);
+  status.locked = false;
+  status.aligned = false;
+  portEXIT_CRITICAL(&syncMux);
+}
+
+static void sendRequest() {
+  SyncPacket p;
+  syncPacketInit(p, SYNC_REQUEST, ++seq);
+  p.t1 = waveformTicks();
+  send(p, leaderIp);
+}
+
+static void takeResponse(const SyncPacket &p, uint64_t received) {
+  if (p.seq != seq) return;   // late answer to an earlier request
+  lastHeardMs = millis();
+  if (!syncServoAdd(servo, p.t1, p.t2, p.t3, received,
+                    (int64_t)(SYNC_MAX_DELAY_US * SYNC_TICKS_PER_US))) {
+    return;
+  }
+
+  double ppm = syncServoPpm(servo);
+  if (servo.locked && fabs(ppm - appliedPpm) >= SYNC_TRIM_STEP_PPM) {
+    appliedPpm = ppm;
+    trimDue = true;
+  }
+
+  portENTER_CRITICAL(&syncMux);
+  status.locked = servo.locked;
+  status.offsetUs = syncServoOffsetAt(servo, received) / SYNC_TICKS_PER_US;
+  status.delayUs = servo.lastDelay / SYNC_TICKS_PER_US;
+  status.ppm = ppm;
+  status.exchanges++;
+  portEXIT_CRITICAL(&syncMux);
+}
+
+// Step one channel onto the leader's edge. Returns the remaining error in
+// ticks, NAN if the two do not run at the same frequency.
+static double alignChannel(int index, uint64_t leaderRise, double leaderPeriod, uint64_t now,
+                           bool &stepped) {
+  uint64_t rise;
+  double period;
+  if (!waveformNextRise(index, rise, period)) return NAN;
+  if (fabs(period - leaderPeriod) > leaderPeriod * SYNC_PERIOD_TOLERANCE) return NAN;
+
+  // The leader's edge on our timebase; any later edge of it is as good
+  double expected = (double)leaderRise - syncServoOffsetAt(servo, now);
+  double error = syncWrapPhase((double)rise - expected, period);
+  if (fabs(error) > SYNC_DEADBAND_US * SYNC_TICKS_PER_US) {
+    waveformShiftChannel(index, (int32_t)-lround(error));
+    stepped = true;
+  }
+  return error;
+}
+
+static void takePhase(const SyncPacket &p, IPAddress from) {
+  if (leaderIp != from) {
+    // New or restarted leader: its timebase is unrelated to the old one
+    leaderIp = from;
+    dropLock();
+  }
+  lastHeardMs = millis();
+  if (!servo.locked) return;
+
+  bool stepped = false;
+  uint64_t now = waveformTicks();
+  double led = alignChannel(WAVEFORM_LED, p.ledRise, p.ledPeriod, now, stepped);
+  double magnet = alignChannel(WAVEFORM_MAGNET, p.magnetRise, p.magnetPeriod, now, stepped);
+
+  portENTER_CRITICAL(&syncMux);
+  status.settingsMatch = !isnan(led) && !isnan(magnet);
+  status.ledErrUs = led / SYNC_TICKS_PER_US;
+  status.magnetErrUs = magnet / SYNC_TICKS_PER_US;
+  status.aligned = status.settingsMatch && !stepped;
+  if (stepped) status.steps++;
+  status.leaderIp = (uint32_t)leaderIp;
+  portEXIT_CRITICAL(&syncMux);
+}
+
+// ============================================
+// Public
+// ============================================
+
+void syncBegin() {
+  status.role = SYNC_ROLE;
+  syncServoReset(servo);
+  #if SYNC_ROLE != SYNC_OFF
+  // Modem sleep holds frames back for up to a beacon interval
+  WiFi.setSleep(false);
+  started = udp.begin(SYNC_PORT);
+  DEBUG_PRINT(started ? "Sync: listening" : "ERROR: Sync port unavailable");
+  #endif
+}
+
+void syncLoop() {
+  if (!started) return;
+
+  // Timestamp first: any delay before it reads as path delay
+  int len;
+  while ((len = udp.parsePacket()) > 0) {
+    uint64_t received = waveformTicks();
+    SyncPacket p;
+    int n = udp.read((uint8_t *)&p, sizeof(p));
+    if (len != n || !syncPacketValid(p, n)) continue;
+
+    if (SYNC_ROLE == SYNC_LEADER && p.type == SYNC_REQUEST) answerRequest(p, received);
+    else if (SYNC_ROLE == SYNC_FOLLOWER && p.type == SYNC_RESPONSE) takeResponse(p, received);
+    else if (SYNC_ROLE == SYNC_FOLLOWER && p.type == SYNC_PHASE) takePhase(p, udp.remoteIP());
+  }
+
+  unsigned long now = millis();
+  if (SYNC_ROLE == SYNC_LEADER) {
+    if (now - lastSendMs >= SYNC_PHASE_MS) {
+      lastSendMs = now;
+      broadcastPhase();
+    }
+    return;
+  }
+
+  if ((uint32_t)leaderIp == 0) return;
+  if (now - lastHeardMs >= SYNC_TIMEOUT_MS) {
+    DEBUG_PRINT("Sync: leader lost");
+    leaderIp = IPAddress();
+    dropLock();
+    return;
+  }
+  if (now - lastSendMs >= SYNC_REQUEST_MS) {
+    lastSendMs = now;
+    sendRequest();
+  }
+}
+
+bool syncTakeTrim(double &ppm) {
+  if (!trimDue) return false;
+  trimDue = false;
+  ppm = appliedPpm;
+  return true;
+}
+
+void syncGetStatus(SyncStatus &s) {
+  portENTER_CRITICAL(&syncMux);
+  s = status;
+  portEXIT_CRITICAL(&syncMux);
+}
+
+const char *syncRoleName(uint8_t role) {
+  switch (role) {
+    case SYNC_LEADER: return "leader";
+    case SYNC_FOLLOWER: return "follower";
+    default: return "off";
+  }
+}
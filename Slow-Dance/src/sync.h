@@ -0,0 +1,47 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <Arduino.h>
+
+// ============================================
+// Multi-Unit Sync
+// ============================================
+// Keeps several sculptures strobing in lockstep over UDP (SYNC_PORT). One
+// unit is built as SYNC_LEADER, the others as SYNC_FOLLOWER; all need the
+// ISR backend and the same settings.
+//
+// The leader answers timing requests and broadcasts its next LED and
+// magnet rising edges every SYNC_PHASE_MS. A follower finds the leader
+// from those broadcasts, tracks the offset and frequency error between the
+// two timebases (sync_protocol.h), trims its waveform rate to match and
+// steps its LED and magnet edges onto the leader's whenever they are more
+// than SYNC_DEADBAND_US apart.
+//
+// Runs on the network task. Rate trims have to go through the waveform
+// task; syncTakeTrim() hands them over.
+
+struct SyncStatus {
+  uint8_t role;          // SYNC_OFF / SYNC_LEADER / SYNC_FOLLOWER
+  bool locked;           // follower: offset and rate known
+  bool aligned;          // follower: edges within the deadband
+  bool settingsMatch;    // follower: leader runs the same frequencies
+  uint32_t leaderIp;     // follower: 0 until the leader was heard
+  float offsetUs;        // leader - local timebase
+  float delayUs;         // round trip of the best recent exchange
+  float ppm;             // leader clock rate relative to ours
+  float ledErrUs;        // local - leader edge time at the last broadcast
+  float magnetErrUs;
+  uint32_t exchanges;    // leader: requests answered; follower: responses used
+  uint32_t steps;        // follower: phase corrections applied
+};
+
+void syncBegin();
+void syncLoop();
+
+// Follower: a new rate trim (ppm, for waveformTrim()) is due.
+bool syncTakeTrim(double &ppm);
+
+void syncGetStatus(SyncStatus &status);
+const char *syncRoleName(uint8_t role);
+
+#endif // SYNC_H
@@ -0,0 +1,88 @@
+#include "sync_protocol.h"
+
+#include <math.h>
+#include <string.h>
+
+bool syncPacketValid(const SyncPacket &p, int len) {
+  return len == (int)sizeof(SyncPacket) && p.magic == SYNC_MAGIC &&
+         p.version == SYNC_VERSION && p.type >= SYNC_REQUEST && p.type <= SYNC_PHASE;
+}
+
+void syncPacketInit(SyncPacket &p, SyncPacketType type, uint16_t seq) {
+  memset(&p, 0, sizeof(p));
+  p.magic = SYNC_MAGIC;
+  p.version = SYNC_VERSION;
+  p.type = type;
+  p.seq = seq;
+}
+
+void syncServoReset(SyncServo &s) {
+  memset(&s, 0, sizeof(s));
+}
+
+// Least-squares line through the filtered estimates. x is taken relative
+// to the oldest point so the doubles keep their precision.
+static void refit(SyncServo &s) {
+  uint64_t x0 = s.pointLocal[s.head];
+  int64_t y0 = s.pointOffset[s.head];
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (int k = 0; k < s.points; k++) {
+    int i = (s.head + k) % SYNC_POINTS;
+    double x = (double)(s.pointLocal[i] - x0);
+    double y = (double)(s.pointOffset[i] - y0);
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+  }
+  double n = s.points;
+  double mx = sx / n;
+  double my = sy / n;
+  double var = sxx - sx * mx;
+  s.slope = s.points >= 2 && var > 0 ? (sxy - sx * my) / var : 0;
+  s.local0 = x0 + (uint64_t)mx;
+  s.offset0 = (double)y0 + my;
+  s.locked = s.points >= SYNC_MIN_POINTS;
+}
+
+bool syncServoAdd(SyncServo &s, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4,
+                  int64_t maxDelay) {
+  int64_t delay = (int64_t)(t4 - t1) - (int64_t)(t3 - t2);
+  if (delay < 0 || delay > maxDelay) return false;
+  int64_t offset = ((int64_t)(t2 - t1) + (int64_t)(t3 - t4)) / 2;
+
+  if (s.count == 0 || delay < s.bestDelay) {
+    s.bestDelay = delay;
+    s.bestOffset = offset;
+    s.bestLocal = t1 + (t4 - t1) / 2;
+  }
+  if (++s.count < SYNC_WINDOW) return false;
+
+  int i = (s.head + s.points) % SYNC_POINTS;
+  if (s.points == SYNC_POINTS) {
+    s.head = (s.head + 1) % SYNC_POINTS;
+  } else {
+    s.points++;
+  }
+  s.pointLocal[i] = s.bestLocal;
+  s.pointOffset[i] = s.bestOffset;
+  s.lastDelay = s.bestDelay;
+  s.count = 0;
+  refit(s);
+  return true;
+}
+
+double syncServoOffsetAt(const SyncServo &s, uint64_t local) {
+  return s.offset0 + s.slope * (double)(int64_t)(local - s.local0);
+}
+
+double syncServoPpm(const SyncServo &s) {
+  return s.slope * 1e6;
+}
+
+double syncWrapPhase(double error, double period) {
+  error = fmod(error, period);
+  if (error > period / 2) error -= period;
+  else if (error <= -period / 2) error += period;
+  return error;
+}
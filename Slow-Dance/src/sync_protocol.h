@@ -0,0 +1,95 @@
+#ifndef SYNC_PROTOCOL_H
+#define SYNC_PROTOCOL_H
+
+#include <stdint.h>
+
+// ============================================
+// Multi-Unit Sync Protocol
+// ============================================
+// Wire format and clock servo, kept free of Arduino and network code so
+// they build on the host as well. All times are ticks of the waveform
+// timebase (WAVEFORM_TIMEBASE_HZ) of the unit that took them.
+//
+// A follower measures its offset to the leader with two-way exchanges:
+// it sends REQUEST at t1 (own clock), the leader receives it at t2 and
+// answers at t3 (leader clock), the follower receives the RESPONSE at t4.
+//   offset = ((t2 - t1) + (t3 - t4)) / 2   (leader - follower)
+//   delay  = (t4 - t1) - (t3 - t2)         (round trip on the air)
+// WiFi latency varies by milliseconds, but the fastest exchanges are
+// nearly symmetric, so each window of exchanges keeps only the one with
+// the lowest delay. A line fitted through those gives the offset at any
+// time and its slope the frequency error between the two crystals.
+//
+// The leader also broadcasts PHASE: the tick of its next LED and magnet
+// rising edges and their periods, which followers line their own up with.
+
+#define SYNC_MAGIC 0x59534453UL   // "SDSY"
+#define SYNC_VERSION 1
+
+#define SYNC_WINDOW 32        // exchanges per filtered estimate
+#define SYNC_POINTS 64        // filtered estimates in the rate fit
+#define SYNC_MIN_POINTS 8     // before the servo reports lock
+
+enum SyncPacketType : uint8_t {
+  SYNC_REQUEST = 1,
+  SYNC_RESPONSE = 2,
+  SYNC_PHASE = 3
+};
+
+struct __attribute__((packed)) SyncPacket {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint16_t seq;
+  uint64_t t1;          // REQUEST / RESPONSE: follower send time
+  uint64_t t2;          // RESPONSE: leader receive time
+  uint64_t t3;          // RESPONSE: leader send time
+  uint64_t ledRise;     // PHASE: leader's next LED rising edge
+  uint64_t magnetRise;  // PHASE: leader's next magnet rising edge
+  double ledPeriod;     // PHASE: ticks
+  double magnetPeriod;
+};
+
+// Validates magic, version and type against the received length.
+bool syncPacketValid(const SyncPacket &p, int len);
+void syncPacketInit(SyncPacket &p, SyncPacketType type, uint16_t seq);
+
+struct SyncServo {
+  // Exchange window being collected
+  uint8_t count;
+  int64_t bestDelay;
+  int64_t bestOffset;
+  uint64_t bestLocal;
+
+  // Filtered estimates, oldest first from `head`
+  uint64_t pointLocal[SYNC_POINTS];
+  int64_t pointOffset[SYNC_POINTS];
+  uint8_t points;
+  uint8_t head;
+
+  // offset(local) = offset0 + slope * (local - local0)
+  uint64_t local0;
+  double offset0;
+  double slope;
+  int64_t lastDelay;
+  bool locked;
+};
+
+void syncServoReset(SyncServo &s);
+
+// Add one exchange (t1, t4 local; t2, t3 leader). Exchanges slower than
+// `maxDelay` ticks are dropped. Returns true when a window completed and
+// the estimate was refitted.
+bool syncServoAdd(SyncServo &s, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4,
+                  int64_t maxDelay);
+
+// Leader minus local clock at local tick `local`.
+double syncServoOffsetAt(const SyncServo &s, uint64_t local);
+
+// How much faster the leader's clock runs than ours, in ppm.
+double syncServoPpm(const SyncServo &s);
+
+// `error` reduced to (-period / 2, period / 2].
+double syncWrapPhase(double error, double period);
+
+#endif // SYNC_PROTOCOL_H
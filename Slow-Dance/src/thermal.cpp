@@ -0,0 +1,85 @@
+#include "thermal.h"
+#include "config.h"
+
+#include <math.h>
+
+#define THERMAL_LIMIT_STEP 0.5f   // limit is quantised to avoid republishing every step
+
+static portMUX_TYPE thermalMux = portMUX_INITIALIZER_UNLOCKED;
+#define THERMAL_COILS 2
+
+static float coilC[THERMAL_COILS] = {THERMAL_AMBIENT_C, THERMAL_AMBIENT_C};
+static float dutyLimit = 100.0f;
+static float lastDuty = 0.0f;   // of the hotter coil
+static bool paused = false;
+static double dutySeconds = 0.0;
+static uint32_t lastMs = 0;
+
+void thermalBegin(uint32_t nowMs) {
+  lastMs = nowMs;
+}
+
+float thermalUpdate(uint32_t nowMs, float duty, float duty2) {
+  float dt = (nowMs - lastMs) / 1000.0f;
+  lastMs = nowMs;
+
+  const float duties[THERMAL_COILS] = {duty, duty2};
+  float decay = 1.0f - expf(-dt / THERMAL_TAU_S);
+  float next[THERMAL_COILS];
+  int hot = 0;
+  for (int i = 0; i < THERMAL_COILS; i++) {
+    float target = THERMAL_AMBIENT_C + THERMAL_RISE_C * duties[i] / 100.0f;
+    next[i] = coilC[i] + (target - coilC[i]) * decay;
+    if (next[i] > next[hot]) hot = i;
+  }
+  float c = next[hot];
+
+  bool p = paused;
+  if (c >= THERMAL_MAX_C) p = true;
+  else if (p && c <= THERMAL_RESUME_C) p = false;
+
+  float limit = 100.0f;
+  if (c > THERMAL_DERATE_C) {
+    limit = 100.0f * (THERMAL_MAX_C - c) / (THERMAL_MAX_C - THERMAL_DERATE_C);
+    limit = floorf(limit / THERMAL_LIMIT_STEP) * THERMAL_LIMIT_STEP;
+    if (limit < 1.0f) limit = 1.0f;
+  }
+
+  portENTER_CRITICAL(&thermalMux);
+  for (int i = 0; i < THERMAL_COILS; i++) coilC[i] = next[i];
+  paused = p;
+  dutyLimit = limit;
+  lastDuty = duties[hot];
+  dutySeconds += (duty + duty2) / 200.0 * dt;   // averaged over both coils
+  portEXIT_CRITICAL(&thermalMux);
+  return limit;
+}
+
+bool thermalPaused() {
+  return paused;
+}
+
+void thermalGetStatus(ThermalStatus &status) {
+  portENTER_CRITICAL(&thermalMux);
+  float c = coilC[0] > coilC[1] ? coilC[0] : coilC[1];
+  float duty = lastDuty;
+  double onSeconds = dutySeconds;
+  status.dutyLimit = dutyLimit;
+  status.paused = paused;
+  portEXIT_CRITICAL(&thermalMux);
+
+  status.coilC = c;
+  status.dutyHours = onSeconds / 3600.0;
+  status.energyWh = onSeconds / 3600.0 * THERMAL_MAGNET_WATTS;
+
+  // Solve the exponential approach for the time at which it crosses the
+  // derate threshold
+  float target = THERMAL_AMBIENT_C + THERMAL_RISE_C * duty / 100.0f;
+  if (c >= THERMAL_DERATE_C) {
+    status.budgetS = 0;
+  } else if (target <= THERMAL_DERATE_C) {
+    status.budgetS = -1;
+  } else {
+    status.budgetS = THERMAL_TAU_S * logf((target - c) / (target - THERMAL_DERATE_C));
+  }
+}
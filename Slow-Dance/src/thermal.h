@@ -0,0 +1,38 @@
+#ifndef THERMAL_H
+#define THERMAL_H
+
+#include <Arduino.h>
+
+// ============================================
+// Magnet Thermal Model
+// ============================================
+// There is no temperature sensor on the coils, so their temperature is
+// estimated with a first-order model per coil: each settles towards
+// ambient + THERMAL_RISE_C x its duty with time constant THERMAL_TAU_S.
+// The hotter coil sets the limit, which applies to both.
+// Above THERMAL_DERATE_C the allowed magnet duty falls linearly to zero
+// at THERMAL_MAX_C. Reaching THERMAL_MAX_C pauses the magnets until the
+// estimate is back below THERMAL_RESUME_C.
+//
+// The waveform task owns the model; other tasks only read its status.
+
+struct ThermalStatus {
+  float coilC;          // estimated temperature of the hotter coil
+  float dutyLimit;      // highest magnet duty currently allowed, percent
+  bool paused;
+  float budgetS;        // time to THERMAL_DERATE_C at the present duty, -1 = never
+  float dutyHours;      // magnet on-time since boot (duty x time)
+  float energyWh;       // electrical energy into the coils since boot
+};
+
+void thermalBegin(uint32_t nowMs);
+
+// Advance the model to `nowMs`, assuming the two coils ran at `duty` and
+// `duty2` (percent) since the previous call. Returns the duty limit to
+// apply from now on.
+float thermalUpdate(uint32_t nowMs, float duty, float duty2);
+
+bool thermalPaused();
+void thermalGetStatus(ThermalStatus &status);
+
+#endif // THERMAL_H
@@ -0,0 +1,234 @@
+#include "timeline.h"
+#include "config.h"
+
+#include <math.h>
+
+#define TIMELINE_MAX_DURATION_MS 3600000UL
+
+// Values a segment ramps between
+struct TimelinePoint {
+  float beatHz;
+  float ledDuty;
+  float magnetDuty;
+};
+
+static portMUX_TYPE timelineMux = portMUX_INITIALIZER_UNLOCKED;
+static Timeline staged;
+static TimelineStatus status;
+
+// Playback state, waveform task only
+static Timeline playing;
+static TimelinePoint from;
+static WaveformSettings base;   // LED frequency and other fields held fixed
+static uint32_t segmentStartMs;
+static uint8_t keyIndex;
+
+// ============================================
+// Parsing
+// ============================================
+
+static bool readNumber(JsonReader &r, float &value, double min, double max, const char *what) {
+  if (jsonNext(r) != JSON_NUMBER || r.number < min || r.number > max) {
+    jsonFail(r, what);
+    return false;
+  }
+  value = r.number;
+  return true;
+}
+
+// Missing duties (NAN) hold the previous value
+static bool parseKeyframe(JsonReader &r, Keyframe &k) {
+  bool haveDuration = false;
+  k.beatHz = NAN;
+  k.ledDuty = NAN;
+  k.magnetDuty = NAN;
+  k.ease = EASE_LINEAR;
+
+  while (jsonNext(r) == JSON_KEY) {
+    if (jsonStringIs(r, "beat")) {
+      if (!readNumber(r, k.beatHz, -TIMELINE_MAX_BEAT_HZ, TIMELINE_MAX_BEAT_HZ,
+                      "beat out of range")) return false;
+    } else if (jsonStringIs(r, "ledDuty")) {
+      if (!readNumber(r, k.ledDuty, LED_DUTY_MIN, LED_DUTY_MAX,
+                      "ledDuty out of range")) return false;
+    } else if (jsonStringIs(r, "magDuty")) {
+      if (!readNumber(r, k.magnetDuty, MAGNET_DUTY_MIN, MAGNET_DUTY_MAX,
+                      "magDuty out of range")) return false;
+    } else if (jsonStringIs(r, "ms")) {
+      float ms;
+      if (!readNumber(r, ms, 0, TIMELINE_MAX_DURATION_MS, "ms out of range")) return false;
+      k.durationMs = (uint32_t)ms;
+      haveDuration = true;
+    } else if (jsonStringIs(r, "ease")) {
+      jsonNext(r);
+      if (r.token == JSON_STRING && jsonStringIs(r, "step")) k.ease = EASE_STEP;
+      else if (r.token == JSON_STRING && jsonStringIs(r, "linear")) k.ease = EASE_LINEAR;
+      else if (r.token == JSON_STRING && jsonStringIs(r, "smooth")) k.ease = EASE_SMOOTH;
+      else {
+        jsonFail(r, "ease must be step, linear or smooth");
+        return false;
+      }
+    } else {
+      jsonFail(r, "unknown keyframe key");
+      return false;
+    }
+  }
+  if (r.token != JSON_OBJECT_END) return false;
+  if (!haveDuration) {
+    jsonFail(r, "keyframe needs ms");
+    return false;
+  }
+  return true;
+}
+
+bool timelineParse(JsonReader &r, const char *json, size_t len, Timeline &timeline) {
+  uint32_t totalMs = 0;
+  memset(&timeline, 0, sizeof(timeline));
+  jsonBegin(r, json, len);
+
+  if (jsonNext(r) != JSON_OBJECT_BEGIN) {
+    jsonFail(r, "expected object");
+    return false;
+  }
+  while (jsonNext(r) == JSON_KEY) {
+    if (jsonStringIs(r, "loop")) {
+      jsonNext(r);
+      if (r.token != JSON_TRUE && r.token != JSON_FALSE) {
+        jsonFail(r, "loop must be true or false");
+        return false;
+      }
+      timeline.loop = r.token == JSON_TRUE;
+    } else if (jsonStringIs(r, "keyframes")) {
+      if (jsonNext(r) != JSON_ARRAY_BEGIN) {
+        jsonFail(r, "keyframes must be an array");
+        return false;
+      }
+      while (jsonNext(r) == JSON_OBJECT_BEGIN) {
+        if (timeline.count == TIMELINE_MAX_KEYFRAMES) {
+          jsonFail(r, "too many keyframes");
+          return false;
+        }
+        Keyframe &k = timeline.keys[timeline.count++];
+        if (!parseKeyframe(r, k)) return false;
+        totalMs += k.durationMs;
+      }
+      if (r.token != JSON_ARRAY_END) {
+        jsonFail(r, "expected keyframe object");
+        return false;
+      }
+    } else {
+      jsonFail(r, "unknown key");
+      return false;
+    }
+  }
+  if (r.token == JSON_OBJECT_END) jsonNext(r);
+  if (r.token != JSON_END) return false;
+
+  if (timeline.count == 0) {
+    jsonFail(r, "no keyframes");
+    return false;
+  }
+  if (timeline.loop && totalMs == 0) {
+    jsonFail(r, "a looping timeline needs a duration");
+    return false;
+  }
+  return true;
+}
+
+// ============================================
+// Playback
+// ============================================
+
+static void setStatus(bool active) {
+  portENTER_CRITICAL(&timelineMux);
+  status.playing = active;
+  status.index = keyIndex;
+  status.count = playing.count;
+  status.loop = playing.loop;
+  portEXIT_CRITICAL(&timelineMux);
+}
+
+static TimelinePoint resolve(const Keyframe &k, const TimelinePoint &prev) {
+  TimelinePoint p;
+  p.beatHz = isnan(k.beatHz) ? prev.beatHz : k.beatHz;
+  p.ledDuty = isnan(k.ledDuty) ? prev.ledDuty : k.ledDuty;
+  p.magnetDuty = isnan(k.magnetDuty) ? prev.magnetDuty : k.magnetDuty;
+  return p;
+}
+
+static void emit(const TimelinePoint &p, WaveformSettings &out) {
+  out = base;
+  out.ledDuty = p.ledDuty;
+  out.magnetFreq = constrain(base.ledFreq - p.beatHz, FREQ_MIN, FREQ_MAX);
+  out.magnetDuty = p.magnetDuty;
+}
+
+void timelineStage(const Timeline &timeline) {
+  portENTER_CRITICAL(&timelineMux);
+  staged = timeline;
+  portEXIT_CRITICAL(&timelineMux);
+}
+
+void timelinePlay(const WaveformSettings &start, uint32_t nowMs) {
+  portENTER_CRITICAL(&timelineMux);
+  playing = staged;
+  portEXIT_CRITICAL(&timelineMux);
+
+  base = start;
+  from.beatHz = start.ledFreq - start.magnetFreq;
+  from.ledDuty = start.ledDuty;
+  from.magnetDuty = start.magnetDuty;
+  segmentStartMs = nowMs;
+  keyIndex = 0;
+  setStatus(playing.count > 0);
+}
+
+void timelineStop() {
+  if (status.playing) setStatus(false);
+}
+
+bool timelineStep(uint32_t nowMs, WaveformSettings &out) {
+  if (!status.playing) return false;
+
+  // Advance past finished segments (more than one if the task was late)
+  bool advanced = false;
+  while (nowMs - segmentStartMs >= playing.keys[keyIndex].durationMs) {
+    segmentStartMs += playing.keys[keyIndex].durationMs;
+    from = resolve(playing.keys[keyIndex], from);
+    advanced = true;
+    if (++keyIndex == playing.count) {
+      if (!playing.loop) {
+        // Hold the final keyframe
+        keyIndex--;
+        setStatus(false);
+        emit(from, out);
+        return true;
+      }
+      keyIndex = 0;
+    }
+  }
+  if (advanced) setStatus(true);
+
+  const Keyframe &k = playing.keys[keyIndex];
+  TimelinePoint to = resolve(k, from);
+  float t = (float)(nowMs - segmentStartMs) / k.durationMs;
+  float e;
+  switch (k.ease) {
+    case EASE_STEP: e = 1.0f; break;
+    case EASE_SMOOTH: e = t * t * (3.0f - 2.0f * t); break;
+    default: e = t; break;
+  }
+
+  TimelinePoint p;
+  p.beatHz = from.beatHz + (to.beatHz - from.beatHz) * e;
+  p.ledDuty = from.ledDuty + (to.ledDuty - from.ledDuty) * e;
+  p.magnetDuty = from.magnetDuty + (to.magnetDuty - from.magnetDuty) * e;
+  emit(p, out);
+  return true;
+}
+
+void timelineGetStatus(TimelineStatus &s) {
+  portENTER_CRITICAL(&timelineMux);
+  s = status;
+  portEXIT_CRITICAL(&timelineMux);
+}
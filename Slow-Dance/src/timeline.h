@@ -0,0 +1,67 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <Arduino.h>
+#include "json_reader.h"
+#include "waveform.h"
+
+// ============================================
+// Timeline Sequencer
+// ============================================
+// A timeline is a list of keyframes (beat frequency, LED duty, magnet
+// duty) reached over a duration with a chosen easing. The waveform task
+// evaluates it every TIMELINE_STEP_MS and publishes the result, so ramps
+// go through the normal cycle-boundary switch-over and stay
+// phase-continuous. The LED frequency stays at its live value; the beat
+// is produced by moving the magnet frequency.
+
+#define TIMELINE_MAX_KEYFRAMES 32
+#define TIMELINE_STEP_MS 20
+#define TIMELINE_MAX_BEAT_HZ 10.0
+
+enum TimelineEase : uint8_t {
+  EASE_STEP,     // jump to the keyframe, then hold for the duration
+  EASE_LINEAR,
+  EASE_SMOOTH    // smoothstep, no velocity jump at either end
+};
+
+struct Keyframe {
+  float beatHz;
+  float ledDuty;
+  float magnetDuty;
+  uint32_t durationMs;
+  uint8_t ease;
+};
+
+struct Timeline {
+  uint8_t count;
+  bool loop;
+  Keyframe keys[TIMELINE_MAX_KEYFRAMES];
+};
+
+struct TimelineStatus {
+  bool playing;
+  uint8_t index;     // keyframe being approached
+  uint8_t count;
+  bool loop;
+};
+
+// Parse {"loop": bool, "keyframes": [{"beat", "ledDuty", "magDuty", "ms",
+// "ease": "step" | "linear" | "smooth"}, ...]}. On failure the reader
+// holds the error and its offset.
+bool timelineParse(JsonReader &r, const char *json, size_t len, Timeline &timeline);
+
+// Network task: hand a timeline to the waveform task, which picks it up
+// with timelinePlay().
+void timelineStage(const Timeline &timeline);
+
+// Waveform task: start the staged timeline from the live settings, stop
+// it, and evaluate it. timelineStep() returns false when not playing.
+void timelinePlay(const WaveformSettings &from, uint32_t nowMs);
+void timelineStop();
+bool timelineStep(uint32_t nowMs, WaveformSettings &out);
+
+// Any task.
+void timelineGetStatus(TimelineStatus &status);
+
+#endif // TIMELINE_H
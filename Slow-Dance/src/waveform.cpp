@@ -0,0 +1,830 @@
+#include "waveform.h"
+#include "config.h"
+
+#if WAVEFORM_BACKEND == WAVEFORM_BACKEND_LEDC
+
+// ============================================
+// LEDC backend
+// ============================================
+// Both square waves are generated by the LEDC peripheral, so the CPU does no
+// work per edge. Each frequency gets its own LEDC timer; the two magnet
+// outputs share one, each with its own duty and hpoint, so their relative
+// phase is fixed by the hardware.
+
+#include <driver/ledc.h>
+#include <esp_rom_gpio.h>
+#include <soc/ledc_periph.h>
+
+#define LEDC_MODE LEDC_LOW_SPEED_MODE
+#define LEDC_SRC_CLK_HZ 80000000UL   // APB clock
+#define LEDC_DIV_FRAC_BITS 8         // divider is 10.8 fixed point
+#define LEDC_DIV_MAX 0x3FFFFUL
+#define LEDC_RES_MAX 20
+
+#define LEDC_LED_TIMER LEDC_TIMER_0
+#define LEDC_MAGNET_TIMER LEDC_TIMER_1
+#define LEDC_LED_CHANNEL LEDC_CHANNEL_0
+#define LEDC_MAGNET_CHANNEL LEDC_CHANNEL_1
+#define LEDC_MAGNET2_CHANNEL LEDC_CHANNEL_2
+
+#define LEDC_MAGNETS 2
+
+struct LedcParams {
+  uint32_t divider;   // 10.8 fixed point
+  uint32_t duty;      // counts of 2^ledcResBits
+};
+
+// A channel's high time within the period, in counts of 2^ledcResBits.
+// The channel comparators do not wrap around the end of the period, so a
+// window that would is produced as its complement on an inverted output.
+struct LedcWindow {
+  uint32_t hpoint;
+  uint32_t duty;
+  bool invert;
+};
+
+static const ledc_channel_t magnetChannels[LEDC_MAGNETS] = {LEDC_MAGNET_CHANNEL, LEDC_MAGNET2_CHANNEL};
+static const int magnetPins[LEDC_MAGNETS] = {MAGNET_PIN, MAGNET2_PIN};
+
+static uint32_t ledcResBits = 0;
+static LedcParams ledParams;
+static LedcParams magnetParams;
+static uint32_t magnet2Duty = 0;     // counts, at the magnet frequency
+static uint32_t magnet2Phase = 0;    // counts after the first magnet
+static uint32_t magnetHpoint = 0;    // start phase, in counts of 2^ledcResBits
+static LedcWindow magnetWindows[LEDC_MAGNETS];   // as programmed
+static bool running = false;
+static int magnetOverride = WAVEFORM_RELEASE;
+static portMUX_TYPE startMux = portMUX_INITIALIZER_UNLOCKED;
+
+// The duty resolution is fixed once, for the lowest frequency allowed, so a
+// frequency change only rewrites the divider and the duty count stays
+// valid. The remaining divider range still gives frequency steps below
+// 1 mHz around 80 Hz with ~11 bits of duty resolution.
+static uint32_t ledcResolutionFor(double minFreq) {
+  for (uint32_t bits = 1; bits <= LEDC_RES_MAX; bits++) {
+    double div = (double)LEDC_SRC_CLK_HZ * (1UL << LEDC_DIV_FRAC_BITS) /
+                 (minFreq * (double)(1UL << bits));
+    if (div <= LEDC_DIV_MAX) return bits;
+  }
+  return LEDC_RES_MAX;
+}
+
+static uint32_t ledcDutyCounts(float duty) {
+  if (duty <= 0) return 0;
+  if (duty >= 100) return 1UL << ledcResBits;
+  return (uint32_t)((duty / 100.0f) * (1UL << ledcResBits) + 0.5f);
+}
+
+static uint32_t ledcPhaseCounts(float degrees) {
+  return (uint32_t)(degrees / 360.0f * (1UL << ledcResBits) + 0.5f) & ((1UL << ledcResBits) - 1);
+}
+
+static bool ledcParamsFor(float freq, float duty, LedcParams &p) {
+  if (freq <= 0) return false;
+  double div = (double)LEDC_SRC_CLK_HZ * (1UL << LEDC_DIV_FRAC_BITS) /
+               ((double)freq * (double)(1UL << ledcResBits));
+  if (div < (1UL << LEDC_DIV_FRAC_BITS) || div > LEDC_DIV_MAX) return false;
+  p.divider = (uint32_t)(div + 0.5);
+  p.duty = ledcDutyCounts(duty);
+  return true;
+}
+
+static LedcWindow ledcWindowFor(uint32_t phase, uint32_t duty) {
+  uint32_t range = 1UL << ledcResBits;
+  LedcWindow w;
+  phase &= range - 1;
+  w.invert = phase + duty > range;
+  w.hpoint = w.invert ? phase + duty - range : phase;
+  w.duty = w.invert ? range - duty : duty;
+  return w;
+}
+
+static double ledcFrequency(const LedcParams &p) {
+  return (double)LEDC_SRC_CLK_HZ * (1UL << LEDC_DIV_FRAC_BITS) /
+         ((double)p.divider * (double)(1UL << ledcResBits));
+}
+
+static bool ledcConfigTimer(ledc_timer_t timer, const LedcParams &p) {
+  ledc_timer_config_t cfg = {};
+  cfg.speed_mode = LEDC_MODE;
+  cfg.timer_num = timer;
+  cfg.duty_resolution = (ledc_timer_bit_t)ledcResBits;
+  cfg.freq_hz = (uint32_t)ledcFrequency(p);
+  cfg.clk_cfg = LEDC_USE_APB_CLK;
+  if (ledc_timer_config(&cfg) != ESP_OK) return false;
+
+  // ledc_timer_config() only takes whole Hz; program the exact divider.
+  return ledc_timer_set(LEDC_MODE, timer, p.divider, ledcResBits, LEDC_APB_CLK) == ESP_OK;
+}
+
+static bool ledcConfigChannel(int pin, ledc_channel_t channel, ledc_timer_t timer,
+                              uint32_t duty, uint32_t hpoint) {
+  ledc_channel_config_t cfg = {};
+  cfg.gpio_num = pin;
+  cfg.speed_mode = LEDC_MODE;
+  cfg.channel = channel;
+  cfg.intr_type = LEDC_INTR_DISABLE;
+  cfg.timer_sel = timer;
+  cfg.duty = duty;
+  cfg.hpoint = hpoint;
+  return ledc_channel_config(&cfg) == ESP_OK;
+}
+
+static void ledcApplyDuty(ledc_channel_t channel, uint32_t duty, uint32_t hpoint) {
+  ledc_set_duty_with_hpoint(LEDC_MODE, channel, duty, hpoint);
+  ledc_update_duty(LEDC_MODE, channel);
+}
+
+// Duty and hpoint latch at the end of the period; flipping the output
+// inversion takes effect at once, so that one period may be irregular.
+static void ledcApplyWindow(int magnet, const LedcWindow &w) {
+  if (w.invert != magnetWindows[magnet].invert) {
+    esp_rom_gpio_connect_out_signal(magnetPins[magnet],
+                                    ledc_periph_signal[LEDC_MODE].sig_out0_idx + magnetChannels[magnet],
+                                    w.invert, false);
+  }
+  magnetWindows[magnet] = w;
+  ledcApplyDuty(magnetChannels[magnet], w.duty, w.hpoint);
+}
+
+// Park a magnet channel at `level` as seen on the pin.
+static void ledcStopMagnet(int magnet, int level) {
+  ledc_stop(LEDC_MODE, magnetChannels[magnet], level ^ magnetWindows[magnet].invert);
+}
+
+// ledc_stop() parks a channel at a fixed level; a duty update restarts it.
+static void ledcApplyMagnets() {
+  if (magnetOverride == WAVEFORM_RELEASE) {
+    ledcApplyWindow(0, ledcWindowFor(magnetHpoint, magnetParams.duty));
+    ledcApplyWindow(1, ledcWindowFor(magnetHpoint + magnet2Phase, magnet2Duty));
+  } else {
+    ledcStopMagnet(0, magnetOverride);
+    ledcStopMagnet(1, magnetOverride);
+  }
+}
+
+bool waveformBegin(const WaveformSettings &settings) {
+  ledcResBits = ledcResolutionFor(WAVEFORM_MIN_FREQ);
+  if (!ledcParamsFor(settings.ledFreq, settings.ledDuty, ledParams) ||
+      !ledcParamsFor(settings.magnetFreq, settings.magnetDuty, magnetParams)) {
+    return false;
+  }
+  magnet2Duty = ledcDutyCounts(settings.magnet2Duty);
+  magnet2Phase = ledcPhaseCounts(settings.magnet2Phase);
+
+  if (!ledcConfigTimer(LEDC_LED_TIMER, ledParams) ||
+      !ledcConfigTimer(LEDC_MAGNET_TIMER, magnetParams)) {
+    return false;
+  }
+
+  // The hpoint delays the magnets' rising edge within their period; with
+  // both timers started from zero together it sets the start phase.
+  magnetHpoint = ledcPhaseCounts(WAVEFORM_START_PHASE_DEG);
+
+  // Channels come up idle; waveformStart() releases them together
+  if (!ledcConfigChannel(LED_PIN, LEDC_LED_CHANNEL, LEDC_LED_TIMER, 0, 0) ||
+      !ledcConfigChannel(MAGNET_PIN, LEDC_MAGNET_CHANNEL, LEDC_MAGNET_TIMER, 0, 0) ||
+      !ledcConfigChannel(MAGNET2_PIN, LEDC_MAGNET2_CHANNEL, LEDC_MAGNET_TIMER, 0, 0)) {
+    return false;
+  }
+  memset(magnetWindows, 0, sizeof(magnetWindows));
+
+  running = false;
+  waveformStart();
+  return true;
+}
+
+// In low-speed mode the divider and duty registers are shadowed by the
+// hardware and only latch at the end of the running period, which gives the
+// same edge-aligned update as the ISR backend's parameter block. Only
+// values that actually changed are written.
+void waveformPublish(const WaveformSettings &settings) {
+  LedcParams led, magnet;
+  if (!ledcParamsFor(settings.ledFreq, settings.ledDuty, led) ||
+      !ledcParamsFor(settings.magnetFreq, settings.magnetDuty, magnet)) {
+    return;
+  }
+  uint32_t duty2 = ledcDutyCounts(settings.magnet2Duty);
+  uint32_t phase2 = ledcPhaseCounts(settings.magnet2Phase);
+  bool magnetsChanged = magnet.duty != magnetParams.duty || duty2 != magnet2Duty ||
+                        phase2 != magnet2Phase;
+
+  if (running) {
+    if (led.divider != ledParams.divider) {
+      ledc_timer_set(LEDC_MODE, LEDC_LED_TIMER, led.divider, ledcResBits, LEDC_APB_CLK);
+    }
+    if (led.duty != ledParams.duty) {
+      ledcApplyDuty(LEDC_LED_CHANNEL, led.duty, 0);
+    }
+    if (magnet.divider != magnetParams.divider) {
+      ledc_timer_set(LEDC_MODE, LEDC_MAGNET_TIMER, magnet.divider, ledcResBits, LEDC_APB_CLK);
+    }
+  }
+
+  ledParams = led;
+  magnetParams = magnet;
+  magnet2Duty = duty2;
+  magnet2Phase = phase2;
+  if (running && magnetsChanged && magnetOverride == WAVEFORM_RELEASE) {
+    ledcApplyMagnets();
+  }
+}
+
+void waveformGetStatus(WaveformStatus &status) {
+  status.ledHz = ledcFrequency(ledParams);
+  status.magnetHz = ledcFrequency(magnetParams);
+  status.beatHz = status.ledHz - status.magnetHz;
+}
+
+// The LEDC timers have no common start trigger. Both are held at zero
+// while the channels are set up and then released back to back with
+// interrupts off, which leaves them a few APB cycles apart (well below a
+// microsecond) on every start.
+void waveformStart() {
+  if (running) return;
+
+  ledc_timer_pause(LEDC_MODE, LEDC_LED_TIMER);
+  ledc_timer_pause(LEDC_MODE, LEDC_MAGNET_TIMER);
+  ledc_timer_set(LEDC_MODE, LEDC_LED_TIMER, ledParams.divider, ledcResBits, LEDC_APB_CLK);
+  ledc_timer_set(LEDC_MODE, LEDC_MAGNET_TIMER, magnetParams.divider, ledcResBits, LEDC_APB_CLK);
+  ledc_timer_rst(LEDC_MODE, LEDC_LED_TIMER);
+  ledc_timer_rst(LEDC_MODE, LEDC_MAGNET_TIMER);
+
+  ledcApplyDuty(LEDC_LED_CHANNEL, ledParams.duty, 0);
+  ledcApplyMagnets();
+
+  portENTER_CRITICAL(&startMux);
+  ledc_timer_resume(LEDC_MODE, LEDC_LED_TIMER);
+  ledc_timer_resume(LEDC_MODE, LEDC_MAGNET_TIMER);
+  portEXIT_CRITICAL(&startMux);
+  running = true;
+}
+
+void waveformStop() {
+  running = false;
+  portENTER_CRITICAL(&startMux);
+  ledc_stop(LEDC_MODE, LEDC_LED_CHANNEL, 0);
+  ledcStopMagnet(0, LOW);
+  ledcStopMagnet(1, LOW);
+  portEXIT_CRITICAL(&startMux);
+}
+
+void waveformOverrideMagnets(int level) {
+  magnetOverride = level;
+  if (running) ledcApplyMagnets();
+}
+
+// The LEDC backend has the built-in channels only
+int waveformChannelCount() {
+  return WAVEFORM_FIRST_EXTRA;
+}
+
+void waveformChannelInfo(int index, WaveformChannelInfo &info) {
+  static const int8_t pins[WAVEFORM_FIRST_EXTRA] = {LED_PIN, MAGNET_PIN, MAGNET2_PIN};
+  info.pin = pins[index];
+  info.leader = index == WAVEFORM_MAGNET2 ? WAVEFORM_MAGNET : -1;
+}
+
+bool waveformPublishChannels(const WaveformChannel *channels, int count) {
+  return count == 0;
+}
+
+double waveformChannelHz(int index) {
+  return ledcFrequency(index == WAVEFORM_LED ? ledParams : magnetParams);
+}
+
+// No shared timebase to align: multi-unit sync needs the ISR backend
+uint64_t waveformTicks() {
+  return 0;
+}
+
+bool waveformNextRise(int index, uint64_t &tick, double &periodTicks) {
+  return false;
+}
+
+void waveformShiftChannel(int index, int32_t ticks) {}
+
+void waveformTrim(double ppm) {}
+
+#else // WAVEFORM_BACKEND_ISR
+
+// ============================================
+// ISR backend
+// ============================================
+// A single general purpose timer is the shared timebase for every channel.
+// It free-runs; the alarm ISR toggles every channel whose edge is due,
+// advances its NCO and re-arms the alarm at the absolute tick of the next
+// edge, so no rounding error accumulates between edges. Any number of
+// channels share the one timer and the one interrupt.
+//
+// New settings arrive through a double-buffered parameter block. The
+// publisher fills the idle slot and then bumps paramSeq; the ISR picks the
+// slot up at a channel's falling edge, i.e. at the end of a full cycle, so
+// the channel never sees half-updated or mid-cycle timing.
+//
+// A follower channel (the second magnet, or an extra channel with a
+// leader) is not a free-running NCO: each rising edge of its leader
+// schedules its next rising edge `phase` later, so the two can never drift
+// apart, whatever the frequency changes.
+//
+// Flash writes (OTA, NVS) switch the flash cache off, and only an
+// interrupt allocated with ESP_INTR_FLAG_IRAM keeps running through them.
+// The timer is claimed through the gptimer driver, but the interrupt is
+// allocated here and the ISR reaches the timer through the inline
+// timer_ll register accessors, so nothing it calls lives in flash. The
+// rest of the hot path stays out of flash too (pins through the GPIO
+// registers, inline NCO steps, integer math only, channel state in
+// DRAM). Edges that still fall due while the interrupt is held off are
+// folded (see onWaveformTimer): the outputs resume on their original
+// phase grid instead of firing a burst of runt pulses.
+
+#include <atomic>
+#include <driver/gptimer.h>
+#include <esp_intr_alloc.h>
+#include <hal/gpio_ll.h>
+#include <hal/timer_ll.h>
+#include <soc/timer_periph.h>
+#include "nco.h"
+#include "profiler.h"
+
+// Edges closer than this are handled in the same interrupt.
+#define WAVEFORM_MIN_LEAD_TICKS (WAVEFORM_TIMEBASE_HZ / 500000)
+
+// Loaded into the claimed timer to find it among the timer groups
+#define WAVEFORM_TIMER_MARK 0x5157AC0DE0ULL
+
+struct ChannelSlot {
+  int8_t pin;      // -1 = no output
+  int8_t leader;   // -1 = own frequency
+};
+
+static const ChannelSlot slots[] = {
+  {LED_PIN, -1},
+  {MAGNET_PIN, -1},
+  {MAGNET2_PIN, WAVEFORM_MAGNET},
+  WAVEFORM_EXTRA_CHANNELS
+};
+#define WAVEFORM_CHANNELS (int)(sizeof(slots) / sizeof(slots[0]))
+static_assert(sizeof(slots) / sizeof(slots[0]) <= WAVEFORM_MAX_CHANNELS,
+              "too many WAVEFORM_EXTRA_CHANNELS");
+static_assert(WAVEFORM_MAX_CHANNELS <= 32, "follower masks are 32 bits");
+
+// Struct of arrays, one entry per channel; the ISR walks them linearly.
+struct WaveformParams {
+  NcoTiming timing[WAVEFORM_MAX_CHANNELS];     // period and duty
+  nco_fixed_t phase[WAVEFORM_MAX_CHANNELS];    // after the leader's rise, or after the start
+  bool enabled[WAVEFORM_MAX_CHANNELS];
+  double timebaseHz;   // the timings were computed against
+};
+
+// The timer the driver gave us, and its registers for the ISR
+static gptimer_handle_t waveTimer = NULL;
+static timg_dev_t *timerHw = NULL;
+static uint32_t timerNum = 0;
+static intr_handle_t timerIntr = NULL;
+static portMUX_TYPE waveMux = portMUX_INITIALIZER_UNLOCKED;
+
+static volatile bool running = false;
+static volatile int magnetOverride = WAVEFORM_RELEASE;
+
+// Channel table, fixed at waveformBegin()
+static int8_t channelPin[WAVEFORM_MAX_CHANNELS];
+static int8_t channelLeader[WAVEFORM_MAX_CHANNELS];
+static uint32_t followers[WAVEFORM_MAX_CHANNELS];   // bit j: channel j follows
+
+// Parameter block: slot (paramSeq & 1) is the latest published one. The
+// publisher assembles the next one in `staged`; paramWriting is the
+// publication being copied into its slot, a seqlock for the ISR's reads.
+static WaveformParams params[2];
+static WaveformParams staged;
+static WaveformChannel extraSettings[WAVEFORM_MAX_CHANNELS];   // indexed from WAVEFORM_FIRST_EXTRA
+static WaveformSettings published;   // last settings, for waveformTrim()
+static double timebaseHz = WAVEFORM_TIMEBASE_HZ;   // nominal timebase, trimmed; publisher only
+static std::atomic<uint32_t> paramSeq(0);
+static std::atomic<uint32_t> paramWriting(0);
+
+// Channel state, owned by the ISR (or by the task inside waveMux)
+static NcoChannel channels[WAVEFORM_MAX_CHANNELS];
+static NcoTiming active[WAVEFORM_MAX_CHANNELS];
+static nco_fixed_t activePhase[WAVEFORM_MAX_CHANNELS];
+static bool live[WAVEFORM_MAX_CHANNELS];
+static uint32_t appliedSeq[WAVEFORM_MAX_CHANNELS];
+static uint64_t pendingRise[WAVEFORM_MAX_CHANNELS];   // follower rise set while still high
+
+// The counter, latched and read. The latch is shared: inside waveMux.
+static inline uint64_t IRAM_ATTR counterNow() {
+  timer_ll_trigger_soft_capture(timerHw, timerNum);
+  return timer_ll_get_counter_value(timerHw, timerNum);
+}
+
+// The hardware disarms the alarm when it fires
+static inline void IRAM_ATTR armAlarm(uint64_t tick) {
+  timer_ll_set_alarm_value(timerHw, timerNum, tick);
+  timer_ll_enable_alarm(timerHw, timerNum, true);
+}
+
+static void IRAM_ATTR writeChannel(int index, bool level) {
+  int pin = channelPin[index];
+  if (pin < 0) return;
+  if ((index == WAVEFORM_MAGNET || index == WAVEFORM_MAGNET2) && magnetOverride != WAVEFORM_RELEASE) {
+    level = magnetOverride;
+  }
+  gpio_ll_set_level(&GPIO, pin, level);
+}
+
+// Take up the latest parameters for a free channel and its followers.
+static inline void IRAM_ATTR applyPending(int index) {
+  uint32_t seq = paramSeq.load(std::memory_order_acquire);
+  if (seq == appliedSeq[index]) return;
+
+  const WaveformParams &p = params[seq & 1];
+  NcoTiming t = p.timing[index];
+  NcoTiming ft[WAVEFORM_MAX_CHANNELS];
+  nco_fixed_t fp[WAVEFORM_MAX_CHANNELS];
+  for (uint32_t m = followers[index]; m; m &= m - 1) {
+    int j = __builtin_ctz(m);
+    ft[j] = p.timing[j];
+    fp[j] = p.phase[j];
+  }
+
+  // The slot is only rewritten two publications later. If that has begun
+  // by now, on either core, the copy may be torn: keep the old timing and
+  // try again next cycle.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (paramWriting.load(std::memory_order_relaxed) - seq >= 2) return;
+
+  active[index] = t;
+  for (uint32_t m = followers[index]; m; m &= m - 1) {
+    int j = __builtin_ctz(m);
+    active[j] = ft[j];
+    activePhase[j] = fp[j];
+  }
+  appliedSeq[index] = seq;
+}
+
+// A leader rose at `edge` + `frac` / 2^32 ticks: schedule its followers.
+static inline void IRAM_ATTR anchorFollowers(int index, uint64_t edge, uint32_t frac) {
+  for (uint32_t m = followers[index]; m; m &= m - 1) {
+    int j = __builtin_ctz(m);
+    if (!live[j]) continue;
+    uint64_t f = (uint64_t)frac + (uint32_t)activePhase[j];
+    uint64_t rise = edge + (activePhase[j] >> NCO_FRAC_BITS) + (f >> NCO_FRAC_BITS);
+    if (channels[j].level) pendingRise[j] = rise;
+    else channels[j].edgeTicks = rise;
+  }
+}
+
+static inline void IRAM_ATTR advanceFollower(int index) {
+  NcoChannel &ch = channels[index];
+  ch.level = !ch.level;
+  if (ch.level) {
+    nco_fixed_t high = active[index].highTicks;
+    ch.edgeTicks += (high + (1ULL << (NCO_FRAC_BITS - 1))) >> NCO_FRAC_BITS;
+  } else {
+    ch.edgeTicks = pendingRise[index];   // UINT64_MAX until the next anchor
+    pendingRise[index] = UINT64_MAX;
+  }
+}
+
+static void IRAM_ATTR onWaveformTimer(void *arg) {
+  timer_ll_clear_intr_status(timerHw, TIMER_LL_EVENT_ALARM(timerNum));
+  if (!running) return;
+
+  portENTER_CRITICAL_ISR(&waveMux);
+  uint64_t now = counterNow();
+  for (;;) {
+    uint64_t next = UINT64_MAX;
+    // Followers come after their leader, so one pass handles both
+    for (int i = 0; i < WAVEFORM_CHANNELS; i++) {
+      NcoChannel &ch = channels[i];
+      if (ch.edgeTicks <= now) {
+        if (channelLeader[i] >= 0) {
+          advanceFollower(i);
+        } else {
+          uint64_t edge = ch.edgeTicks;
+          uint32_t frac = ch.edgeFrac;
+          if (ch.level) applyPending(i);   // falling edge closes the cycle
+          ncoAdvance(ch, active[i]);
+          if (ch.level && followers[i]) anchorFollowers(i, edge, frac);
+        }
+        // An edge whose successor is overdue as well (the interrupt was
+        // held off) is stepped over without touching the pin; the last
+        // overdue one writes the level they add up to.
+        if (ch.edgeTicks > now) {
+          writeChannel(i, ch.level);
+          #ifdef EDGE_PROFILER
+          if (ch.level && i < PROFILER_CHANNELS) profilerRecordEdge(i);
+          #endif
+        }
+      }
+      if (ch.edgeTicks < next) next = ch.edgeTicks;
+    }
+    if (next > now + WAVEFORM_MIN_LEAD_TICKS) {
+      if (next != UINT64_MAX) armAlarm(next);
+      break;
+    }
+    now = counterNow();
+  }
+  portEXIT_CRITICAL_ISR(&waveMux);
+}
+
+static bool channelParamsFor(int index, const WaveformChannel &c, double freq, WaveformParams &p) {
+  p.enabled[index] = c.enabled;
+  if (!ncoTimingFor(timebaseHz, freq, c.duty, p.timing[index])) return false;
+  nco_fixed_t period = p.timing[index].highTicks + p.timing[index].lowTicks;
+  p.phase[index] = (nco_fixed_t)(c.phase / 360.0 * (double)period) % period;
+  return true;
+}
+
+// Fill the built-in channels of `p` from `settings`.
+static bool paramsFor(const WaveformSettings &settings, WaveformParams &p) {
+  WaveformChannel led = {true, settings.ledFreq, settings.ledDuty, 0};
+  WaveformChannel magnet = {true, settings.magnetFreq, settings.magnetDuty, WAVEFORM_START_PHASE_DEG};
+  WaveformChannel magnet2 = {true, settings.magnetFreq, settings.magnet2Duty, settings.magnet2Phase};
+  return channelParamsFor(WAVEFORM_LED, led, led.freq, p) &&
+         channelParamsFor(WAVEFORM_MAGNET, magnet, magnet.freq, p) &&
+         channelParamsFor(WAVEFORM_MAGNET2, magnet2, magnet2.freq, p);
+}
+
+// Fill the extra channels of `p`. Followers take their leader's frequency
+// from `p`, so this must follow any change of a leader.
+static bool extraParamsFor(WaveformParams &p) {
+  for (int i = WAVEFORM_FIRST_EXTRA; i < WAVEFORM_CHANNELS; i++) {
+    const WaveformChannel &c = extraSettings[i - WAVEFORM_FIRST_EXTRA];
+    int leader = channelLeader[i];
+    double freq = leader >= 0 ? ncoFrequency(timebaseHz, p.timing[leader]) : c.freq;
+    if (!channelParamsFor(i, c, freq, p)) return false;
+  }
+  return true;
+}
+
+// A consistent copy of the latest published parameters, for readers on
+// any task: retried while a publication may have torn it (as applyPending).
+static void latestParams(WaveformParams &p) {
+  for (;;) {
+    uint32_t seq = paramSeq.load(std::memory_order_acquire);
+    p = params[seq & 1];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (paramWriting.load(std::memory_order_relaxed) - seq < 2) return;
+  }
+}
+
+static void publishStaged() {
+  staged.timebaseHz = timebaseHz;
+  uint32_t seq = paramSeq.load(std::memory_order_relaxed) + 1;
+  paramWriting.store(seq, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  params[seq & 1] = staged;
+  paramSeq.store(seq, std::memory_order_release);
+}
+
+// Start channel `index` LOW from `start`. Free channels rise `phase` after
+// it, followers wait for their leader. Inside waveMux.
+static void startChannel(int index, uint64_t start, uint32_t seq) {
+  const WaveformParams &p = params[seq & 1];
+  live[index] = p.enabled[index];
+  active[index] = p.timing[index];
+  activePhase[index] = p.phase[index];
+  appliedSeq[index] = seq;
+  pendingRise[index] = UINT64_MAX;
+  ncoReset(channels[index], start, activePhase[index]);
+  if (!live[index] || channelLeader[index] >= 0) channels[index].edgeTicks = UINT64_MAX;
+  writeChannel(index, LOW);
+}
+
+static void armNextEdge() {
+  uint64_t next = UINT64_MAX;
+  for (int i = 0; i < WAVEFORM_CHANNELS; i++) {
+    if (channels[i].edgeTicks < next) next = channels[i].edgeTicks;
+  }
+  if (next != UINT64_MAX) armAlarm(next);
+}
+
+// Restart all channels from one start tick. The relative phase of the free
+// channels is then exact to a tick on every start.
+static void restartChannels() {
+  portENTER_CRITICAL(&waveMux);
+  uint64_t start = counterNow() + WAVEFORM_MIN_LEAD_TICKS;
+  uint32_t seq = paramSeq.load(std::memory_order_acquire);
+  for (int i = 0; i < WAVEFORM_CHANNELS; i++) startChannel(i, start, seq);
+  running = true;
+  armNextEdge();
+  portEXIT_CRITICAL(&waveMux);
+}
+
+// Claim a timer from the driver and take its alarm interrupt over. The
+// driver does not say which timer it gave out, so it is loaded with a mark
+// and looked for; the reload register holds what was loaded, so this
+// reads no counter of a group that may not be clocked.
+static bool claimTimer() {
+  gptimer_config_t config = {};
+  config.clk_src = GPTIMER_CLK_SRC_DEFAULT;
+  config.direction = GPTIMER_COUNT_UP;
+  config.resolution_hz = WAVEFORM_TIMEBASE_HZ;
+  if (gptimer_new_timer(&config, &waveTimer) != ESP_OK) return false;
+  gptimer_set_raw_count(waveTimer, WAVEFORM_TIMER_MARK);
+
+  int group = -1;
+  for (int g = 0; g < SOC_TIMER_GROUPS && group < 0; g++) {
+    for (int t = 0; t < SOC_TIMER_GROUP_TIMERS_PER_GROUP; t++) {
+      if (timer_ll_get_reload_value(TIMER_LL_GET_HW(g), t) == WAVEFORM_TIMER_MARK) {
+        group = g;
+        timerNum = t;
+        break;
+      }
+    }
+  }
+  gptimer_set_raw_count(waveTimer, 0);
+  if (group < 0) {
+    gptimer_del_timer(waveTimer);
+    waveTimer = NULL;
+    return false;
+  }
+  timerHw = TIMER_LL_GET_HW(group);
+
+  int source = timer_group_periph_signals.groups[group].timer_irq_id[timerNum];
+  if (esp_intr_alloc(source, ESP_INTR_FLAG_IRAM, onWaveformTimer, NULL, &timerIntr) != ESP_OK) {
+    gptimer_del_timer(waveTimer);
+    waveTimer = NULL;
+    return false;
+  }
+  timer_ll_enable_intr(timerHw, TIMER_LL_EVENT_ALARM(timerNum), true);
+  gptimer_enable(waveTimer);
+  gptimer_start(waveTimer);
+  return true;
+}
+
+bool waveformBegin(const WaveformSettings &settings) {
+  memset(followers, 0, sizeof(followers));
+  for (int i = 0; i < WAVEFORM_CHANNELS; i++) {
+    channelPin[i] = slots[i].pin;
+    channelLeader[i] = slots[i].leader;
+    int leader = slots[i].leader;
+    // A leader must come first and run at its own frequency
+    if (leader >= i || (leader >= 0 && slots[leader].leader >= 0)) return false;
+    if (leader >= 0) followers[leader] |= 1UL << i;
+    if (channelPin[i] >= 0) digitalWrite(channelPin[i], LOW);
+  }
+
+  // Extra channels start disabled at the default magnet timing
+  memset(&staged, 0, sizeof(staged));
+  for (int i = 0; i < WAVEFORM_CHANNELS - WAVEFORM_FIRST_EXTRA; i++) {
+    extraSettings[i] = {false, DEFAULT_MAGNET_FREQ, DEFAULT_MAGNET_DUTY, 0};
+  }
+  if (!paramsFor(settings, staged) || !extraParamsFor(staged)) {
+    return false;
+  }
+  published = settings;
+  staged.timebaseHz = timebaseHz;
+  params[0] = staged;
+  paramWriting.store(0, std::memory_order_relaxed);
+  paramSeq.store(0, std::memory_order_release);
+
+  if (!claimTimer()) {
+    return false;
+  }
+
+  restartChannels();
+  return true;
+}
+
+void waveformPublish(const WaveformSettings &settings) {
+  WaveformParams next = staged;
+  if (!paramsFor(settings, next) || !extraParamsFor(next)) return;
+  published = settings;
+  staged = next;
+  publishStaged();
+}
+
+bool waveformPublishChannels(const WaveformChannel *extra, int count) {
+  if (count > WAVEFORM_CHANNELS - WAVEFORM_FIRST_EXTRA) return false;
+  WaveformChannel previous[WAVEFORM_MAX_CHANNELS];
+  memcpy(previous, extraSettings, sizeof(previous));
+  memcpy(extraSettings, extra, count * sizeof(WaveformChannel));
+  WaveformParams next = staged;
+  if (!extraParamsFor(next)) {
+    memcpy(extraSettings, previous, sizeof(previous));
+    return false;
+  }
+  staged = next;
+  publishStaged();
+
+  // Channels switched on or off join or leave the schedule right away;
+  // the others pick the new timing up at the end of their cycle.
+  portENTER_CRITICAL(&waveMux);
+  if (running) {
+    uint64_t start = counterNow() + WAVEFORM_MIN_LEAD_TICKS;
+    uint32_t seq = paramSeq.load(std::memory_order_acquire);
+    for (int i = WAVEFORM_FIRST_EXTRA; i < WAVEFORM_CHANNELS; i++) {
+      if (staged.enabled[i] != live[i]) startChannel(i, start, seq);
+    }
+    armNextEdge();
+  }
+  portEXIT_CRITICAL(&waveMux);
+  return true;
+}
+
+void waveformGetStatus(WaveformStatus &status) {
+  WaveformParams p;
+  latestParams(p);
+
+  status.ledHz = ncoFrequency(p.timebaseHz, p.timing[WAVEFORM_LED]);
+  status.magnetHz = ncoFrequency(p.timebaseHz, p.timing[WAVEFORM_MAGNET]);
+  status.beatHz = status.ledHz - status.magnetHz;
+}
+
+int waveformChannelCount() {
+  return WAVEFORM_CHANNELS;
+}
+
+void waveformChannelInfo(int index, WaveformChannelInfo &info) {
+  info.pin = slots[index].pin;
+  info.leader = slots[index].leader;
+}
+
+double waveformChannelHz(int index) {
+  WaveformParams p;
+  latestParams(p);
+  if (!p.enabled[index]) return 0;
+  return ncoFrequency(p.timebaseHz, p.timing[index]);
+}
+
+void waveformStart() {
+  if (waveTimer == NULL) return;
+  restartChannels();
+}
+
+void waveformStop() {
+  portENTER_CRITICAL(&waveMux);
+  running = false;
+  for (int i = 0; i < WAVEFORM_CHANNELS; i++) {
+    if (channelPin[i] >= 0) digitalWrite(channelPin[i], LOW);
+  }
+  portEXIT_CRITICAL(&waveMux);
+}
+
+void waveformOverrideMagnets(int level) {
+  portENTER_CRITICAL(&waveMux);
+  magnetOverride = level;
+  if (running) {
+    writeChannel(WAVEFORM_MAGNET, channels[WAVEFORM_MAGNET].level);
+    writeChannel(WAVEFORM_MAGNET2, channels[WAVEFORM_MAGNET2].level);
+  }
+  portEXIT_CRITICAL(&waveMux);
+}
+
+// ============================================
+// Sync Hooks
+// ============================================
+
+uint64_t waveformTicks() {
+  if (waveTimer == NULL) return 0;
+  portENTER_CRITICAL(&waveMux);
+  uint64_t now = counterNow();
+  portEXIT_CRITICAL(&waveMux);
+  return now;
+}
+
+bool waveformNextRise(int index, uint64_t &tick, double &periodTicks) {
+  portENTER_CRITICAL(&waveMux);
+  const NcoChannel &ch = channels[index];
+  const NcoTiming &t = active[index];
+  bool ok = running && live[index] && ch.edgeTicks != UINT64_MAX;
+  if (ok) {
+    // While high the pending edge is the fall; the rise is a low time later
+    tick = ch.level ? ch.edgeTicks + (t.lowTicks >> NCO_FRAC_BITS) : ch.edgeTicks;
+    periodTicks = (double)(t.highTicks + t.lowTicks) / (double)(1ULL << NCO_FRAC_BITS);
+  }
+  portEXIT_CRITICAL(&waveMux);
+  return ok;
+}
+
+void waveformShiftChannel(int index, int32_t ticks) {
+  if (channelLeader[index] >= 0) return;
+  portENTER_CRITICAL(&waveMux);
+  NcoChannel &ch = channels[index];
+  if (running && live[index] && ch.edgeTicks != UINT64_MAX) {
+    uint64_t earliest = counterNow() + WAVEFORM_MIN_LEAD_TICKS;
+    int64_t edge = (int64_t)ch.edgeTicks + ticks;
+    ch.edgeTicks = edge > (int64_t)earliest ? (uint64_t)edge : earliest;
+    armNextEdge();
+  }
+  portEXIT_CRITICAL(&waveMux);
+}
+
+void waveformTrim(double ppm) {
+  double trimmed = WAVEFORM_TIMEBASE_HZ / (1.0 + ppm * 1e-6);
+  if (trimmed == timebaseHz) return;
+  double previous = timebaseHz;
+  timebaseHz = trimmed;
+  WaveformParams next = staged;
+  if (!paramsFor(published, next) || !extraParamsFor(next)) {
+    timebaseHz = previous;
+    return;
+  }
+  staged = next;
+  publishStaged();
+}
+
+#endif
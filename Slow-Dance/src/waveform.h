@@ -0,0 +1,115 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <Arduino.h>
+
+// ============================================
+// Waveform Generation
+// ============================================
+// Drives the LED strobe (LED_PIN) and the electromagnets (MAGNET_PIN,
+// MAGNET2_PIN) with square waves. The backend is chosen at compile time
+// with WAVEFORM_BACKEND in config.h.
+
+// Frequencies in Hz, duties in percent. The second magnet runs at the
+// magnet frequency with its own duty, its rising edge trailing the first
+// magnet's by magnet2Phase degrees (0 = in phase, 180 = push-pull).
+struct WaveformSettings {
+  float ledFreq;
+  float ledDuty;
+  float magnetFreq;
+  float magnetDuty;
+  float magnet2Duty;
+  float magnet2Phase;
+};
+
+// Create the timers / peripheral channels. Outputs start running, as
+// from waveformStart().
+bool waveformBegin(const WaveformSettings &settings);
+
+// Hand new settings to the running waveform. Never blocks and takes no
+// locks; each channel switches over at the end of its current cycle, so
+// the output stays phase-continuous without runt or stretched pulses.
+// Must only be called from one task at a time.
+void waveformPublish(const WaveformSettings &settings);
+
+// Frequencies actually produced after quantisation to the backend clock.
+struct WaveformStatus {
+  double ledHz;
+  double magnetHz;
+  double beatHz;   // ledHz - magnetHz, the slow-motion speed
+};
+
+void waveformGetStatus(WaveformStatus &status);
+
+// ============================================
+// Channel Table
+// ============================================
+// Channel 0 is the LED, 1 and 2 the magnets; they follow WaveformSettings.
+// The ISR backend schedules further channels from WAVEFORM_EXTRA_CHANNELS
+// on the same timer; the LEDC backend has only the built-in three.
+#define WAVEFORM_LED 0
+#define WAVEFORM_MAGNET 1
+#define WAVEFORM_MAGNET2 2
+#define WAVEFORM_FIRST_EXTRA 3
+
+struct WaveformChannel {
+  bool enabled;
+  float freq;    // Hz, ignored for followers
+  float duty;    // percent
+  float phase;   // degrees after the leader's rising edge, or after the start
+};
+
+struct WaveformChannelInfo {
+  int8_t pin;      // -1 = scheduled without an output
+  int8_t leader;   // -1 = own frequency
+};
+
+int waveformChannelCount();
+void waveformChannelInfo(int index, WaveformChannelInfo &info);
+
+// Publish settings for the extra channels; `channels[0]` is channel
+// WAVEFORM_FIRST_EXTRA. Otherwise as waveformPublish(), except that a
+// channel being switched on or off joins or leaves at once.
+bool waveformPublishChannels(const WaveformChannel *channels, int count);
+
+// Frequency a channel produces, 0 while it is disabled.
+double waveformChannelHz(int index);
+
+// Resume / halt all outputs together. Halted outputs are driven LOW.
+// Every start brings the channels up at the same relative phase: the
+// magnets' first rising edge trails the LED's by WAVEFORM_START_PHASE_DEG
+// of a magnet period, so the motion always resumes from the same pose.
+void waveformStart();
+void waveformStop();
+
+// Hold both magnet outputs at a fixed level (HIGH / LOW), or hand them
+// back to the waveform with WAVEFORM_RELEASE. The LED keeps running and
+// the magnet timing carries on underneath, so it resumes in phase.
+#define WAVEFORM_RELEASE -1
+void waveformOverrideMagnets(int level);
+
+// ============================================
+// Sync Hooks
+// ============================================
+// Used by the multi-unit sync (sync.h) to line this unit's channels up
+// with another's. ISR backend only; the LEDC backend has no shared
+// timebase, reports no edges and ignores corrections.
+
+// Current tick of the waveform timebase (WAVEFORM_TIMEBASE_HZ).
+uint64_t waveformTicks();
+
+// Tick of a channel's next rising edge and its period in ticks. False
+// while the channel is stopped, disabled or waiting for its leader.
+bool waveformNextRise(int index, uint64_t &tick, double &periodTicks);
+
+// Move a free channel's pending edge by `ticks` (positive = later); the
+// current half cycle absorbs the step and its followers move along on the
+// next rising edge.
+void waveformShiftChannel(int index, int32_t ticks);
+
+// Run every channel `ppm` faster (negative = slower) in timebase ticks, so
+// that a unit whose crystal differs produces the same frequencies as the
+// one it follows. Takes effect like waveformPublish(), from the same task.
+void waveformTrim(double ppm);
+
+#endif // WAVEFORM_H
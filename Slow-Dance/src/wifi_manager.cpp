@@ -0,0 +1,148 @@
+#include "wifi_manager.h"
+#include "config.h"
+
+#include <WiFi.h>
+
+// Set by the driver's event task, consumed by wifiManagerLoop()
+static volatile bool gotIp = false;
+static volatile bool linkLost = false;
+static volatile uint8_t lostReason = 0;
+
+static WifiState state = WIFI_STATE_CONNECTING;
+static unsigned long attemptMs = 0;     // start of the current attempt
+static unsigned long retryAtMs = 0;
+static unsigned long downSinceMs = 0;   // station last lost / never up
+static uint32_t backoffMs = WIFI_BACKOFF_MIN_MS;
+static uint32_t reconnects = 0;
+static bool apActive = false;
+
+static void onWifiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      gotIp = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      lostReason = info.wifi_sta_disconnected.reason;
+      linkLost = true;
+      break;
+    default:
+      break;
+  }
+}
+
+static void connect() {
+  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  state = WIFI_STATE_CONNECTING;
+  attemptMs = millis();
+}
+
+static void scheduleRetry() {
+  // Retrying makes the radio scan other channels, which stalls soft-AP
+  // clients; while someone is on the AP retry only rarely.
+  uint32_t delayMs = backoffMs;
+  if (apActive && WiFi.softAPgetStationNum() > 0) delayMs = WIFI_BACKOFF_MAX_MS;
+
+  state = WIFI_STATE_BACKOFF;
+  retryAtMs = millis() + delayMs;
+  backoffMs *= 2;
+  if (backoffMs > WIFI_BACKOFF_MAX_MS) backoffMs = WIFI_BACKOFF_MAX_MS;
+}
+
+static void startAp() {
+  WiFi.mode(WIFI_AP_STA);
+  apActive = WiFi.softAP(WIFI_AP_SSID, WIFI_AP_PASSWORD);
+  #ifdef DEBUG
+  if (apActive) {
+    IPAddress ip = WiFi.softAPIP();
+    Serial.printf("WiFi: fallback AP \"%s\" at http://%u.%u.%u.%u\n",
+                  WIFI_AP_SSID, ip[0], ip[1], ip[2], ip[3]);
+  }
+  #endif
+}
+
+static void stopAp() {
+  WiFi.softAPdisconnect(true);
+  WiFi.mode(WIFI_STA);
+  apActive = false;
+  DEBUG_PRINT("WiFi: fallback AP closed");
+}
+
+void wifiManagerBegin() {
+  WiFi.persistent(false);         // credentials come from config.h, not flash
+  WiFi.setAutoReconnect(false);   // reconnects are paced here
+  WiFi.onEvent(onWifiEvent);
+  WiFi.mode(WIFI_STA);
+  downSinceMs = millis();
+  connect();
+}
+
+void wifiManagerLoop() {
+  unsigned long now = millis();
+
+  if (gotIp) {
+    gotIp = false;
+    state = WIFI_STATE_CONNECTED;
+    backoffMs = WIFI_BACKOFF_MIN_MS;
+    #ifdef DEBUG
+    IPAddress ip = WiFi.localIP();
+    Serial.printf("WiFi: connected, http://%u.%u.%u.%u (%d dBm)\n",
+                  ip[0], ip[1], ip[2], ip[3], WiFi.RSSI());
+    #endif
+  }
+
+  // Losses reported while already backing off come from our own
+  // disconnect() and are not counted twice
+  if (linkLost) {
+    linkLost = false;
+    if (state == WIFI_STATE_CONNECTED) {
+      reconnects++;
+      downSinceMs = now;
+    }
+    if (state != WIFI_STATE_BACKOFF) {
+      #ifdef DEBUG
+      Serial.printf("WiFi: disconnected (reason %u), retry in %lu ms\n",
+                    lostReason, (unsigned long)backoffMs);
+      #endif
+      scheduleRetry();
+    }
+  }
+
+  switch (state) {
+    case WIFI_STATE_CONNECTING:
+      if (now - attemptMs >= WIFI_CONNECT_TIMEOUT_MS) {
+        WiFi.disconnect();
+        scheduleRetry();
+      }
+      break;
+    case WIFI_STATE_BACKOFF:
+      if ((long)(now - retryAtMs) >= 0) connect();
+      break;
+    case WIFI_STATE_CONNECTED:
+      break;
+  }
+
+  if (state != WIFI_STATE_CONNECTED && !apActive && now - downSinceMs >= WIFI_AP_FALLBACK_MS) {
+    startAp();
+  } else if (state == WIFI_STATE_CONNECTED && apActive && WiFi.softAPgetStationNum() == 0) {
+    stopAp();
+  }
+}
+
+void wifiManagerGetStatus(WifiStatus &status) {
+  status.state = state;
+  status.rssi = state == WIFI_STATE_CONNECTED ? WiFi.RSSI() : 0;
+  status.reconnects = reconnects;
+  long retryIn = (long)(retryAtMs - millis());
+  status.retryInMs = state == WIFI_STATE_BACKOFF && retryIn > 0 ? retryIn : 0;
+  status.apActive = apActive;
+  status.apClients = apActive ? WiFi.softAPgetStationNum() : 0;
+}
+
+const char *wifiStateName(WifiState state) {
+  switch (state) {
+    case WIFI_STATE_CONNECTING: return "connecting";
+    case WIFI_STATE_CONNECTED: return "connected";
+    case WIFI_STATE_BACKOFF: return "backoff";
+  }
+  return "unknown";
+}
@@ -0,0 +1,37 @@
+#ifndef WIFI_MANAGER_H
+#define WIFI_MANAGER_H
+
+#include <Arduino.h>
+
+// ============================================
+// WiFi Connection Manager
+// ============================================
+// Keeps the station connected without ever blocking. Driver events only
+// set flags; all decisions are taken in wifiManagerLoop() on the network
+// task. A dropped or failed connection is retried with exponential
+// backoff. If the station stays down for WIFI_AP_FALLBACK_MS, a local
+// soft-AP is opened so the web UI stays reachable; it closes again once
+// the station is back and no client is using it.
+
+enum WifiState {
+  WIFI_STATE_CONNECTING,
+  WIFI_STATE_CONNECTED,
+  WIFI_STATE_BACKOFF      // waiting to retry
+};
+
+struct WifiStatus {
+  WifiState state;
+  int8_t rssi;            // dBm, 0 when not connected
+  uint32_t reconnects;    // connections lost since boot
+  uint32_t retryInMs;     // while in backoff
+  bool apActive;
+  uint8_t apClients;
+};
+
+void wifiManagerBegin();
+void wifiManagerLoop();
+
+void wifiManagerGetStatus(WifiStatus &status);
+const char *wifiStateName(WifiState state);
+
+#endif // WIFI_MANAGER_H
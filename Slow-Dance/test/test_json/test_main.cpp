@@ -0,0 +1,332 @@
+// JSON reader and writer on the host: documents written by json_writer
+// read back unchanged, and mutated or random input is rejected cleanly.
+// Run with `pio test -e native`; building with -fsanitize=address also
+// catches any read past the end of a buffer, as every input is handed
+// over in an allocation of exactly its length, without a terminator.
+//
+// The firmware is not booted: only json_reader, json_writer and the
+// timeline parser built on them are exercised.
+
+#include <unity.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "timeline.h"
+
+#define FUZZ_ROUNDS 20000
+#define FUZZ_MAX_LEN 512
+
+static uint32_t rng;
+
+void setUp() {
+  rng = 2463534242u;
+}
+
+void tearDown() {}
+
+static uint32_t randomBelow(uint32_t n) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng % n;
+}
+
+// Documents the firmware takes, and some that exercise the grammar
+static const char *const SEEDS[] = {
+  "{\"ledFreq\": 80.5, \"ledDuty\": 10, \"magFreq\": 79.8, \"magDuty\": 35}",
+  "{\"action\": \"save\", \"slot\": 1, \"name\": \"Slow \\\"beat\\\"\"}",
+  "{\"loop\": true, \"keyframes\": [{\"beat\": 0.5, \"ms\": 4000, \"ease\": \"smooth\"},"
+  " {\"beat\": -0.25, \"ledDuty\": 12.5, \"magDuty\": 30, \"ms\": 2500, \"ease\": \"step\"}]}",
+  "[0, -0, 1.5e3, -2.25E-2, 1e+2, 123456789012345678901234567890, true, false, null]",
+  "{\"s\": \"\\u00e9\\n\\t\\/\\\\\\b\\f\\r\", \"a\": [[[[[[[1]]]]]]], \"o\": {}}",
+  "\"top\"",
+  "  42  ",
+};
+
+static const char FUZZ_ALPHABET[] = "{}[]:,\"\\ -+.0123456789eEtrufalsn\x01\xff";
+
+// Pull every token of `json`. The reader has to stop within one token per
+// byte and report errors inside the document.
+static JsonToken drain(const char *json, size_t len) {
+  JsonReader r;
+  jsonBegin(r, json, len);
+  char text[16];
+  for (size_t tokens = 0; tokens <= len + 1; tokens++) {
+    JsonToken t = jsonNext(r);
+    if (t == JSON_END) return t;
+    if (t == JSON_ERROR) {
+      TEST_ASSERT_TRUE(r.error != NULL);
+      TEST_ASSERT_TRUE(r.errorPos <= len);
+      TEST_ASSERT_TRUE(jsonNext(r) == JSON_ERROR);
+      return t;
+    }
+    if (t == JSON_NUMBER) TEST_ASSERT_TRUE(isfinite(r.number));
+    if (t == JSON_KEY || t == JSON_STRING) {
+      TEST_ASSERT_TRUE(r.str >= json && r.str + r.strLen <= json + len);
+      jsonCopyString(r, text, sizeof(text));
+    }
+    TEST_ASSERT_TRUE(r.depth <= JSON_MAX_DEPTH);
+  }
+  TEST_FAIL_MESSAGE("reader did not terminate");
+  return JSON_ERROR;
+}
+
+// Run everything that parses request bodies over one input
+static void feed(const char *data, size_t len) {
+  // Exact-size copy: no terminator for the reader to lean on
+  char *json = (char *)malloc(len ? len : 1);
+  memcpy(json, data, len);
+
+  drain(json, len);
+
+  float a = -1, b = -1;
+  const JsonFloatField fields[] = {
+    {"ledFreq", &a, FREQ_MIN, FREQ_MAX},
+    {"ledDuty", &b, LED_DUTY_MIN, LED_DUTY_MAX},
+  };
+  JsonParseError err;
+  int32_t present = jsonParseFloatFields(json, len, fields, 2, err);
+  if (present < 0) {
+    // Nothing is written unless the whole document was accepted
+    TEST_ASSERT_TRUE(a == -1 && b == -1);
+    TEST_ASSERT_TRUE(err.message != NULL);
+    TEST_ASSERT_TRUE(err.offset <= len);
+  } else {
+    TEST_ASSERT_TRUE(!(present & 1) || (a >= FREQ_MIN && a <= FREQ_MAX));
+    TEST_ASSERT_TRUE(!(present & 2) || (b >= LED_DUTY_MIN && b <= LED_DUTY_MAX));
+  }
+
+  JsonReader r;
+  Timeline timeline;
+  if (timelineParse(r, json, len, timeline)) {
+    TEST_ASSERT_TRUE(timeline.count > 0 && timeline.count <= TIMELINE_MAX_KEYFRAMES);
+  }
+  free(json);
+}
+
+// Token by token copy of an accepted document through the writer
+static bool echo(JsonReader &r, JsonWriter &w) {
+  char key[64];
+  char text[64];
+  const char *k = NULL;
+  for (;;) {
+    switch (jsonNext(r)) {
+      case JSON_OBJECT_BEGIN: jsonBeginObject(w, k); break;
+      case JSON_ARRAY_BEGIN: jsonBeginArray(w, k); break;
+      case JSON_OBJECT_END: jsonEndObject(w); break;
+      case JSON_ARRAY_END: jsonEndArray(w); break;
+      case JSON_KEY:
+        jsonCopyString(r, key, sizeof(key));
+        k = key;
+        continue;
+      case JSON_STRING:
+        jsonCopyString(r, text, sizeof(text));
+        jsonAddString(w, k, text);
+        break;
+      case JSON_NUMBER: jsonAddFloat(w, k, r.number, 3); break;
+      case JSON_TRUE: jsonAddBool(w, k, true); break;
+      case JSON_FALSE: jsonAddBool(w, k, false); break;
+      case JSON_NULL: jsonAddFloat(w, k, NAN, 0); break;
+      case JSON_END: return !w.overflow;
+      default: return false;
+    }
+    k = NULL;
+  }
+}
+
+// ============================================
+// Round Trip
+// ============================================
+
+void test_writer_output_reads_back() {
+  static const uint32_t counts[] = {0, 7, 4294967295u};
+  char buf[256];
+  JsonWriter w;
+  jsonWriterBegin(w, buf, sizeof(buf));
+  jsonBeginObject(w);
+  jsonAddFloat(w, "ledFreq", 80.5, 1);
+  jsonAddFloat(w, "beat", -0.0625, 4);
+  jsonAddInt(w, "min", INT32_MIN);
+  jsonAddUInt(w, "max", UINT32_MAX);
+  jsonAddBool(w, "enabled", true);
+  jsonAddString(w, "name", "a \"q\" \\ \n\x01");
+  jsonAddUIntArray(w, "counts", counts, 3);
+  jsonBeginObject(w, "empty");
+  jsonEndObject(w);
+  jsonEndObject(w);
+  TEST_ASSERT_FALSE(w.overflow);
+
+  JsonReader r;
+  jsonBegin(r, buf, w.len);
+  char text[32];
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_OBJECT_BEGIN);
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_KEY && jsonStringIs(r, "ledFreq"));
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_NUMBER && r.number == 80.5);
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_KEY && jsonStringIs(r, "beat"));
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_NUMBER && r.number == -0.0625);
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_KEY && jsonStringIs(r, "min"));
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_NUMBER && r.number == INT32_MIN);
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_KEY && jsonStringIs(r, "max"));
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_NUMBER && r.number == UINT32_MAX);
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_KEY && jsonStringIs(r, "enabled"));
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_TRUE);
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_KEY && jsonStringIs(r, "name"));
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_STRING && jsonCopyString(r, text, sizeof(text)));
+  TEST_ASSERT_EQUAL_STRING("a \"q\" \\ \n\x01", text);
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_KEY && jsonStringIs(r, "counts"));
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_ARRAY_BEGIN);
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_TRUE(jsonNext(r) == JSON_NUMBER && r.number == counts[i]);
+  }
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_ARRAY_END);
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_KEY && jsonStringIs(r, "empty"));
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_OBJECT_BEGIN);
+  TEST_ASSERT_TRUE(jsonSkipValue(r));
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_OBJECT_END);
+  TEST_ASSERT_TRUE(jsonNext(r) == JSON_END);
+}
+
+// Every seed, copied through the writer, reads back as the same tokens
+void test_seeds_round_trip() {
+  for (const char *seed : SEEDS) {
+    char once[512];
+    char twice[512];
+    JsonReader r;
+    JsonWriter w;
+    jsonBegin(r, seed, strlen(seed));
+    jsonWriterBegin(w, once, sizeof(once));
+    TEST_ASSERT_TRUE(echo(r, w));
+
+    jsonBegin(r, once, w.len);
+    jsonWriterBegin(w, twice, sizeof(twice));
+    TEST_ASSERT_TRUE(echo(r, w));
+    TEST_ASSERT_EQUAL_STRING(once, twice);
+  }
+}
+
+void test_settings_fields() {
+  float freq = 0, duty = 0;
+  const JsonFloatField fields[] = {
+    {"ledFreq", &freq, FREQ_MIN, FREQ_MAX},
+    {"ledDuty", &duty, LED_DUTY_MIN, LED_DUTY_MAX},
+  };
+  JsonParseError err;
+  const char *ok = "{\"ledDuty\":12.5,\"ledFreq\":80.4}";
+  TEST_ASSERT_EQUAL_INT(3, jsonParseFloatFields(ok, strlen(ok), fields, 2, err));
+  TEST_ASSERT_TRUE(freq == 80.4f && duty == 12.5f);
+
+  static const char *const bad[] = {
+    "{\"ledFreq\":80,\"ledFreq\":81}",   // duplicate
+    "{\"ledFreq\":\"80\"}",              // not a number
+    "{\"ledFreq\":1e400}",               // not a double
+    "{\"ledFreq\":1e999999}",
+    "{\"ledFreq\":99999999999999999999e300}",
+    "{\"ledDuty\":0}{}",                 // trailing document
+    "{\"ledFreq\":80,}",
+    "{\"other\":1}",
+  };
+  for (const char *json : bad) {
+    freq = duty = 0;
+    TEST_ASSERT_EQUAL_INT(-1, jsonParseFloatFields(json, strlen(json), fields, 2, err));
+    TEST_ASSERT_TRUE(freq == 0 && duty == 0);
+  }
+}
+
+// ============================================
+// Fuzzing
+// ============================================
+
+// Every prefix of every seed: truncated bodies must fail, not overrun
+void test_truncated_seeds() {
+  for (const char *seed : SEEDS) {
+    size_t len = strlen(seed);
+    for (size_t n = 0; n < len; n++) feed(seed, n);
+  }
+}
+
+// Seeds with bytes flipped, inserted, deleted and duplicated
+void test_mutated_seeds() {
+  char buf[FUZZ_MAX_LEN];
+  for (int round = 0; round < FUZZ_ROUNDS; round++) {
+    const char *seed = SEEDS[randomBelow(sizeof(SEEDS) / sizeof(SEEDS[0]))];
+    size_t len = strlen(seed);
+    memcpy(buf, seed, len);
+    for (int m = 1 + randomBelow(4); m > 0; m--) {
+      size_t at = randomBelow(len + 1);
+      char c = randomBelow(4) ? FUZZ_ALPHABET[randomBelow(sizeof(FUZZ_ALPHABET) - 1)]
+                              : (char)randomBelow(256);
+      switch (randomBelow(4)) {
+        case 0:
+          if (at < len) buf[at] = c;
+          break;
+        case 1:
+          if (len < sizeof(buf)) {
+            memmove(buf + at + 1, buf + at, len - at);
+            buf[at] = c;
+            len++;
+          }
+          break;
+        case 2:
+          if (at < len) {
+            memmove(buf + at, buf + at + 1, len - at - 1);
+            len--;
+          }
+          break;
+        default: {
+          size_t n = randomBelow(len - at + 1);
+          if (len + n <= sizeof(buf)) {
+            memmove(buf + at + n, buf + at, len - at);
+            len += n;
+          }
+          break;
+        }
+      }
+    }
+    feed(buf, len);
+  }
+}
+
+// Random strings over the grammar's own characters
+void test_random_documents() {
+  char buf[64];
+  for (int round = 0; round < FUZZ_ROUNDS; round++) {
+    size_t len = randomBelow(sizeof(buf) + 1);
+    for (size_t i = 0; i < len; i++) {
+      buf[i] = FUZZ_ALPHABET[randomBelow(sizeof(FUZZ_ALPHABET) - 1)];
+    }
+    feed(buf, len);
+  }
+}
+
+void test_number_range() {
+  static const char *const ok[] = {"[1e308]", "[-1.5e300]", "[0e999]", "[2.5e-300]"};
+  static const char *const bad[] = {"[1e309]", "[1.8e308]", "[99999999999999999999e300]",
+                                    "[1e-400]", "[01]", "[1.]", "[.5]", "[1e]", "[+1]"};
+  for (const char *json : ok) TEST_ASSERT_TRUE(drain(json, strlen(json)) == JSON_END);
+  for (const char *json : bad) TEST_ASSERT_TRUE(drain(json, strlen(json)) == JSON_ERROR);
+}
+
+void test_deep_nesting_rejected() {
+  char buf[2 * JSON_MAX_DEPTH + 3];
+  size_t n = 0;
+  for (int i = 0; i <= JSON_MAX_DEPTH; i++) buf[n++] = '[';
+  for (int i = 0; i <= JSON_MAX_DEPTH; i++) buf[n++] = ']';
+  TEST_ASSERT_TRUE(drain(buf, n) == JSON_ERROR);
+  TEST_ASSERT_TRUE(drain(buf + 1, n - 2) == JSON_END);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_writer_output_reads_back);
+  RUN_TEST(test_seeds_round_trip);
+  RUN_TEST(test_settings_fields);
+  RUN_TEST(test_truncated_seeds);
+  RUN_TEST(test_mutated_seeds);
+  RUN_TEST(test_random_documents);
+  RUN_TEST(test_number_range);
+  RUN_TEST(test_deep_nesting_rejected);
+  return UNITY_END();
+}
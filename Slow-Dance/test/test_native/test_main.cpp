@@ -0,0 +1,215 @@
+// Firmware behaviour on the native simulation (lib/native_hal): edge
+// timing, the settings API and the button. Run with `pio test -e native`.
+//
+// The firmware boots once; the tests run in order against the same
+// device, each leaving it running and enabled.
+
+#include <unity.h>
+#include <sim.h>
+#include <math.h>
+#include <Arduino.h>
+#include "config.h"
+#include "settings_store.h"
+
+// An edge is off by up to a tick of the ISR backend's 10 MHz timebase, as
+// the NCO rounds, plus the interrupt's own timer reads before the write
+#define EDGE_TOLERANCE_NS 200
+
+void setUp() {}
+void tearDown() {}
+
+// Rising edges of `pin` among the recorded ones
+static std::vector<uint64_t> risingEdges(int pin) {
+  std::vector<uint64_t> rises;
+  for (const SimEdge &e : simEdges()) {
+    if (e.pin == pin && e.level == HIGH) rises.push_back(e.ns);
+  }
+  return rises;
+}
+
+// Every period of `pin` over `ms` is 1 / `hz`, to the edge tolerance
+static void assertPeriods(int pin, double hz, uint32_t ms) {
+  simClearEdges();
+  simRunForMs(ms);
+  std::vector<uint64_t> rises = risingEdges(pin);
+  TEST_ASSERT_GREATER_THAN(hz * ms / 1000 - 2, rises.size());
+  double period = 1e9 / hz;
+  for (size_t i = 1; i < rises.size(); i++) {
+    TEST_ASSERT_DOUBLE_WITHIN(EDGE_TOLERANCE_NS, period, (double)(rises[i] - rises[i - 1]));
+  }
+  // The NCO carries the fraction: no drift over the whole run
+  size_t periods = rises.size() - 1;
+  double mean = (double)(rises.back() - rises.front()) / periods;
+  TEST_ASSERT_DOUBLE_WITHIN(2.0 * EDGE_TOLERANCE_NS / periods, period, mean);
+}
+
+static bool bodyHas(const SimResponse &r, const char *text) {
+  return r.body.find(text) != std::string::npos;
+}
+
+static void press(uint32_t ms) {
+  simSetPin(BUTTON_PIN, LOW);
+  simRunForMs(ms);
+  simSetPin(BUTTON_PIN, HIGH);
+  simRunForMs(DEBOUNCE_DELAY + 100);
+}
+
+// ============================================
+// Edge Timing
+// ============================================
+
+void test_default_frequencies() {
+  assertPeriods(LED_PIN, DEFAULT_LED_FREQ, 2000);
+  assertPeriods(MAGNET_PIN, DEFAULT_MAGNET_FREQ, 2000);
+}
+
+void test_led_duty() {
+  simClearEdges();
+  simRunForMs(500);
+  uint64_t rise = 0;
+  for (const SimEdge &e : simEdges()) {
+    if (e.pin != LED_PIN) continue;
+    if (e.level == HIGH) {
+      rise = e.ns;
+    } else if (rise) {
+      double high = 1e9 / DEFAULT_LED_FREQ * DEFAULT_LED_DUTY / 100.0;
+      TEST_ASSERT_DOUBLE_WITHIN(EDGE_TOLERANCE_NS, high, (double)(e.ns - rise));
+    }
+  }
+}
+
+// Sector erases (the cache is off for each) every 60 ms, as an OTA
+// upload does: the timer interrupt is IRAM-safe, so no edge moves.
+void test_edges_through_flash_writes() {
+  for (int k = 1; k <= 30; k++) {
+    simAt(simNowNs() + k * 60 * SIM_NS_PER_MS, [] { simFlashStall(SIM_FLASH_ERASE_US * 1000ULL); });
+  }
+  assertPeriods(LED_PIN, DEFAULT_LED_FREQ, 2000);
+}
+
+// ============================================
+// Settings API
+// ============================================
+
+void test_settings_update_edges() {
+  SimResponse r = simRequest("POST", "/api/settings", "{\"ledFreq\": 60, \"magFreq\": 59.5}");
+  TEST_ASSERT_EQUAL_INT(200, r.code);
+
+  r = simRequest("GET", "/api/settings");
+  TEST_ASSERT_EQUAL_INT(200, r.code);
+  TEST_ASSERT_EQUAL_STRING("application/json", r.type.c_str());
+  TEST_ASSERT_TRUE(bodyHas(r, "\"ledFreq\":60.0"));
+  TEST_ASSERT_TRUE(bodyHas(r, "\"beat\":0.5000"));
+
+  // Taken up at the next cycle boundary
+  simRunForMs(100);
+  assertPeriods(LED_PIN, 60.0, 1000);
+  assertPeriods(MAGNET_PIN, 59.5, 1000);
+}
+
+void test_settings_reject_out_of_range() {
+  SimResponse r = simRequest("POST", "/api/settings", "{\"ledFreq\": 60000}");
+  TEST_ASSERT_EQUAL_INT(400, r.code);
+  TEST_ASSERT_TRUE(bodyHas(r, "out of range"));
+  r = simRequest("POST", "/api/settings", "{\"ledFreq\": 6");
+  TEST_ASSERT_EQUAL_INT(400, r.code);
+
+  r = simRequest("GET", "/api/settings");
+  TEST_ASSERT_TRUE(bodyHas(r, "\"ledFreq\":60.0"));
+}
+
+void test_settings_committed_once_quiet() {
+  uint32_t writes = simFlashWrites();
+  simRequest("POST", "/api/settings", "{\"ledDuty\": 40}");
+  simRunForMs(1000);
+  simRequest("POST", "/api/settings", "{\"ledDuty\": 30}");
+  simRunForMs(1000);
+  TEST_ASSERT_EQUAL_UINT32(writes, simFlashWrites());
+  simRunForMs(STORE_COMMIT_DELAY_MS);
+  TEST_ASSERT_EQUAL_UINT32(writes + 1, simFlashWrites());
+}
+
+// The widest values the ranges allow still fit SETTINGS_JSON_SIZE
+void test_settings_json_fits() {
+  SimResponse r = simRequest("POST", "/api/settings",
+    "{\"ledFreq\": 50.05, \"ledDuty\": 100, \"magFreq\": 149.95, \"magDuty\": 90,"
+    " \"mag2Duty\": 90, \"mag2Phase\": 359.95}");
+  TEST_ASSERT_EQUAL_INT(200, r.code);
+  r = simRequest("GET", "/api/settings");
+  TEST_ASSERT_EQUAL_INT(200, r.code);
+  TEST_ASSERT_TRUE(bodyHas(r, "\"beat\":-99.9"));
+  TEST_ASSERT_LESS_THAN(SETTINGS_JSON_SIZE, r.body.size());
+
+  r = simRequest("POST", "/api/settings",
+    "{\"ledFreq\": 60, \"ledDuty\": 30, \"magFreq\": 59.5, \"magDuty\": 50,"
+    " \"mag2Duty\": 50, \"mag2Phase\": 0}");
+  TEST_ASSERT_EQUAL_INT(200, r.code);
+}
+
+// Values read back from flash are held to the API's ranges
+void test_stored_settings_clamped() {
+  WaveformSettings s = {1e9f, NAN, 10, 95, 50, -5};
+  TEST_ASSERT_TRUE(storeClampSettings(s));
+  TEST_ASSERT_EQUAL_FLOAT(FREQ_MAX, s.ledFreq);
+  TEST_ASSERT_EQUAL_FLOAT(DEFAULT_LED_DUTY, s.ledDuty);
+  TEST_ASSERT_EQUAL_FLOAT(FREQ_MIN, s.magnetFreq);
+  TEST_ASSERT_EQUAL_FLOAT(MAGNET_DUTY_MAX, s.magnetDuty);
+  TEST_ASSERT_EQUAL_FLOAT(50, s.magnet2Duty);
+  TEST_ASSERT_EQUAL_FLOAT(MAGNET_PHASE_MIN, s.magnet2Phase);
+  TEST_ASSERT_FALSE(storeClampSettings(s));
+}
+
+void test_unknown_path() {
+  TEST_ASSERT_EQUAL_INT(404, simRequest("GET", "/api/nothing").code);
+}
+
+// ============================================
+// Button
+// ============================================
+
+void test_short_press_toggles() {
+  press(100);
+  TEST_ASSERT_TRUE(bodyHas(simRequest("GET", "/api/settings"), "\"enabled\":false"));
+  simClearEdges();
+  simRunForMs(500);
+  TEST_ASSERT_EQUAL_UINT32(0, risingEdges(LED_PIN).size());
+
+  press(100);
+  TEST_ASSERT_TRUE(bodyHas(simRequest("GET", "/api/settings"), "\"enabled\":true"));
+  simRunForMs(100);
+  assertPeriods(LED_PIN, 60.0, 500);
+}
+
+void test_long_press_selects_next_preset() {
+  SimResponse r = simRequest("POST", "/api/presets", "{\"action\": \"save\", \"slot\": 1, \"name\": \"Test\"}");
+  TEST_ASSERT_EQUAL_INT(200, r.code);
+  TEST_ASSERT_TRUE(bodyHas(simRequest("GET", "/api/settings"), "\"preset\":1"));
+
+  // Slot 0 holds the defaults
+  press(BUTTON_LONG_PRESS_MS + 200);
+  r = simRequest("GET", "/api/settings");
+  TEST_ASSERT_TRUE(bodyHas(r, "\"preset\":0"));
+  TEST_ASSERT_TRUE(bodyHas(r, "\"enabled\":true"));
+  simRunForMs(100);
+  assertPeriods(LED_PIN, DEFAULT_LED_FREQ, 1000);
+}
+
+int main(int argc, char **argv) {
+  simSetSerialEcho(false);
+  simBoot();
+  simRunForMs(3000);   // past WiFi and the magnet self-test
+
+  UNITY_BEGIN();
+  RUN_TEST(test_default_frequencies);
+  RUN_TEST(test_led_duty);
+  RUN_TEST(test_edges_through_flash_writes);
+  RUN_TEST(test_settings_update_edges);
+  RUN_TEST(test_settings_reject_out_of_range);
+  RUN_TEST(test_settings_committed_once_quiet);
+  RUN_TEST(test_settings_json_fits);
+  RUN_TEST(test_stored_settings_clamped);
+  RUN_TEST(test_unknown_path);
+  RUN_TEST(test_short_press_toggles);
+  RUN_TEST(test_long_press_selects_next_preset);
+  return UNITY_END();
+}
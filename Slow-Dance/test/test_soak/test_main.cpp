@@ -0,0 +1,90 @@
+// Heap soak on the native simulation: hours of the web UI's polling
+// (GET /api/settings and /api/metrics every few seconds) with event
+// streams opening, streaming and dropping, after which free heap and the
+// largest free block have to be where they were once warmed up. Run with
+// `pio test -e native`.
+//
+// The heap figures are the host heap against SIM_HEAP_SIZE (sim.h), so
+// the simulation's own request plumbing is in them too; it frees what it
+// takes per request like the firmware has to.
+
+#include <unity.h>
+#include <sim.h>
+#include <Arduino.h>
+#include "config.h"
+#include "events.h"
+
+#define SOAK_POLL_MS 3000      // the web UI's polling interval
+#define SOAK_WARMUP_POLLS 200
+#define SOAK_POLLS 7200        // six hours
+#define SOAK_SAMPLES 12
+#define SOAK_TOLERANCE 1024    // bytes, allocator bookkeeping
+
+void setUp() {}
+void tearDown() {}
+
+// A browser tab that stays open and reads what it is sent
+static std::shared_ptr<SimConnection> resident;
+
+static void poll(int n) {
+  TEST_ASSERT_EQUAL_INT(200, simRequest("GET", "/api/settings").code);
+  TEST_ASSERT_EQUAL_INT(200, simRequest("GET", "/api/metrics").code);
+
+  // A tab that reconnects its event stream now and then
+  if (n % 4 == 0) {
+    SimResponse r = simRequest("GET", "/api/events");
+    TEST_ASSERT_EQUAL_INT(200, r.code);
+    TEST_ASSERT_TRUE(r.stream != nullptr);
+    simRunForMs(SOAK_POLL_MS / 2);
+    r.stream->open = false;
+  }
+
+  // Settings changes reach the event streams as well
+  if (n % 16 == 0) {
+    char body[48];
+    snprintf(body, sizeof(body), "{\"ledDuty\": %d}", 10 + n % 32);
+    TEST_ASSERT_EQUAL_INT(200, simRequest("POST", "/api/settings", body).code);
+  }
+
+  simRunForMs(n % 4 == 0 ? SOAK_POLL_MS / 2 : SOAK_POLL_MS);
+  resident->data.clear();
+  resident->data.shrink_to_fit();
+  simClearEdges();
+}
+
+void test_event_stream_connects() {
+  SimResponse r = simRequest("GET", "/api/events");
+  TEST_ASSERT_EQUAL_INT(200, r.code);
+  TEST_ASSERT_TRUE(r.stream != nullptr);
+  resident = r.stream;
+  simRunForMs(100);
+  TEST_ASSERT_TRUE(resident->data.find("event: settings") != std::string::npos);
+  TEST_ASSERT_EQUAL_INT(1, eventsClientCount());
+}
+
+void test_heap_flat_under_polling() {
+  for (int n = 0; n < SOAK_WARMUP_POLLS; n++) poll(n);
+  uint32_t free = ESP.getFreeHeap();
+  uint32_t largest = ESP.getMaxAllocHeap();
+
+  for (int sample = 1; sample <= SOAK_SAMPLES; sample++) {
+    for (int n = 0; n < SOAK_POLLS / SOAK_SAMPLES; n++) poll(n);
+    TEST_ASSERT_GREATER_OR_EQUAL(free - SOAK_TOLERANCE, ESP.getFreeHeap());
+    TEST_ASSERT_GREATER_OR_EQUAL(largest - SOAK_TOLERANCE, ESP.getMaxAllocHeap());
+  }
+
+  // The resident stream kept being served throughout
+  TEST_ASSERT_TRUE(resident->open);
+  TEST_ASSERT_EQUAL_INT(1, eventsClientCount());
+}
+
+int main(int argc, char **argv) {
+  simSetSerialEcho(false);
+  simBoot();
+  simRunForMs(3000);   // past WiFi and the magnet self-test
+
+  UNITY_BEGIN();
+  RUN_TEST(test_event_stream_connects);
+  RUN_TEST(test_heap_flat_under_polling);
+  return UNITY_END();
+}
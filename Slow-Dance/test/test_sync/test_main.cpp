@@ -0,0 +1,213 @@
+// Multi-unit sync over a simulated link: a leader and a follower with
+// their own crystals exchange packets through WiFi-like delays, and the
+// follower lines its edges up with the leader's as sync.cpp does. Run
+// with `pio test -e native`.
+//
+// Both clocks are modelled in the follower's timebase ticks; the firmware
+// is not booted, only the protocol and servo (sync_protocol.h) are used.
+
+#include <unity.h>
+#include <math.h>
+#include <stdint.h>
+#include "config.h"
+#include "sync_protocol.h"
+#include "waveform.h"
+
+#define TICKS_PER_US (WAVEFORM_TIMEBASE_HZ / 1000000.0)
+#define TICKS_PER_MS (WAVEFORM_TIMEBASE_HZ / 1000.0)
+#define MAX_DELAY_TICKS ((int64_t)(SYNC_MAX_DELAY_US * TICKS_PER_US))
+#define ALIGN_LIMIT_US 100     // the alignment sync is built for
+#define SETTLE_MS 30000        // lock, first trim and first step
+#define RUN_MS 600000
+
+// Leader against follower: clock offset and crystal error
+#define LEADER_OFFSET 1234567890.0
+#define LEADER_PPM 37.0
+
+// One-way delay: a fixed part that differs slightly between the two
+// directions, exponential jitter and now and then a retry burst
+#define DELAY_OUT_US 1200
+#define DELAY_BACK_US 1150
+#define JITTER_MEAN_US 500
+#define BURST_PERCENT 5
+#define BURST_US 25000
+#define TURNAROUND_US 300      // leader: parsePacket() to the answer
+
+#define LED_PERIOD (WAVEFORM_TIMEBASE_HZ / 80.0)
+
+static uint32_t rng;
+
+void setUp() {
+  rng = 12345;
+}
+
+void tearDown() {}
+
+static double uniform() {
+  rng = rng * 1664525u + 1013904223u;
+  return ((rng >> 8) + 0.5) / 16777216.0;
+}
+
+// One-way delay in ticks
+static double linkDelay(double fixedUs) {
+  double us = fixedUs - JITTER_MEAN_US * log(uniform());
+  if (uniform() * 100 < BURST_PERCENT) us += BURST_US * uniform();
+  return us * TICKS_PER_US;
+}
+
+static uint64_t leaderAt(double local) {
+  return (uint64_t)llround(LEADER_OFFSET + local * (1.0 + LEADER_PPM * 1e-6));
+}
+
+static double localAt(uint64_t leader) {
+  return ((double)leader - LEADER_OFFSET) / (1.0 + LEADER_PPM * 1e-6);
+}
+
+// A two-way exchange started at local tick `t1`, through the wire format
+static void exchange(SyncServo &servo, uint64_t t1, uint16_t seq) {
+  SyncPacket request;
+  syncPacketInit(request, SYNC_REQUEST, seq);
+  request.t1 = t1;
+
+  SyncPacket response;
+  syncPacketInit(response, SYNC_RESPONSE, request.seq);
+  response.t1 = request.t1;
+  response.t2 = leaderAt((double)t1 + linkDelay(DELAY_OUT_US));
+  response.t3 = response.t2 + (uint64_t)(TURNAROUND_US * TICKS_PER_US);
+  uint64_t t4 = (uint64_t)llround(localAt(response.t3) + linkDelay(DELAY_BACK_US));
+
+  TEST_ASSERT_TRUE(syncPacketValid(response, sizeof(response)));
+  syncServoAdd(servo, response.t1, response.t2, response.t3, t4, MAX_DELAY_TICKS);
+}
+
+// The follower's LED channel on its own timebase, trimmed and stepped
+struct Channel {
+  double anchor;   // a rising edge
+  double period;
+};
+
+static double nextRise(const Channel &c, double now) {
+  return c.anchor + ceil((now - c.anchor) / c.period) * c.period;
+}
+
+// Where the follower's next edge falls against the leader's, in µs
+static double alignmentUs(const Channel &c, double now) {
+  double rise = nextRise(c, now);
+  return syncWrapPhase((double)leaderAt(rise), LED_PERIOD) / TICKS_PER_US;
+}
+
+// ============================================
+// Servo
+// ============================================
+
+void test_packet_validation() {
+  SyncPacket p;
+  syncPacketInit(p, SYNC_PHASE, 7);
+  TEST_ASSERT_TRUE(syncPacketValid(p, sizeof(p)));
+  TEST_ASSERT_FALSE(syncPacketValid(p, sizeof(p) - 1));
+  p.version = SYNC_VERSION + 1;
+  TEST_ASSERT_FALSE(syncPacketValid(p, sizeof(p)));
+}
+
+void test_slow_exchanges_dropped() {
+  SyncServo servo;
+  syncServoReset(servo);
+  uint64_t t1 = 1000;
+  uint64_t t2 = 5000;
+  uint64_t slow = t1 + MAX_DELAY_TICKS + 1;
+  TEST_ASSERT_FALSE(syncServoAdd(servo, t1, t2, t2, slow, MAX_DELAY_TICKS));
+  TEST_ASSERT_EQUAL_INT(0, servo.count);
+  // A response stamped before its request
+  TEST_ASSERT_FALSE(syncServoAdd(servo, t1, t2, t2 + 500, t1 + 100, MAX_DELAY_TICKS));
+  TEST_ASSERT_EQUAL_INT(0, servo.count);
+}
+
+void test_servo_tracks_offset_and_rate() {
+  SyncServo servo;
+  syncServoReset(servo);
+  uint16_t seq = 0;
+  double now = 5e9;   // 500 s after the follower's boot
+  for (int ms = 0; ms < RUN_MS / 4; ms += SYNC_REQUEST_MS) {
+    exchange(servo, (uint64_t)now, ++seq);
+    now += SYNC_REQUEST_MS * TICKS_PER_MS;
+  }
+  TEST_ASSERT_TRUE(servo.locked);
+  double truth = (double)leaderAt(now) - now;
+  TEST_ASSERT_DOUBLE_WITHIN(ALIGN_LIMIT_US * TICKS_PER_US, truth,
+                            syncServoOffsetAt(servo, (uint64_t)now));
+  TEST_ASSERT_DOUBLE_WITHIN(0.5, LEADER_PPM, syncServoPpm(servo));
+}
+
+// ============================================
+// Leader and Follower
+// ============================================
+
+// The follower loop of sync.cpp: exchanges every SYNC_REQUEST_MS, rate
+// trims, and a step onto the leader's edge at every SYNC_PHASE_MS
+// broadcast. Once settled, its edges stay within ALIGN_LIMIT_US of the
+// leader's at every point sampled.
+void test_follower_aligns_to_leader() {
+  SyncServo servo;
+  syncServoReset(servo);
+  uint16_t seq = 0;
+  double appliedPpm = 0;
+  double start = 5e9;
+  Channel led = {start + 0.37 * LED_PERIOD, LED_PERIOD};
+  double leaderPhaseDue = start + SYNC_PHASE_MS * TICKS_PER_MS;
+  uint32_t steps = 0;
+  double worst = 0;
+
+  for (int ms = 0; ms < RUN_MS; ms += SYNC_REQUEST_MS) {
+    double now = start + ms * TICKS_PER_MS;
+    exchange(servo, (uint64_t)now, ++seq);
+
+    double ppm = syncServoPpm(servo);
+    if (servo.locked && fabs(ppm - appliedPpm) >= SYNC_TRIM_STEP_PPM) {
+      // waveformTrim(): the next edge keeps its place, later ones move
+      appliedPpm = ppm;
+      led.anchor = nextRise(led, now);
+      led.period = LED_PERIOD / (1.0 + appliedPpm * 1e-6);
+    }
+
+    if (now >= leaderPhaseDue) {
+      leaderPhaseDue += SYNC_PHASE_MS * TICKS_PER_MS;
+      // The leader's next edge, taken on its side of the link
+      uint64_t leaderNow = leaderAt(now);
+      SyncPacket p;
+      syncPacketInit(p, SYNC_PHASE, seq);
+      p.ledRise = leaderNow + (uint64_t)(LED_PERIOD - fmod((double)leaderNow, LED_PERIOD));
+      p.ledPeriod = LED_PERIOD;
+      TEST_ASSERT_TRUE(syncPacketValid(p, sizeof(p)));
+
+      double received = now + linkDelay(DELAY_OUT_US);
+      if (servo.locked) {
+        double expected = (double)p.ledRise - syncServoOffsetAt(servo, (uint64_t)received);
+        double error = syncWrapPhase(nextRise(led, received) - expected, led.period);
+        if (fabs(error) > SYNC_DEADBAND_US * TICKS_PER_US) {
+          led.anchor -= error;
+          steps++;
+        }
+      }
+    }
+
+    if (ms >= SETTLE_MS) {
+      double err = fabs(alignmentUs(led, now));
+      if (err > worst) worst = err;
+    }
+  }
+
+  TEST_ASSERT_TRUE(servo.locked);
+  TEST_ASSERT_GREATER_THAN(0, steps);
+  TEST_ASSERT_DOUBLE_WITHIN(ALIGN_LIMIT_US, 0, worst);
+  // Stepping is for the initial phase and the odd outlier, not every broadcast
+  TEST_ASSERT_GREATER_THAN(steps * 10, RUN_MS / SYNC_PHASE_MS);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_packet_validation);
+  RUN_TEST(test_slow_exchanges_dropped);
+  RUN_TEST(test_servo_tracks_offset_and_rate);
+  RUN_TEST(test_follower_aligns_to_leader);
+  return UNITY_END();
+}